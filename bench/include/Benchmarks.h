@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QString>
+#include <QElapsedTimer>
+
+// 开发调试用的基准测试，由 NetherLink-bench 调用；与应用共用全部源文件，只测量，不改动用户数据
+
+// 发送日志：在临时目录中由 producers 个线程共追加 messages 条消息（sink 为空），测量从追加到全部落盘的吞吐
+struct SendJournalBenchmark {
+    int messages = 0;
+    int producers = 0;
+    qint64 elapsedMs = 0;
+    double sendsPerSecond = 0;
+    quint64 commits = 0;        // fsync 次数
+    double averageBatch = 0;    // 每次提交的平均条数
+};
+SendJournalBenchmark benchmarkSendJournal(int messages, int producers);
+
+// 消息仓库：在临时数据目录中建仓库，readers 个线程反复读取快照与会话摘要，同时一个线程持续批量写入，
+// 各运行 durationMs 毫秒；再让读写共用一把互斥锁重跑一遍作为对照
+struct ContentionStats {
+    quint64 reads = 0;
+    quint64 writes = 0;         // 每次写入一批
+    double readsPerSecond = 0;
+    double writesPerSecond = 0;
+    double maxReadUs = 0;       // 单次读取的最长耗时
+};
+struct RepositoryBenchmark {
+    int readers = 0;
+    int durationMs = 0;
+    ContentionStats snapshot;   // 无锁快照（现行做法）
+    ContentionStats mutex;      // 读写共用一把互斥锁（快照之前的做法）
+};
+RepositoryBenchmark benchmarkRepository(int readers, int durationMs);
+
+// 消息列表：合成 messages 条群聊文本消息，先按 QSharedPointer<ChatMessage> 建一份，再追加进紧凑列表，
+// 分别统计估算的堆内存与常驻内存增量
+struct MessageListBenchmark {
+    int messages = 0;
+    qint64 pointerBytes = 0;     // QSharedPointer<ChatMessage> 列表的估算堆内存
+    qint64 compactBytes = 0;     // CompactMessageList::memoryUsage()
+    qint64 pointerRssBytes = -1; // 构建前后进程常驻内存之差，平台不支持时为 -1
+    qint64 compactRssBytes = -1;
+};
+MessageListBenchmark benchmarkMessageList(int messages);
+
+// 长会话滚动：合成 rows 条消息的会话，打开后以程序驱动滚动 frames 帧（匀速滚动与拖动滚动条各半），
+// 再反复改变宽度，记录每帧耗时与内存占用
+struct ScrollBenchmark {
+    int rows = 0;
+    int frames = 0;
+    qint64 openMs = 0;             // 设置模型到首帧画完
+    double averageFrameMs = 0;
+    double p95FrameMs = 0;
+    double maxFrameMs = 0;
+    int slowFrames = 0;            // 超过 16.7ms 的帧数
+    double averageResizeMs = 0;
+    qint64 modelBytes = 0;         // 模型（含气泡排版缓存）
+    qint64 layoutBytes = 0;        // 其中的气泡排版缓存
+    qint64 indexBytes = 0;         // 行高索引
+    qint64 rowPixmapBytes = 0;     // 代理的整行位图缓存
+};
+ScrollBenchmark benchmarkScroll(int rows, int frames);
+
+// 启动首帧：以子进程在临时数据目录中反复冷启动（本程序的 startup-probe），交替测量有无启动快照时画出会话列表的耗时，
+// 每种各 runs 次。先由一次预热启动建好消息存储并保存快照，之后各轮都不保存，使用快照的各轮读到的是同一份
+struct StartupBenchmark {
+    int runs = 0;
+    double storesMs = -1;       // 没有快照，等各仓库就绪后建出列表，中位数
+    double snapshotMs = -1;     // 由启动快照建出列表，中位数
+    int failures = 0;           // 没有报告列表画出的子进程
+};
+StartupBenchmark benchmarkStartup(int runs);
+// startup-probe 子进程：与应用相同的启动过程，会话列表画出后把距启动的毫秒数写入 resultPath 并退出；
+// seed 时随后保存启动快照（只有预热的一轮）
+int runStartupProbe(const QElapsedTimer& launchClock, const QString& resultPath, bool seed);
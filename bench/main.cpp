@@ -0,0 +1,85 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "Benchmarks.h"
+
+// 开发调试用的基准测试：NetherLink-bench <名称> [参数...]，输出结果后退出
+int main(int argc, char *argv[])
+{
+    QElapsedTimer launchClock;
+    launchClock.start();
+    QApplication a(argc, argv);
+    const QStringList args = a.arguments().mid(1);
+    const QString name = args.value(0);
+
+    // wal <条数> [线程数]：发送日志的吞吐
+    if (name == "wal") {
+        const auto result = benchmarkSendJournal(args.value(1).toInt(), qMax(1, args.value(2).toInt()));
+        qInfo().nospace() << "SendJournal benchmark: " << result.messages << " sends from "
+                          << result.producers << " thread(s) in " << result.elapsedMs << " ms, "
+                          << qRound(result.sendsPerSecond) << " sends/s, " << result.commits
+                          << " fsyncs, " << result.averageBatch << " per commit";
+        return 0;
+    }
+    // repo <读线程数> [毫秒]：消息仓库在写入竞争下的读取吞吐
+    if (name == "repo") {
+        const int durationMs = args.size() > 2 ? args.value(2).toInt() : 2000;
+        const auto result = benchmarkRepository(args.value(1).toInt(), durationMs);
+        const auto report = [](const char* mode, const ContentionStats& stats) {
+            qInfo().nospace() << "  " << mode << ": " << qRound64(stats.readsPerSecond) << " reads/s, "
+                              << qRound64(stats.writesPerSecond) << " write batches/s, max read "
+                              << stats.maxReadUs << " us";
+        };
+        qInfo().nospace() << "MessageRepository benchmark: " << result.readers << " reader(s) against one writer, "
+                          << result.durationMs << " ms per mode";
+        report("snapshot", result.snapshot);
+        report("mutex", result.mutex);
+        return 0;
+    }
+    // list <条数>：两种消息表示的内存占用
+    if (name == "list") {
+        const auto result = benchmarkMessageList(args.value(1).toInt());
+        const auto ratio = [](qint64 pointer, qint64 compact) {
+            return compact > 0 ? double(pointer) / double(compact) : 0.0;
+        };
+        qInfo().nospace() << "CompactMessageList benchmark: " << result.messages << " group messages; heap estimate "
+                          << result.pointerBytes / 1024 << " KB as QSharedPointer<ChatMessage> vs "
+                          << result.compactBytes / 1024 << " KB compact ("
+                          << ratio(result.pointerBytes, result.compactBytes) << "x)";
+        if (result.pointerRssBytes >= 0) {
+            qInfo().nospace() << "  RSS growth " << result.pointerRssBytes / 1024 << " KB vs "
+                              << result.compactRssBytes / 1024 << " KB ("
+                              << ratio(result.pointerRssBytes, result.compactRssBytes) << "x)";
+        }
+        return 0;
+    }
+    // scroll <条数> [帧数]：长会话的滚动帧时间
+    if (name == "scroll") {
+        const int frames = args.size() > 2 ? args.value(2).toInt() : 600;
+        const auto result = benchmarkScroll(args.value(1).toInt(), frames);
+        qInfo().nospace() << "ChatListView benchmark: " << result.rows << " messages, opened in "
+                          << result.openMs << " ms; " << result.frames << " scroll frames avg "
+                          << result.averageFrameMs << " ms, p95 " << result.p95FrameMs << " ms, max "
+                          << result.maxFrameMs << " ms, " << result.slowFrames << " over 16.7 ms; resize avg "
+                          << result.averageResizeMs << " ms; model " << result.modelBytes / 1024
+                          << " KB (layouts " << result.layoutBytes / 1024 << " KB), row index "
+                          << result.indexBytes / 1024 << " KB, row pixmaps "
+                          << result.rowPixmapBytes / 1024 << " KB";
+        return 0;
+    }
+    // startup <次数>：以子进程交替测量有无启动快照时会话列表画出的耗时
+    if (name == "startup") {
+        const auto result = benchmarkStartup(args.value(1).toInt());
+        qInfo().nospace() << "Startup benchmark: " << result.runs << " launch(es) each, conversation list shown median "
+                          << result.storesMs << " ms from stores vs " << result.snapshotMs
+                          << " ms from snapshot, " << result.failures << " failed launch(es)";
+        return 0;
+    }
+    // startup 的子进程
+    if (name == "startup-probe" && args.size() > 1)
+        return runStartupProbe(launchClock, args.value(1), args.value(2) == "seed");
+
+    qWarning().noquote() << "usage: NetherLink-bench wal <messages> [threads] | repo <readers> [ms] | list <messages>"
+                            " | scroll <rows> [frames] | startup <runs>";
+    return 1;
+}
@@ -0,0 +1,93 @@
+#include "Benchmarks.h"
+#include "CompactMessageList.h"
+#include <QFile>
+#include <QSharedPointer>
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace {
+
+constexpr int BENCH_SENDERS = 200;          // 群成员数
+constexpr qint64 HEAP_BLOCK_OVERHEAD = 16;  // 每次堆分配的分配器开销（估算）
+
+// 进程当前的常驻内存（字节），平台不支持时返回 -1
+qint64 residentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.WorkingSetSize);
+    return -1;
+#elif defined(Q_OS_LINUX)
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly))
+        return -1;
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+    }
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+// 一个 QString 独占的堆内存，共享或为空时不计
+qint64 stringBytes(const QString& text)
+{
+    if (text.isEmpty())
+        return 0;
+    return qint64(sizeof(QArrayData)) + (text.capacity() + 1) * qint64(sizeof(QChar)) + HEAP_BLOCK_OVERHEAD;
+}
+
+}
+
+MessageListBenchmark benchmarkMessageList(int messages)
+{
+    MessageListBenchmark result;
+    result.messages = qMax(0, messages);
+    const QString phrase = QStringLiteral("今晚的群聊讨论一下下周的发布计划，顺便确认测试环境和回归用例的分工，"
+                                          "有问题请在群里回复，收到请回一个一 OK thanks");
+    const qint64 start = QDateTime::currentMSecsSinceEpoch() - qint64(result.messages) * 1000;
+
+    // 与从存储解码出的消息一样，每条消息的文本、发送者 id 与名字都是独立分配的字符串
+    const qint64 beforePointers = residentBytes();
+    QVector<QSharedPointer<ChatMessage>> pointers;
+    pointers.reserve(result.messages);
+    for (int i = 0; i < result.messages; ++i) {
+        const int member = i % BENCH_SENDERS;
+        const QString text(phrase.constData(), 8 + (i * 7) % (phrase.size() - 8));
+        auto message = QSharedPointer<TextMessage>::create(text, member == 0,
+                                                           QStringLiteral("u%1").arg(10000 + member), true,
+                                                           QStringLiteral("成员%1").arg(member), GroupRole::Member);
+        message->setSeq(i + 1);
+        message->setTimestamp(QDateTime::fromMSecsSinceEpoch(start + qint64(i) * 1000));
+        pointers.push_back(message);
+    }
+    const qint64 afterPointers = residentBytes();
+
+    CompactMessageList compact;
+    for (const auto& message : std::as_const(pointers))
+        compact.append(*message);
+    const qint64 afterCompact = residentBytes();
+
+    // 对象本身、计数块与对象合在一次分配里，再加列表中的一个指针槽位
+    result.pointerBytes = pointers.capacity() * qint64(sizeof(QSharedPointer<ChatMessage>));
+    for (const auto& message : std::as_const(pointers)) {
+        const auto& text = static_cast<const TextMessage&>(*message);
+        result.pointerBytes += qint64(sizeof(TextMessage)) + 2 * qint64(sizeof(void*)) + HEAP_BLOCK_OVERHEAD
+                             + stringBytes(text.getText()) + stringBytes(text.getSenderId())
+                             + stringBytes(text.getSenderName());
+    }
+    result.compactBytes = compact.memoryUsage();
+    if (beforePointers >= 0 && afterPointers >= 0 && afterCompact >= 0) {
+        result.pointerRssBytes = afterPointers - beforePointers;
+        result.compactRssBytes = afterCompact - afterPointers;
+    }
+    return result;
+}
@@ -0,0 +1,122 @@
+#include "Benchmarks.h"
+#include "MessageRepository.h"
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <QThread>
+#include <QMutex>
+#include <atomic>
+
+namespace {
+
+constexpr int BENCH_CONVERSATIONS = 64;   // 会话数
+constexpr int BENCH_SEED = 128;           // 每个会话预先写入的条数，与快照保留的最新消息数相同
+constexpr int BENCH_BATCH = 4;            // 每次写入的条数
+
+// 一轮：lock 为空时读者走无锁快照，否则读写都先获取 lock
+ContentionStats runContention(MessageRepository& repository, const QStringList& conversations,
+                              int readers, int durationMs, QMutex* lock)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<quint64> reads{0};
+    std::atomic<quint64> writes{0};
+    std::atomic<qint64> maxReadNs{0};
+    QThreadPool pool;
+    pool.setMaxThreadCount(readers + 1);
+
+    // 写者：轮流向各会话写入一批
+    pool.start([&repository, &conversations, &stop, &writes, lock] {
+        quint64 written = 0;
+        for (int i = 0; !stop; ++i) {
+            QVector<QSharedPointer<ChatMessage>> batch;
+            const QString& conversationId = conversations.at(i % conversations.size());
+            for (int j = 0; j < BENCH_BATCH; ++j) {
+                auto message = QSharedPointer<ChatMessage>(new TextMessage(
+                        QString("contention write %1").arg(i), false, conversationId));
+                message->setTimestamp(QDateTime::currentDateTime());
+                batch.push_back(message);
+            }
+            if (lock)
+                lock->lock();
+            repository.addMessages(conversationId, batch);
+            if (lock)
+                lock->unlock();
+            ++written;
+        }
+        writes += written;
+    });
+    // 读者：每 16 次读取中一次取全部摘要（会话列表刷新），其余取单个会话的快照（打开会话、预取）
+    for (int reader = 0; reader < readers; ++reader) {
+        pool.start([&repository, &conversations, &stop, &reads, &maxReadNs, lock, reader] {
+            quint64 done = 0;
+            qint64 slowest = 0;
+            QElapsedTimer clock;
+            for (int i = reader; !stop; ++i) {
+                clock.start();
+                if (lock)
+                    lock->lock();
+                if (i % 16 == 0) {
+                    const QVector<ConversationSummary> summaries = repository.getSummaries();
+                    Q_UNUSED(summaries);
+                } else {
+                    const ConversationSnapshotPtr snap =
+                            repository.snapshot(conversations.at(i % conversations.size()));
+                    Q_UNUSED(snap);
+                }
+                if (lock)
+                    lock->unlock();
+                slowest = qMax(slowest, clock.nsecsElapsed());
+                ++done;
+            }
+            reads += done;
+            qint64 current = maxReadNs;
+            while (slowest > current && !maxReadNs.compare_exchange_weak(current, slowest)) {
+            }
+        });
+    }
+    QThread::msleep(durationMs);
+    stop = true;
+    pool.waitForDone();
+
+    ContentionStats stats;
+    stats.reads = reads;
+    stats.writes = writes;
+    stats.readsPerSecond = stats.reads * 1000.0 / durationMs;
+    stats.writesPerSecond = stats.writes * 1000.0 / durationMs;
+    stats.maxReadUs = maxReadNs / 1000.0;
+    return stats;
+}
+
+}
+
+RepositoryBenchmark benchmarkRepository(int readers, int durationMs)
+{
+    RepositoryBenchmark result;
+    result.readers = qMax(1, readers);
+    result.durationMs = qMax(100, durationMs);
+    // 仓库是单例，退出时才析构并写回索引；临时目录先于它构造，析构在它之后
+    static QTemporaryDir dir;
+    if (!dir.isValid())
+        return result;
+
+    // 仓库在首次使用时按数据目录构造，此前把数据目录换成临时目录，不碰用户的真实数据
+    qputenv("NETHERLINK_DATA_DIR", dir.path().toLocal8Bit());
+    MessageRepository& repository = MessageRepository::instance();
+    QStringList conversations;
+    const QDateTime start = QDateTime::currentDateTime();
+    for (int i = 0; i < BENCH_CONVERSATIONS; ++i) {
+        conversations.append(QString("bench-%1").arg(i));
+        QVector<QSharedPointer<ChatMessage>> batch;
+        for (int j = 0; j < BENCH_SEED; ++j) {
+            auto message = QSharedPointer<ChatMessage>(new TextMessage(
+                    QString("benchmark message %1").arg(j), j % 2 == 0, conversations.last()));
+            message->setTimestamp(start.addSecs(j));
+            batch.push_back(message);
+        }
+        repository.addMessages(conversations.last(), batch);
+    }
+
+    result.snapshot = runContention(repository, conversations, result.readers, result.durationMs, nullptr);
+    QMutex baseline;
+    result.mutex = runContention(repository, conversations, result.readers, result.durationMs, &baseline);
+    return result;
+}
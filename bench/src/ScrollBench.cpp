@@ -0,0 +1,93 @@
+#include "Benchmarks.h"
+#include "ChatListView.h"
+#include "ChatItemDelegate.h"
+#include <QCoreApplication>
+#include <QScrollBar>
+#include <algorithm>
+#include <functional>
+
+ScrollBenchmark benchmarkScroll(int rows, int frames)
+{
+    constexpr int VIEW_WIDTH = 800;
+    constexpr int VIEW_HEIGHT = 600;
+    constexpr int SCROLL_STEP = 24;     // 匀速滚动时每帧的距离，约每秒 1400 像素
+    constexpr int RESIZE_FRAMES = 30;
+    constexpr double FRAME_BUDGET_MS = 1000.0 / 60;
+
+    ScrollBenchmark result;
+    result.rows = qMax(0, rows);
+    result.frames = qMax(2, frames);
+
+    // 合成会话：长短不一的文本，每分钟一条，每 20 条换一次发送方
+    ChatListModel model;
+    const QDateTime start = QDateTime::currentDateTime().addSecs(-qint64(result.rows) * 60);
+    for (int i = 0; i < result.rows; ++i) {
+        const QString text = QString("benchmark message %1 ").arg(i).repeated(1 + i % 7);
+        auto message = QSharedPointer<TextMessage>::create(text, (i / 20) % 2 == 0, QStringLiteral("bench"));
+        message->setTimestamp(start.addSecs(qint64(i) * 60));
+        message->setSeq(i);
+        model.addMessage(message);
+    }
+
+    ChatItemDelegate delegate;
+    ChatListView view;
+    view.setSpacing(2);
+    view.setItemDelegate(&delegate);
+    view.resize(VIEW_WIDTH, VIEW_HEIGHT);
+    view.show();
+    QCoreApplication::processEvents();
+
+    QScrollBar* vScrollBar = view.verticalScrollBar();
+    QElapsedTimer clock;
+    clock.start();
+    view.setModel(&model);
+    vScrollBar->setValue(vScrollBar->maximum());
+    view.viewport()->repaint();
+    result.openMs = clock.elapsed();
+
+    // 每帧：处理排队的事件（后台排版结果等），改变滚动位置后同步重画
+    auto frame = [&view](const std::function<void()>& step) {
+        QElapsedTimer frameClock;
+        frameClock.start();
+        QCoreApplication::processEvents();
+        step();
+        view.viewport()->repaint();
+        return frameClock.nsecsElapsed() / 1e6;
+    };
+
+    QVector<double> frameMs;
+    frameMs.reserve(result.frames);
+    // 前一半从底部匀速向上滚动，后一半模拟拖动滚动条，在整个范围内跳跃
+    const int steadyFrames = result.frames / 2;
+    for (int i = 0; i < steadyFrames; ++i) {
+        frameMs.append(frame([vScrollBar] { vScrollBar->setValue(vScrollBar->value() - SCROLL_STEP); }));
+    }
+    const int jumpFrames = result.frames - steadyFrames;
+    for (int i = 0; i < jumpFrames; ++i) {
+        frameMs.append(frame([vScrollBar, i, jumpFrames] {
+            vScrollBar->setValue(int(qint64(vScrollBar->maximum()) * (jumpFrames - 1 - i) / qMax(1, jumpFrames - 1)));
+        }));
+    }
+
+    double resizeMs = 0;
+    for (int i = 0; i < RESIZE_FRAMES; ++i) {
+        resizeMs += frame([&view, i] { view.resize(i % 2 == 0 ? VIEW_WIDTH * 4 / 5 : VIEW_WIDTH, VIEW_HEIGHT); });
+    }
+
+    double totalMs = 0;
+    for (double ms : std::as_const(frameMs)) {
+        totalMs += ms;
+        if (ms > FRAME_BUDGET_MS)
+            ++result.slowFrames;
+    }
+    std::sort(frameMs.begin(), frameMs.end());
+    result.averageFrameMs = totalMs / frameMs.size();
+    result.p95FrameMs = frameMs.at(int((frameMs.size() - 1) * 0.95));
+    result.maxFrameMs = frameMs.last();
+    result.averageResizeMs = resizeMs / RESIZE_FRAMES;
+    result.modelBytes = model.memoryUsage();
+    result.layoutBytes = model.layoutCache().memoryUsage();
+    result.indexBytes = view.rowIndexMemoryUsage();
+    result.rowPixmapBytes = delegate.rowCacheMemoryUsage();
+    return result;
+}
@@ -0,0 +1,43 @@
+#include "Benchmarks.h"
+#include "SendJournal.h"
+#include "MessageId.h"
+#include <QTemporaryDir>
+#include <QThreadPool>
+
+SendJournalBenchmark benchmarkSendJournal(int messages, int producers)
+{
+    SendJournalBenchmark result;
+    result.messages = qMax(0, messages);
+    result.producers = qMax(1, producers);
+    QTemporaryDir dir;
+    if (!dir.isValid())
+        return result;
+
+    SendJournal journal(dir.filePath("bench.wal"), SendJournal::Sink(), [] { return true; });
+    if (!journal.start())
+        return result;
+    QElapsedTimer clock;
+    clock.start();
+    QThreadPool pool;
+    pool.setMaxThreadCount(result.producers);
+    for (int producer = 0; producer < result.producers; ++producer) {
+        const int count = result.messages / result.producers
+                + (producer < result.messages % result.producers ? 1 : 0);
+        pool.start([&journal, count] {
+            for (int i = 0; i < count; ++i) {
+                auto message = QSharedPointer<TextMessage>::create(
+                        QString("benchmark message %1").arg(i), true, QStringLiteral("bench"));
+                message->setMessageId(MessageId::next());
+                journal.append(QStringLiteral("bench"), message);
+            }
+        });
+    }
+    pool.waitForDone();
+    // 关闭时等最后一批落盘，计时到此为止
+    journal.shutdown();
+    result.elapsedMs = clock.elapsed();
+    result.commits = journal.commitCount();
+    result.sendsPerSecond = result.messages * 1000.0 / qMax<qint64>(1, result.elapsedMs);
+    result.averageBatch = result.commits > 0 ? double(journal.entryCount()) / result.commits : 0;
+    return result;
+}
@@ -0,0 +1,112 @@
+#include "Benchmarks.h"
+#include "MainWindow.h"
+#include "MessageListWidget.h"
+#include "RepositoryBootstrap.h"
+#include <QCoreApplication>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QFile>
+#include <algorithm>
+
+namespace {
+
+// 会话列表第一次带着会话绘制时，把距启动的毫秒数写入结果文件并退出；
+// 以应用级事件过滤器观察，不需要主窗口提供任何测量接口
+class FirstContentProbe : public QObject {
+public:
+    FirstContentProbe(MainWindow& window, const QElapsedTimer& launchClock, const QString& resultPath, bool seed)
+        : m_window(window), m_launchClock(launchClock), m_resultPath(resultPath), m_seed(seed) {}
+
+    bool eventFilter(QObject* watched, QEvent* event) override
+    {
+        if (m_done || event->type() != QEvent::Paint || !watched->isWidgetType())
+            return false;
+        auto* list = m_window.findChild<MessageListWidget*>();
+        auto* widget = static_cast<QWidget*>(watched);
+        if (!list || list->count() == 0 || (widget != list && !list->isAncestorOf(widget)))
+            return false;
+        m_done = true;
+        QFile file(m_resultPath);
+        if (file.open(QIODevice::WriteOnly))
+            file.write(QByteArray::number(m_launchClock.elapsed()));
+        // 只有预热的一轮保存快照，其余各轮读到的是同一份
+        if (m_seed)
+            m_window.saveStartupSnapshot();
+        QTimer::singleShot(0, qApp, &QCoreApplication::quit);
+        return false;
+    }
+
+private:
+    MainWindow& m_window;
+    QElapsedTimer m_launchClock;
+    QString m_resultPath;
+    bool m_seed;
+    bool m_done = false;
+};
+
+}
+
+StartupBenchmark benchmarkStartup(int runs)
+{
+    StartupBenchmark result;
+    result.runs = qMax(1, runs);
+    QTemporaryDir dir;
+    if (!dir.isValid())
+        return result;
+
+    const auto median = [](QVector<qint64> samples) {
+        if (samples.isEmpty())
+            return -1.0;
+        std::sort(samples.begin(), samples.end());
+        const int mid = samples.size() / 2;
+        return samples.size() % 2 ? double(samples[mid]) : (samples[mid - 1] + samples[mid]) / 2.0;
+    };
+
+    // 先跑一次没有快照的启动：在临时目录中建好消息存储、预热磁盘缓存，并保存之后各轮共用的快照
+    QVector<qint64> stores;
+    QVector<qint64> snapshot;
+    for (int i = -1; i < 2 * result.runs; ++i) {
+        const bool withSnapshot = i >= 0 && i % 2 == 1;
+        const QString resultPath = dir.filePath(QString("run-%1").arg(i + 1));
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert("NETHERLINK_DATA_DIR", dir.filePath("data"));
+        if (!withSnapshot)
+            env.insert("NETHERLINK_NO_SNAPSHOT", "1");
+        QStringList arguments = { QStringLiteral("startup-probe"), resultPath };
+        if (i < 0)
+            arguments.append(QStringLiteral("seed"));
+
+        QProcess child;
+        child.setProcessEnvironment(env);
+        child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        child.start(QCoreApplication::applicationFilePath(), arguments);
+        if (!child.waitForFinished(60000)) {
+            child.kill();
+            child.waitForFinished();
+        }
+        QFile file(resultPath);
+        bool ok = false;
+        const qint64 ms = file.open(QIODevice::ReadOnly) ? file.readAll().trimmed().toLongLong(&ok) : 0;
+        if (!ok) {
+            result.failures++;
+            continue;
+        }
+        if (i >= 0)
+            (withSnapshot ? snapshot : stores).push_back(ms);
+    }
+    result.storesMs = median(stores);
+    result.snapshotMs = median(snapshot);
+    return result;
+}
+
+int runStartupProbe(const QElapsedTimer& launchClock, const QString& resultPath, bool seed)
+{
+    // 与应用的 main 相同：仓库在后台构造，首帧不等待；不连接网络
+    RepositoryBootstrap::instance().start();
+    MainWindow w;
+    FirstContentProbe probe(w, launchClock, resultPath, seed);
+    qApp->installEventFilter(&probe);
+    w.show();
+    return QCoreApplication::exec();
+}
@@ -10,6 +10,9 @@ class TopSearchWidget : public QWidget {
 public:
     explicit TopSearchWidget(QWidget *parent = nullptr);
     void resizeEvent(QResizeEvent *event) override;
+signals:
+    // 搜索框文本变化（已去掉首尾空白）
+    void searchTextChanged(const QString& text);
 protected:
     void paintEvent(QPaintEvent*) Q_DECL_OVERRIDE;
 private:
@@ -21,6 +21,9 @@ TopSearchWidget::TopSearchWidget(QWidget *parent)
             background-color: #EBEBEB;
         }
     )");
+    connect(searchBox->getLineEdit(), &QLineEdit::textChanged, this, [this](const QString& text) {
+        emit searchTextChanged(text.trimmed());
+    });
     searchBox->setFixedHeight(26);
     addButton->setFixedHeight(26);
     setFixedHeight(topMargin + searchBox->height() + bottomMargin);
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <QHash>
+#include <QPixmap>
+#include <QDateTime>
+#include <QMetaType>
+#include "ChatMessage.h"
+#include "StringPool.h"
+#include "MappedSegment.h"
+
+class CompactMessageList;
+
+// 紧凑存储中一条消息的只读视图，按值传递；只在所属列表存活期间有效
+// 接口与 ChatMessage 同名，委托和模型可以直接替换使用
+class MessageView {
+public:
+    MessageView() = default;
+    MessageView(const CompactMessageList* list, int row) : m_list(list), m_row(row) {}
+
+    bool isValid() const { return m_list != nullptr && m_row >= 0; }
+    int row() const { return m_row; }
+
+    qint64 getSeq() const;
+    // 旧版本记录没有 id，为 0
+    quint64 getMessageId() const;
+    qint64 timestampMs() const;
+    QDateTime getTimestamp() const;
+    MessageType getType() const;
+    bool isFromMe() const;
+    bool isInGroupChat() const;
+    bool getIsSelected() const;
+    DeliveryState getDeliveryState() const;
+    GroupRole getRole() const;
+    StringHandle senderHandle() const;
+    QString getSenderId() const;
+    QString getSenderName() const;
+    // 文本直接指向列表的文本区，列表再追加后失效
+    QStringView textView() const;
+    QString getText() const;
+    // 与 ChatMessage::getContent 一致，图片消息为 "[图片]"
+    QString getContent() const;
+    QPixmap getImage() const;
+
+private:
+    const CompactMessageList* m_list = nullptr;
+    int m_row = -1;
+};
+Q_DECLARE_METATYPE(MessageView)
+
+// 消息的紧凑列式存储（struct-of-arrays）
+// 每条消息只占几个定长字段：发送者 id 和名字存为 StringPool 句柄，时间戳存为毫秒，
+// 文本统一放进一段连续的文本区按偏移引用，图片稀疏存放。
+// 也可以直接引用已映射段中的记录（appendRecord）：只取记录头里的定长字段，
+// 文本原地指向映射，发送者与图片在首次访问（绘制）时才解析。
+// 行号分配后不再变化；只追加，被删除的行由上层直接丢弃引用。
+// 线程：只在界面线程使用。
+class CompactMessageList {
+public:
+    enum Flag : quint8 {
+        FromMe    = 0x01,
+        GroupChat = 0x02,
+        Selected  = 0x04,
+        Pending   = 0x08,   // 投递状态，两位都没有即已确认
+        Durable   = 0x10
+    };
+
+    // 追加一条消息，返回其行号；图片在此转为 QPixmap，只能在界面线程调用
+    int append(const ChatMessage& message);
+    // 追加映射中 [offset, offset + length) 处的一条记录，不复制文本；记录无效时返回 -1
+    int appendRecord(const MappedSegmentPtr& segment, quint32 offset, quint32 length);
+
+    int size() const { return int(m_seq.size()); }
+    bool isEmpty() const { return m_seq.isEmpty(); }
+    MessageView at(int row) const { return MessageView(this, row); }
+
+    void setSelected(int row, bool selected);
+    // 本地先行显示的消息：落盘、确认后更新状态，入库后补上序号
+    void setDeliveryState(int row, DeliveryState state);
+    void setSeq(int row, qint64 seq);
+    void clear();
+
+    // 估算占用的堆内存（字节）
+    qint64 memoryUsage() const;
+    // 已解码图片的像素字节数
+    qint64 imageMemoryUsage() const;
+
+private:
+    friend class MessageView;
+
+    // 映射行的记录起点，文本区的行返回空
+    const char* recordOf(int row) const;
+    // 映射行的发送者在首次访问时驻留
+    void resolveSender(int row) const;
+    QStringView text(int row) const;
+    QPixmap image(int row) const;
+
+    QVector<qint64>  m_seq;
+    QVector<quint64> m_messageId;
+    QVector<qint64>  m_timestamp;   // 毫秒时间戳
+    mutable QVector<StringHandle> m_senderId;    // 映射行未解析前为 0
+    mutable QVector<StringHandle> m_senderName;
+    QVector<quint32> m_textOffset;  // 在 m_text 或映射中的起始位置（QChar）
+    QVector<quint32> m_textLength;
+    QVector<quint8>  m_type;        // MessageType
+    QVector<quint8>  m_role;        // GroupRole
+    QVector<quint8>  m_flags;       // Flag
+    QVector<quint16> m_source;      // 0 为文本区，k 为 m_segments[k - 1]
+    QVector<quint32> m_recordOffset; // 映射行的记录在映射中的偏移
+    QVector<MappedSegmentPtr> m_segments;
+    QString          m_text;        // 文本区
+    mutable QHash<int, QPixmap> m_images;   // 行号 -> 图片，只有图片消息才有；映射行首次访问时解码
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QStandardPaths>
+#include <QString>
+
+// 应用数据目录（消息存储、发送日志、启动快照都在其下）
+// 开发调试：设置 NETHERLINK_DATA_DIR 时改用该目录，启动测量的子进程借此不碰用户的真实数据
+inline QString dataLocation()
+{
+    const QString overridden = qEnvironmentVariable("NETHERLINK_DATA_DIR");
+    if (!overridden.isEmpty())
+        return overridden;
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QVector>
+
+// 树状数组（Fenwick tree）：单点增减与前缀和均为 O(log n)，支持在末尾追加
+// 用于把稀疏删除后的逻辑位置和物理位置互相换算，也可以用作累计高度等前缀和索引
+class FenwickTree {
+public:
+    FenwickTree() = default;
+
+    // 以 values 重建，O(n)
+    void build(const QVector<qint64>& values);
+    void clear();
+
+    int size() const { return int(m_tree.size()); }
+    bool isEmpty() const { return m_tree.isEmpty(); }
+
+    // 在末尾追加一个元素，O(log n)
+    void append(qint64 value);
+    // 只保留前 count 个元素，O(1)：节点只覆盖自身及之前的元素，截掉尾部不影响其余节点
+    void truncate(int count);
+    void add(int index, qint64 delta);
+
+    // [0, count) 的和
+    qint64 prefixSum(int count) const;
+    qint64 total() const { return prefixSum(size()); }
+    qint64 valueAt(int index) const;
+
+    // 第一个使 prefixSum(i + 1) > target 的位置 i，即累计和 target 落在哪个元素上；
+    // 要求元素非负，超出总和时返回 size()
+    int find(qint64 target) const;
+
+private:
+    QVector<qint64> m_tree;   // 1 起始的树存于 0 起始的数组：m_tree[i - 1] 对应节点 i
+};
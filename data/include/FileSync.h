@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QFile>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// 把已写入的数据刷到磁盘；QFile::flush 只交给操作系统，断电或系统崩溃时仍可能丢失
+inline bool syncToDisk(QFile& file)
+{
+    if (!file.flush())
+        return false;
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
@@ -1,9 +1,11 @@
 #pragma once
 #include <QObject>
-#include <QMap>
+#include <QHash>
 #include <QVector>
 #include <QMutex>
+#include <QPixmap>
 #include "Group.h"
+#include "StringPool.h"
 
 class GroupRepository : public QObject{
     Q_OBJECT
@@ -11,18 +13,24 @@ public:
     static GroupRepository& instance();
 
     Group getGroup(const QString& groupID);
+    Group getGroup(StringHandle groupID);
     QVector<Group> getAllGroup();
 
     // 可选添加：用户插入、删除接口
     void insertGroup(const Group& group);
     void removeGroup(const QString& groupID);
-    bool isGroup(QString& id);
+    bool isGroup(const QString& id);
+    bool isGroup(StringHandle id);
+    // 圆形群头像，首次取用时生成并放入 QPixmapCache；只能在界面线程调用
+    QPixmap getAvatar(const QString& groupID);
+    QPixmap getAvatar(StringHandle groupID);
 
 private:
     explicit GroupRepository(QObject* parent = nullptr);
     Q_DISABLE_COPY(GroupRepository)
 
-    QMap<QString, Group> groupMap;
+    QHash<StringHandle, Group> groupMap;  // 键为驻留后的群 id
     QMutex mutex; // 用于线程安全
+    const int avatarSize = 48;
 };
 
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <atomic>
+#include "ChatMessage.h"
+#include "MessageRepository.h"
+#include "SpscQueue.h"
+
+// 待入库的一条消息：来自网络的只有原始记录，本地发出的已经是消息对象
+struct IngestItem {
+    QString conversationId;
+    QByteArray record;                      // MessageStore::encode 格式，decode 阶段解码
+    QSharedPointer<ChatMessage> message;
+};
+using IngestBatch = QVector<IngestItem>;
+
+// 消息入库流水线：解码 → 去重 → 持久化 → 建索引 → 通知，每个阶段占用工作池中的一个线程
+// 阶段之间以有界无锁队列相连，下游满时上游阻塞等待，压力一直传导到 submit 的调用方（网络线程停止读套接字）。
+// 每个队列配两个信号量：m_ready 计可取的批次，m_free 计空位；空闲的阶段阻塞在信号量上，不轮询。
+// 界面线程只收到最终合并后的变更通知：上一次通知尚未被处理时，新的变更继续合并，不会在事件队列里堆积。
+// submit 可在任意线程调用，多个生产者之间用互斥锁串行化后进入首个队列。
+class IngestPipeline : public QObject {
+    Q_OBJECT
+public:
+    enum Stage {
+        Decode,
+        Dedupe,
+        Persist,
+        Index,
+        Notify,
+        StageCount
+    };
+
+    struct StageMetrics {
+        QString name;
+        int depth = 0;          // 输入队列当前积压的批次数
+        int capacity = 0;
+        int highWater = 0;      // 积压峰值
+        quint64 processed = 0;  // 处理过的消息数
+        quint64 stalls = 0;     // 向该阶段推送时遇到队列满的次数
+    };
+
+    struct Metrics {
+        QVector<StageMetrics> stages;
+        quint64 submitted = 0;
+        quint64 duplicates = 0;
+        quint64 malformed = 0;          // 无法解码而丢弃的记录
+        bool uiPending = false;         // 有一次通知已投递但界面尚未处理
+        qint64 lastUiLatencyMs = 0;     // 通知从投递到界面处理的耗时
+        qint64 maxUiLatencyMs = 0;
+    };
+
+    static constexpr int QUEUE_CAPACITY = 256;      // 每个阶段的输入队列（批次数）
+    static constexpr int PERSIST_MERGE_LIMIT = 32;  // 持久化阶段一次最多合并的批次数
+    static constexpr int DEDUPE_WINDOW = 8192;      // 去重记住的最近消息数
+    static constexpr int UI_LAG_WARN_MS = 100;
+
+    static IngestPipeline& instance();
+
+    // 提交一批消息，下游积压时阻塞；流水线已关闭时返回 false
+    bool submit(IngestBatch batch);
+    bool submit(const QString& conversationId, QSharedPointer<ChatMessage> message);
+
+    // 停止接收并等待已提交的消息全部处理完
+    void shutdown();
+
+    Metrics metrics() const;
+
+signals:
+    // 界面线程处理通知的延迟超过 UI_LAG_WARN_MS
+    void uiLagging(qint64 latencyMs);
+
+private:
+    using MessageBatches = QHash<QString, QVector<QSharedPointer<ChatMessage>>>;
+
+    struct StageState {
+        std::atomic<int> highWater{0};
+        std::atomic<quint64> processed{0};
+        std::atomic<quint64> stalls{0};
+        std::atomic_bool done{false};
+    };
+
+    explicit IngestPipeline(QObject* parent = nullptr);
+    ~IngestPipeline() override;
+    Q_DISABLE_COPY(IngestPipeline)
+
+    void runDecode();
+    void runDedupe();
+    void runPersist();
+    void runIndex();
+    void runNotify();
+
+    // 推入 stage 的输入队列，满时阻塞到下游腾出空位
+    template <typename T>
+    void push(Stage stage, SpscQueue<T>& queue, T& value);
+    // 取出 stage 的输入，队列空时阻塞；队列空且上游已结束时返回 false
+    template <typename T>
+    bool pop(Stage stage, SpscQueue<T>& queue, T& value);
+    // 不等待地取出一个批次并归还空位
+    template <typename T>
+    bool take(Stage stage, SpscQueue<T>& queue, T& value);
+    void finish(Stage stage);
+    bool isDuplicate(const QString& conversationId, const ChatMessage& message);
+    void postNotification(QSet<QString> conversationIds);
+
+    SpscQueue<IngestBatch> m_submitted{QUEUE_CAPACITY};
+    SpscQueue<IngestBatch> m_decoded{QUEUE_CAPACITY};
+    SpscQueue<EncodedBatches> m_unique{QUEUE_CAPACITY};   // 网络来的消息带着原始记录，持久化时直接写入
+    SpscQueue<MessageBatches> m_persisted{QUEUE_CAPACITY};
+    SpscQueue<QSet<QString>> m_indexed{QUEUE_CAPACITY};
+
+    StageState m_stages[StageCount];
+    QSemaphore m_ready[StageCount];     // 只用于休眠与唤醒，数据走无锁队列；可能多于实际批次数，取空时继续等待
+    QSemaphore m_free[StageCount];      // 各输入队列的空位，初始为 QUEUE_CAPACITY
+    QMutex m_submitMutex;               // 串行化多个生产者
+    std::atomic_bool m_stopping{false};
+    std::atomic<quint64> m_submittedCount{0};
+    std::atomic<quint64> m_duplicates{0};
+    std::atomic<quint64> m_malformed{0};
+
+    // 去重窗口只在去重阶段线程访问
+    QSet<size_t> m_recent;            // (会话, 消息 id) 的哈希
+    QQueue<size_t> m_recentOrder;
+
+    QElapsedTimer m_clock;
+    std::atomic_bool m_uiPending{false};
+    std::atomic<qint64> m_lastUiLatency{0};
+    std::atomic<qint64> m_maxUiLatency{0};
+    QThreadPool m_pool;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QSharedPointer>
+
+// 只读映射的段文件
+// 已封存的段不会再被改写，映射后记录可以原地访问，不必读入内存；页面按需换入，未访问的部分不占物理内存。
+// 持有者释放最后一个引用时解除映射。段被整理或压缩替换后，旧映射在引用释放前仍然有效
+// （Windows 下映射存活期间旧文件删不掉，索引已不再引用它，不影响读取）。
+class MappedSegment {
+public:
+    explicit MappedSegment(const QString& path);
+    ~MappedSegment();
+    Q_DISABLE_COPY(MappedSegment)
+
+    bool isValid() const { return m_data != nullptr; }
+    const char* data() const { return reinterpret_cast<const char*>(m_data); }
+    qint64 size() const { return m_size; }
+
+    // [offset, offset + length) 是否落在映射范围内
+    bool contains(qint64 offset, qint64 length) const;
+
+private:
+    QFile m_file;
+    uchar* m_data = nullptr;
+    qint64 m_size = 0;
+};
+using MappedSegmentPtr = QSharedPointer<const MappedSegment>;
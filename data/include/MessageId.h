@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QtGlobal>
+
+// 64 位全局唯一消息 id（类 Snowflake）
+// 高 41 位为自 EPOCH_MS 起的毫秒数，中间 10 位为节点号，低 12 位为同一毫秒内的序号。
+// id 大致按生成时间递增；同一毫秒内序号用尽时借用下一毫秒，时钟回拨时沿用上次的时间继续递增。
+namespace MessageId {
+    constexpr qint64 EPOCH_MS = 1704067200000LL;    // 2024-01-01T00:00:00Z
+    constexpr int NODE_BITS = 10;
+    constexpr int SEQUENCE_BITS = 12;
+
+    // 线程安全
+    quint64 next();
+
+    // 本进程的节点号，启动时随机选取
+    quint32 node();
+
+    // id 中的生成时间（毫秒时间戳）
+    qint64 timestampOf(quint64 id);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QVector>
+#include <QSet>
+#include <QQueue>
+
+// 单个会话的消息 id 去重过滤器：布隆过滤器在前，最近 id 的精确集合在后
+// 布隆过滤器判定不存在（绝大多数新消息）时只需一次哈希和几次位测试；判定可能存在时再查精确集合。
+// 精确集合只保留最近 RECENT_CAPACITY 个 id，更早的 id 重放会被当作新消息接受。
+// 非线程安全，由调用方加锁。
+class MessageIdFilter {
+public:
+    static constexpr int RECENT_CAPACITY = 65536;
+    static constexpr int INITIAL_BITS = 1 << 14;
+    static constexpr int MAX_BITS = 1 << 20;       // 128 KB
+    static constexpr int BITS_PER_ID = 10;         // 配合 HASH_COUNT 误判率约 1%
+    static constexpr int HASH_COUNT = 4;
+
+    MessageIdFilter();
+
+    // 是否是已见过的 id
+    bool contains(quint64 id) const;
+    void insert(quint64 id);
+
+    int size() const { return int(m_recent.size()); }
+    qint64 memoryUsage() const;
+
+private:
+    bool mayContain(quint64 id) const;
+    void setBits(quint64 id);
+    // 容量不够时扩大位数组（或到上限后清空），并用精确集合重建
+    void rebuild();
+
+    QVector<quint64> m_bits;
+    quint32 m_mask;             // 位数 - 1，位数为 2 的幂
+    int m_bloomCount = 0;       // 布隆过滤器中的 id 数
+    QSet<quint64> m_recent;
+    QQueue<quint64> m_order;    // 精确集合的淘汰顺序
+};
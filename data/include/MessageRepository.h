@@ -1,40 +1,259 @@
 #pragma once
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QThreadPool>
+#include <QCache>
 #include <QVector>
 #include <QMutex>
 #include <QSharedPointer>
+#include <QDateTime>
+#include <memory>
 #include "ChatMessage.h"
+#include "MessageStore.h"
+#include "MessageSearchIndex.h"
+#include "MessageIdFilter.h"
+#include "StringPool.h"
 
+// 会话摘要：会话列表只需要这些信息，增删消息时增量维护，无需接触消息本身
+struct ConversationSummary {
+    QString conversationId;
+    QSharedPointer<ChatMessage> lastMessage;
+    int totalCount = 0;
+    int unreadCount = 0;      // 已读游标之后的来信数，写入与标记已读时增量维护
+    qint64 readSeq = 0;       // 已读游标：序号不大于它的消息都已读
+    QDateTime lastTimestamp;
+};
+
+// 会话快照：发布后不再修改，读者拿到后可以无锁访问
+// 写者复制旧快照、修改后整体替换（copy-on-write），旧快照在最后一个读者释放后回收
+struct ConversationSnapshot {
+    ConversationSummary summary;
+    QVector<QSharedPointer<ChatMessage>> tail;  // 最新的若干条消息，按时间升序
+};
+using ConversationSnapshotPtr = std::shared_ptr<const ConversationSnapshot>;
+
+// 待写入的一条消息；record 不为空时是它的 MessageStore::encode 格式记录，写入时直接使用，不再重新编码
+struct EncodedMessage {
+    QSharedPointer<ChatMessage> message;
+    QByteArray record;
+};
+using EncodedBatches = QHash<QString, QVector<EncodedMessage>>;
+
+// 一条搜索结果
+struct MessageSearchHit {
+    QString conversationId;
+    int messageIndex = -1;  // 会话内的消息索引
+    qint64 seq = -1;
+    int score = 0;
+};
+
+// 冷热分层策略：早于 maxHotAgeSecs 或不在最新 hotMessagesPerConversation 条之内的消息转为压缩存储
+struct TieringPolicy {
+    qint64 maxHotAgeSecs = 30 * 24 * 3600;
+    int hotMessagesPerConversation = 5000;
+};
+
+// 存储占用统计
+struct StorageStats {
+    int conversations = 0;
+    int hotMessages = 0;
+    int coldMessages = 0;
+    qint64 hotBytes = 0;
+    qint64 coldBytes = 0;      // 压缩后的字节数
+    int cachedPages = 0;
+    int snapshotMessages = 0;  // 快照中常驻内存的消息数
+    quint64 duplicatesDropped = 0;  // 因消息 id 重复而忽略的写入
+    quint64 movedToCold = 0;        // 本次运行中由分层策略转为压缩存储的消息数
+};
+
+// 消息仓库
+// 读：摘要与最新消息来自原子发布的快照，不加锁；更早的消息按页从磁盘读取，只锁页缓存。
+// 写：addMessage/removeMessage 等由 m_writeMutex 串行化，完成后发布新快照。
+// 写入按消息 id 幂等：没有 id 的消息入库时分配，已见过的 id 直接忽略，不产生任何变更。
 class MessageRepository : public QObject {
     Q_OBJECT
 public:
     static MessageRepository& instance();
 
-    // 获取某会话的全部消息
+    // 会话的当前快照（无锁），会话不存在时返回空指针
+    ConversationSnapshotPtr snapshot(const QString& conversationId) const;
+    ConversationSnapshotPtr snapshot(StringHandle conversationId) const;
+
+    // 获取某会话的全部消息（会逐页从磁盘加载，大会话慎用）
     QVector<QSharedPointer<ChatMessage>> getMessages(const QString& conversationId);
 
     // 获取某会话的最后一条消息（可能为 nullptr）
     QSharedPointer<ChatMessage> getLastMessage(const QString& conversationId);
 
+    // 会话中的消息条数
+    int messageCount(const QString& conversationId);
+
+    // 单个会话的摘要
+    ConversationSummary getSummary(const QString& conversationId);
+
+    // 所有会话的摘要，会话列表一次遍历即可建好
+    QVector<ConversationSummary> getSummaries();
+
+    // 把已读游标推进到 upToSeq（不会后退，超过最后一条时按最后一条算），游标持久化保存
+    void markRead(const QString& conversationId, qint64 upToSeq);
+
+    // 会话被打开后清零未读数，等同于标记到最后一条消息
+    void clearUnread(const QString& conversationId);
+
+    // 获取序号小于 beforeSeq 的最近 count 条消息（按时间升序），用于向上翻页
+    QVector<QSharedPointer<ChatMessage>> fetchRange(const QString& conversationId,
+                                                    qint64 beforeSeq, int count);
+
+    // 获取最新的 count 条消息（按时间升序），用于打开会话时的首屏
+    QVector<QSharedPointer<ChatMessage>> fetchLatest(const QString& conversationId, int count);
+
+    // 与 fetchRange 相同的范围，已封存段中的消息只返回映射位置，由视图在绘制时解析；
+    // 不经过页缓存，翻阅大量历史时内存只随实际绘制的行增长
+    QVector<MessageStore::MappedRecord> mapRange(const QString& conversationId, qint64 beforeSeq, int count);
+
+    // 全文搜索文本消息，结果按相关度排序
+    QVector<MessageSearchHit> search(const QString& query, int limit = 100);
+
+    // 冷热分层策略，新策略在下一轮后台整理时生效
+    void setTieringPolicy(const TieringPolicy& policy);
+    TieringPolicy tieringPolicy();
+
+    // 各会话冷热数据与内存缓存的汇总（会访问磁盘索引）
+    StorageStats storageStats();
+
+    // 把已写入的消息刷到磁盘，成功后发送日志才能清空已提交的条目
+    bool syncStorage();
+
+    // ids 中已写入过该会话的消息 id（包括之后被删除的），只查看时间戳不早于 sinceMs 的记录；
+    // 不经过去重过滤器，供发送日志重放判断条目是否已入库
+    QSet<quint64> storedMessageIds(const QString& conversationId, const QSet<quint64>& ids, qint64 sinceMs);
+
 public slots:
     // 添加一条消息到会话（单聊或群聊），会发 lastMessageChanged
     void addMessage(const QString& conversationId,
                     QSharedPointer<ChatMessage> message);
 
+    // 批量添加同一会话的消息，只发布一次快照，不逐条发 lastMessageChanged
+    void addMessages(const QString& conversationId,
+                     const QVector<QSharedPointer<ChatMessage>>& batch);
+
+    // 多个会话的批量导入（如登录后补拉离线消息），所有会话一次发布
+    void ingest(const QHash<QString, QVector<QSharedPointer<ChatMessage>>>& batches);
+
+public:
+    // 以下三步合起来等同 ingest，供 IngestPipeline 分阶段调用（任意线程）
+    // 写入存储并一次发布快照，不建搜索索引、不发通知；返回写入成功的消息（已分配序号）
+    QHash<QString, QVector<QSharedPointer<ChatMessage>>>
+    persist(const QHash<QString, QVector<QSharedPointer<ChatMessage>>>& batches);
+    // 同上，带有原始记录的消息直接写入记录（图片不必再编码一次）
+    QHash<QString, QVector<QSharedPointer<ChatMessage>>> persist(const EncodedBatches& batches);
+    // 把已写入的消息加入全文索引
+    void indexMessages(const QHash<QString, QVector<QSharedPointer<ChatMessage>>>& batches);
+    // 记录会话变更，合并窗口结束后在仓库线程发 conversationsChanged
+    void notifyChanged(const QSet<QString>& conversationIds);
+
+public slots:
+
     // 删除某会话中索引为 index 的消息，之后发 lastMessageChanged
     void removeMessage(const QString& conversationId, int index);
 
+    // 按消息 id 删除消息；id 不随删除变化，适合长期持有的引用。
+    // 尚未入库的消息（如还在发送日志里）先记下，入库时直接写成墓碑，重开会话不会再出现
+    void removeMessageById(const QString& conversationId, quint64 messageId);
+
 signals:
     // conversationId 对应的最后一条消息已更新（nullptr 表示已无消息）
     void lastMessageChanged(const QString& conversationId,
                             QSharedPointer<ChatMessage> lastMessage);
 
+    // 一批会话的摘要发生了变化；同一帧内的所有改动合并为一次
+    void conversationsChanged(const QSet<QString>& conversationIds);
+
+    // 会话的未读数发生了变化，与 conversationsChanged 一同合并发出，只针对未读数确有变化的会话
+    void unreadChanged(const QString& conversationId, int unreadCount);
+
+private slots:
+    void flushChanges();
+
 private:
-    explicit MessageRepository(QObject* parent = nullptr);
+    explicit MessageRepository(const QString& rootPath, QObject* parent = nullptr);
+    ~MessageRepository() override;
     Q_DISABLE_COPY(MessageRepository)
 
-    QMap<QString, QVector<QSharedPointer<ChatMessage>>> m_store;
-    QMutex m_mutex;
+    using MessagePage = QVector<QSharedPointer<ChatMessage>>;
+    using SnapshotMap = QHash<StringHandle, ConversationSnapshotPtr>;  // 键为驻留后的会话 id
+
+    static constexpr int PAGE_SIZE = 64;         // 每页消息数
+    static constexpr int PAGE_CACHE_SIZE = 256;  // 常驻内存的页数上限
+    static constexpr int TAIL_SIZE = 128;        // 快照中保留的最新消息数，覆盖打开会话的首屏
+    static constexpr int CHANGE_COALESCE_MS = 16; // 变更通知的合并窗口，约一帧
+    static constexpr int INDEX_SAVE_DELAY_MS = 5000; // 搜索索引变更后延迟存盘
+    static constexpr int DEDUPE_SEED_COUNT = 1024;  // 会话首次写入时载入去重过滤器的最近消息数
+    static constexpr int TIERING_START_DELAY_MS = 30 * 1000;      // 启动后首次冷数据整理
+    static constexpr int TIERING_INTERVAL_MS = 10 * 60 * 1000;    // 冷数据整理周期
+
+    QString searchIndexPath() const;
+    QString readCursorsPath() const;
+    void seedSampleMessages();
+    // 补建磁盘上比搜索索引更新的消息
+    void catchUpSearchIndex();
+    void saveSearchIndex();
+    void loadReadCursors();
+    void saveReadCursors();
+    // 按策略压缩各会话的冷数据，在 m_ioPool 中执行
+    void applyTiering();
+    // 墓碑积累到阈值后把整理任务排进 m_ioPool，同一会话只排一次
+    void scheduleCompaction(const QString& conversationId);
+    // 冷数据读取，内部持有 m_pageMutex
+    MessagePage readRange(const QString& conversationId, int first, int last);
+    // 以下函数要求调用方已持有 m_pageMutex
+    MessagePage loadPage(const QString& conversationId, int page);
+    void invalidatePages(StringHandle conversationId, int fromIndex);
+    static quint64 pageKey(const QString& conversationId, int page);
+
+    // 以下函数要求调用方已持有 m_writeMutex
+    ConversationSnapshot buildSnapshot(const QString& conversationId);
+    ConversationSnapshot currentSnapshot(const QString& conversationId);
+    bool appendLocked(const QString& conversationId, ConversationSnapshot& next,
+                      const QSharedPointer<ChatMessage>& message, bool index = true,
+                      const QByteArray& record = QByteArray());
+    bool removeLocked(const QString& conversationId, ConversationSnapshot& next, int index);
+    // 消息 id 为 messageId 的消息的索引，先查快照尾部再查存储；不存在时返回 -1
+    int indexOfIdLocked(const QString& conversationId, quint64 messageId);
+    // 删除索引为 index 的消息并发布新快照，lastMsg 返回删除后的最后一条
+    bool removeAndPublishLocked(const QString& conversationId, int index, QSharedPointer<ChatMessage>& lastMsg);
+    // 会话的去重过滤器，首次访问时用最近的消息填充
+    MessageIdFilter& idFilter(const QString& conversationId);
+    void publish(const QString& conversationId, ConversationSnapshot next);
+    void publish(QHash<QString, ConversationSnapshot> updates);
+
+    // 记录发生变化的会话，合并窗口结束后统一发 conversationsChanged（任意线程可调用）
+    void markChanged(const QSet<QString>& conversationIds);
+
+    std::shared_ptr<const SnapshotMap> loadSnapshots() const;
+
+    QString m_rootPath;
+    MessageStore m_storage;
+    QCache<quint64, MessagePage> m_pages;  // 键为 (会话句柄, 页号)
+    QMutex m_pageMutex;       // 保护 m_pages
+    QMutex m_writeMutex;      // 串行化写者，读者不获取
+    std::shared_ptr<const SnapshotMap> m_snapshots;  // 只通过 std::atomic_load/atomic_store 访问
+    QSet<QString> m_pendingChanges;
+    QMutex m_pendingMutex;    // 保护 m_pendingChanges、m_compactionQueued
+    QSet<QString> m_compactionQueued;
+    QHash<StringHandle, MessageIdFilter> m_idFilters;  // 由 m_writeMutex 保护
+    QHash<StringHandle, QSet<quint64>> m_removedBeforeStored;  // 入库前已被删除的消息 id，由 m_writeMutex 保护
+    std::atomic<quint64> m_duplicates{0};
+    std::atomic<quint64> m_movedToCold{0};
+    QHash<StringHandle, qint64> m_readCursors;  // 各会话的已读游标，由 m_writeMutex 保护
+    std::atomic<bool> m_cursorsDirty{false};
+    QHash<QString, int> m_notifiedUnread;      // 上次通知出去的未读数，只在仓库线程访问
+    MessageSearchIndex m_searchIndex;
+    QTimer m_indexSaveTimer;  // 两个定时器以仓库为父对象，随仓库迁移到界面线程
+    QTimer m_tieringTimer;
+    TieringPolicy m_tieringPolicy;  // 由 m_writeMutex 保护
+    QThreadPool m_ioPool;     // 后台存盘、冷数据压缩与墓碑整理，单线程
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+#include <QHash>
+#include <QReadWriteLock>
+#include <atomic>
+#include "StringPool.h"
+
+// 消息全文检索的倒排索引
+// 分词：连续的中日韩字符切成相邻二元组（单字成词），字母数字串按小写整词，其余字符作为分隔。
+// 建索引时每个汉字另外登记为单字词条，最常见的单字查询直接取一张倒排表。
+// 每条消息按加入顺序分配文档号，倒排表只追加、天然有序；删除只标记文档，存盘时再压实。
+// 线程安全：查询取读锁，更新取写锁。
+class MessageSearchIndex {
+public:
+    struct Hit {
+        StringHandle conversation = 0;
+        qint64 seq = -1;
+        int score = 0;      // 查询词在消息中的总出现次数
+    };
+
+    static constexpr quint32 FILE_MAGIC = 0x58494C4E;  // "NLIX"
+    static constexpr quint16 FILE_VERSION = 2;         // 2：登记单字词条
+
+    // 把一条消息的文本加入索引，同一会话内 seq 通常递增（乱序时代价为 O(n)）
+    void add(StringHandle conversation, qint64 seq, QStringView text);
+
+    // 从索引中移除一条消息
+    void remove(StringHandle conversation, qint64 seq);
+
+    // 包含全部查询词的消息，按得分降序、同分时新消息在前，最多返回 limit 条
+    QVector<Hit> search(const QString& query, int limit) const;
+
+    // 会话中已建索引的最大序号，没有时返回 0
+    qint64 watermark(StringHandle conversation) const;
+
+    bool isDirty() const;
+    // 存盘时丢弃已删除的文档并重新编号
+    bool save(const QString& path);
+    bool load(const QString& path);
+
+    // withUnigrams 为真时，长度超过 1 的汉字串再逐字输出单字词条（建索引用）
+    static QStringList tokenize(QStringView text, bool withUnigrams = false);
+
+private:
+    struct DocRef {
+        StringHandle conversation;  // 0 表示已删除
+        quint32 seq;
+    };
+    struct Posting {
+        quint32 doc;
+        quint32 count;              // 词在该消息中出现的次数
+    };
+    using PostingList = QVector<Posting>;
+
+    // 要求调用方已持有锁
+    int findDoc(StringHandle conversation, qint64 seq) const;
+
+    QVector<DocRef> m_docs;                                   // 下标即文档号
+    QHash<StringHandle, QVector<quint32>> m_conversationDocs; // 会话内按序号递增的文档号
+    QHash<QString, PostingList> m_postings;
+    std::atomic_bool m_dirty{false};
+    mutable QReadWriteLock m_lock;
+};
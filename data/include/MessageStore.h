@@ -0,0 +1,212 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QFile>
+#include <QMutex>
+#include <QCache>
+#include <QSharedPointer>
+#include <functional>
+#include "ChatMessage.h"
+#include "FenwickTree.h"
+#include "MappedSegment.h"
+
+// 消息持久化存储
+// 每个会话对应一个目录：只追加的段文件（seg-XXXXXXXX.log）保存消息记录，
+// 定长索引文件（index.idx）记录每条消息所在的段、偏移与长度，读取时按索引随机访问。
+// 冷数据：已封存的段可整体压缩为块文件（seg-XXXXXXXX.z），索引条目改指向所在的压缩块，读取时按块解压。
+// 读取：已封存的段只读映射（mmap），记录原地访问，不经过读缓冲。
+// 删除：只在索引条目上打墓碑标记并原地改写该条目，其余条目的位置不动；对外的消息索引是存活条目中的名次，
+// 由树状数组在 O(log n) 内与物理位置互相换算。墓碑由后台整理（compact）统一清除并回收段空间。
+// 线程安全：所有公开接口内部加锁。
+class MessageStore {
+public:
+    // 段文件中的记录头（小端，后接 senderId、senderName 的 UTF-16 数据和负载）
+    // 版本 2 起记录头之后紧跟 8 字节的消息 id，版本 1 的记录没有 id
+    struct RecordHeader {
+        quint32 magic;
+        quint16 version;
+        quint8  type;             // MessageType
+        quint8  flags;            // RecordFlag
+        quint8  role;             // GroupRole
+        quint8  reserved[3];
+        quint32 senderIdLength;   // QChar 个数
+        quint32 senderNameLength; // QChar 个数
+        quint32 payloadLength;    // 字节数
+        qint64  seq;
+        qint64  timestamp;        // 毫秒时间戳
+    };
+
+    // 索引文件中的定长条目
+    struct IndexEntry {
+        qint64  seq;
+        qint64  timestamp;
+        quint32 segment;
+        quint32 offset;
+        quint32 length;
+        quint32 flags;
+    };
+
+    enum RecordFlag : quint8 {
+        FromMe    = 0x01,
+        GroupChat = 0x02
+    };
+
+    // IndexEntry::flags 中 RecordFlag 之外的位
+    enum IndexFlag : quint32 {
+        Compressed = 0x100,       // 记录位于压缩块中，offset/length 指压缩块，16~23 位为块内序号
+        Deleted    = 0x200,       // 墓碑，等待整理时清除
+        Compacted  = 0x400        // 记录位于整理后的段文件（seg-XXXXXXXX.c）中
+    };
+
+    // 冷热分层统计
+    struct TierStats {
+        int hotMessages = 0;
+        int coldMessages = 0;
+        qint64 hotBytes = 0;      // 未压缩记录的字节数
+        qint64 coldBytes = 0;     // 压缩块的字节数
+    };
+
+    // 一条消息在映射中的位置；不在已封存原始段中的记录（当前可写段、冷数据块）直接解码为 message
+    struct MappedRecord {
+        MappedSegmentPtr segment;
+        quint32 offset = 0;
+        quint32 length = 0;
+        QSharedPointer<ChatMessage> message;
+    };
+
+    static constexpr quint32 RECORD_MAGIC = 0x524D4C4E;          // "NLMR"
+    static constexpr quint16 RECORD_VERSION = 2;
+    static constexpr qint64  SEGMENT_SIZE_LIMIT = 4 * 1024 * 1024; // 单个段文件上限
+    static constexpr int     BLOCK_MAX_RECORDS = 255;              // 压缩块内最多记录数（序号占 8 位）
+    static constexpr qint64  BLOCK_TARGET_SIZE = 64 * 1024;        // 压缩前的块大小目标
+    static constexpr int     BLOCK_CACHE_SIZE = 8 * 1024;          // 解压块缓存上限（KB）
+    static constexpr int     COMPACT_MIN_TOMBSTONES = 64;          // 墓碑少于此数不整理
+    static constexpr int     COMPACT_MAX_TOMBSTONES = 4096;        // 墓碑达到此数总是整理
+    static constexpr int     ID_SCAN_CHUNK = 256;                  // 按 id 查找时每次读取的条目数
+
+    explicit MessageStore(const QString& rootPath);
+    ~MessageStore();
+
+    // 磁盘上已有的会话
+    QStringList conversations() const;
+
+    // 会话中的消息条数
+    int count(const QString& conversationId);
+
+    // 会话中序号大于 afterSeq 的非本人发送的消息条数（二分定位后查前缀和，O(log n)）
+    int incomingCount(const QString& conversationId, qint64 afterSeq = 0);
+
+    // 把所有已打开会话的当前段与索引刷到磁盘（fsync），供发送日志做检查点
+    bool sync();
+
+    // 追加一条消息，返回分配的序号；失败返回 -1
+    // encoded 为同一条消息已编码好的记录（如网络收到的原始记录）时直接写入，只改写序号与消息 id，不再重新编码
+    qint64 append(const QString& conversationId, const ChatMessage& message, const QByteArray& encoded = QByteArray());
+
+    // 第一条序号不小于 seq 的消息的索引（二分查找），不存在时返回 count()
+    int lowerBound(const QString& conversationId, qint64 seq);
+
+    // 序号为 seq 的消息的索引，不存在（如已删除）时返回 -1
+    int indexOf(const QString& conversationId, qint64 seq);
+
+    // 读取 [first, first + count) 范围内的消息，越界部分被忽略
+    QVector<QSharedPointer<ChatMessage>> read(const QString& conversationId, int first, int count);
+
+    // 与 read 相同的范围，已封存段中的记录只返回映射位置，不解码、不分配消息对象
+    QVector<MappedRecord> mapRecords(const QString& conversationId, int first, int count);
+
+    // 消息 id 为 messageId 的存活消息的索引，从最新的消息往前只读记录头查找；不存在时返回 -1
+    int indexOfId(const QString& conversationId, quint64 messageId);
+
+    // [first, first + count) 范围内消息的 id，只读记录头；旧版本记录没有 id，不计入
+    QVector<quint64> messageIds(const QString& conversationId, int first, int count);
+
+    // ids 中曾写入该会话的消息 id，已删除（仍是墓碑）的也算；只查看时间戳不早于 sinceMs 的记录。
+    // 发送日志重放时据此跳过已入库的条目
+    QSet<quint64> existingIds(const QString& conversationId, const QSet<quint64>& ids, qint64 sinceMs);
+
+    // 删除索引为 index 的消息（写墓碑，O(log n)），其后消息的索引减一，序号不变
+    bool remove(const QString& conversationId, int index);
+
+    // 会话中尚未清除的墓碑数
+    int tombstoneCount(const QString& conversationId);
+    bool needsCompaction(const QString& conversationId);
+
+    // 清除墓碑：从索引中摘掉已删除的条目，并重写一半以上是已删除记录的已封存段。
+    // 段文件的复制在锁外进行，只在切换索引时短暂持锁，不阻塞读者。最新的消息已被删除时保留一个零长度墓碑，
+    // 使重启后的序号接着删除前的最大序号。返回回收的字节数，失败返回 -1
+    qint64 compact(const QString& conversationId);
+
+    // 把已封存、且每条消息都早于 olderThanMs 或不在最新 keepNewest 条之内的段压缩为冷数据，
+    // 返回本次被压缩的消息条数。与整理一样，读段、压缩与写块文件在锁外进行，只在切换索引时短暂持锁
+    int compressCold(const QString& conversationId, qint64 olderThanMs, int keepNewest);
+
+    TierStats tierStats(const QString& conversationId);
+
+    static QByteArray encode(const ChatMessage& message, qint64 seq);
+    static QSharedPointer<ChatMessage> decode(const char* data, qint64 size);
+    // 复制 record 并改写其中的序号与消息 id；记录无效或是没有 id 字段的旧版本时返回空
+    static QByteArray restamp(const QByteArray& record, qint64 seq, quint64 messageId);
+    // 记录中的消息 id；记录无效或是没有 id 字段的旧版本时返回 0
+    static quint64 recordId(const char* data, qint64 size);
+    // 记录头（含消息 id）的字节数
+    static qint64 headerSize(const RecordHeader& header);
+    // 校验长度为 size 的整条记录，返回负载相对记录起点的偏移；记录无效时返回 -1
+    static qint64 payloadOffset(const RecordHeader& header, qint64 size);
+
+private:
+    struct Log {
+        QString dir;
+        QVector<IndexEntry> index;
+        QFile indexFile;
+        QFile segmentFile;          // 当前可写段
+        FenwickTree live;           // 每个条目存活为 1、墓碑为 0
+        FenwickTree incoming;       // 存活的来信（非本人发送）为 1，其余为 0，供未读计数
+        QHash<quint64, MappedSegmentPtr> maps;  // 已封存段的映射，键为 段号 << 1 | 是否整理过
+        int tombstones = 0;
+        quint32 activeSegment = 0;
+        qint64 nextSeq = 1;
+    };
+
+    // 打开会话的日志；会话目录不存在时，只有 create 为真（写入）才新建，否则返回空，读取不留下空目录和文件
+    Log* openLog(const QString& conversationId, bool create = false);
+    bool openSegment(Log* log, quint32 segment);
+    bool rewriteIndex(Log* log);
+    // 依次访问 [first, first + count) 范围内每条存活记录的原始字节；记录来自映射时 mapping 非空，data 指向映射内部
+    using RecordVisitor = std::function<void(const char* data, qint64 size, const MappedSegmentPtr& mapping)>;
+    void forEachRecord(Log* log, int first, int count, const RecordVisitor& visit);
+    // 依次访问 log->index 中给定位置（升序，可含墓碑）的记录
+    void visitSlots(Log* log, const QVector<int>& slots, const RecordVisitor& visit);
+    // 条目所在的已封存原始段的映射，当前可写段与压缩块返回空
+    MappedSegmentPtr mapSegment(Log* log, const IndexEntry& entry);
+    // 段文件被替换前丢弃映射，已经交出的映射由持有者释放
+    void unmapSegment(Log* log, quint32 segment);
+    // 按索引中的标志重建 live 与 incoming 两棵树及墓碑数
+    void rebuildLive(Log* log);
+    // 删除目录中索引不再引用的段文件与块文件
+    void removeOrphans(Log* log);
+    // 删除已被替换的文件，删不掉时记入待删列表并返回 false；调用方须持有 m_maintenanceMutex
+    bool removeFile(const QString& path);
+    void retryRemovals();
+    // 第 index 条存活消息在 log->index 中的位置
+    int physicalIndex(const Log* log, int index) const;
+    // 把 sourcePath 中 entries 对应的记录压缩成块，写入 blocks，并把 entries 改为指向块；不访问共享状态
+    static bool compressSegment(const QString& sourcePath, QVector<IndexEntry>& entries, QByteArray& blocks);
+    QByteArray readBlock(const Log* log, const IndexEntry& entry);
+    QString segmentPath(const Log* log, quint32 segment) const;
+    QString compactedPath(const Log* log, quint32 segment) const;
+    QString blockPath(const Log* log, quint32 segment) const;
+    // 条目所在的文件：原始段、整理后的段或压缩块
+    QString recordPath(const Log* log, const IndexEntry& entry) const;
+
+    QString m_rootPath;
+    QHash<QString, Log*> m_logs;
+    QCache<QString, QByteArray> m_blockCache;  // 解压后的块，代价按 KB 计
+    mutable QMutex m_mutex;
+    QMutex m_maintenanceMutex;  // 串行化整理与冷数据压缩，二者都会替换段文件；先于 m_mutex 获取
+    QStringList m_pendingRemovals;  // 仍被映射、暂时删不掉的旧文件，每次整理或压缩前重试；由 m_maintenanceMutex 保护
+};
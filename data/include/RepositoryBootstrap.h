@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QObject>
+#include <QFuture>
+#include <QPromise>
+#include <QThreadPool>
+
+// 仓库启动器：在工作线程上按依赖顺序构造各仓库，界面线程只等待就绪通知
+// 字符串池 → 用户、群（互不依赖，并行构造）→ 消息（种子消息要用到用户与群）→ 重放并启动发送日志。
+// 各仓库的 instance() 仍是线程安全的局部静态变量，构造结束时把自己移到界面线程；
+// 就绪前在别处调用 instance() 会阻塞到构造完成，界面代码应等待对应的 future。
+// 头像等 QPixmap 工作不在构造中进行，由界面线程首次取用时生成。
+class RepositoryBootstrap : public QObject {
+    Q_OBJECT
+public:
+    static RepositoryBootstrap& instance();
+
+    // 在界面线程调用一次，立即返回
+    void start();
+
+    QFuture<void> usersReady() const { return m_users.future(); }
+    QFuture<void> groupsReady() const { return m_groups.future(); }
+    // 消息仓库就绪时用户与群也已就绪
+    QFuture<void> messagesReady() const { return m_messages.future(); }
+
+private:
+    explicit RepositoryBootstrap(QObject* parent = nullptr);
+    ~RepositoryBootstrap() override;
+    Q_DISABLE_COPY(RepositoryBootstrap)
+
+    QPromise<void> m_users;
+    QPromise<void> m_groups;
+    QPromise<void> m_messages;
+    QThreadPool m_pool;
+    bool m_started = false;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <atomic>
+#include <functional>
+#include "ChatMessage.h"
+
+// 发送日志：本地发出的消息的预写日志（write-ahead log）
+// append 只入队、立即返回，界面先行显示消息；常驻的写线程成组提交：第一条到达后再等 GROUP_COMMIT_MS，
+// 期间到达的消息一次写入、一次 fsync，随后发 committed，再把这批消息交给 sink 写入消息仓库。
+// 崩溃恢复：recover 先用 replayFilter 按消息 id 到存储中核对（包括已删除的消息），只把尚未入库的条目重放给 sink；
+// 末尾写了一半的条目被截掉。
+// 检查点：日志超过 CHECKPOINT_BYTES 或正常关闭时由 checkpoint 回调把仓库刷到磁盘，成功后清空日志。
+// 条目：magic(4) + 负载长度(4) + 负载校验和(2)，均为小端；负载为 QDataStream 写出的会话 id 与 MessageStore::encode 格式的记录。
+// 记录在 append 时编码一次，写日志与写入仓库用的是同一份字节。
+class SendJournal : public QObject {
+    Q_OBJECT
+public:
+    struct Entry {
+        QString conversationId;
+        QSharedPointer<ChatMessage> message;
+        QByteArray record;      // MessageStore::encode 格式（序号为 0），日志条目与入库共用，只编码一次
+    };
+    // 在写线程调用，条目已落盘
+    using Sink = std::function<void(const QVector<Entry>& entries)>;
+    // 把 sink 写入的数据刷到磁盘，成功返回 true
+    using Checkpoint = std::function<bool()>;
+    // 重放前调用，返回其中尚未写入仓库的条目
+    using ReplayFilter = std::function<QVector<Entry>(const QVector<Entry>& entries)>;
+
+    static constexpr quint32 FRAME_MAGIC = 0x4A534C4E;     // "NLSJ"
+    static constexpr int FRAME_HEADER_SIZE = 10;
+    static constexpr int GROUP_COMMIT_MS = 2;               // 成组提交的等待窗口
+    static constexpr int GROUP_MAX_ENTRIES = 1024;          // 攒够即提交，不再等待
+    static constexpr qint64 CHECKPOINT_BYTES = 1024 * 1024;
+
+    // 应用的发送日志，提交后写入 MessageRepository
+    static SendJournal& instance();
+
+    SendJournal(const QString& path, Sink sink, Checkpoint checkpoint, ReplayFilter replayFilter = ReplayFilter(),
+                QObject* parent = nullptr);
+    ~SendJournal() override;
+
+    // 重放上次遗留、尚未入库的条目并交给 sink，返回重放的条数；须在 start 之前调用
+    int recover();
+    // 启动写线程，此前 append 的条目随即提交
+    bool start();
+    // 任意线程调用，只入队不等待；已关闭时返回 false。
+    // record 为调用方已编码好的记录，为空时在调用线程编码，写线程不再编码
+    bool append(const QString& conversationId, QSharedPointer<ChatMessage> message,
+                QByteArray record = QByteArray());
+    // 提交剩余条目后停止写线程并做一次检查点；未启动时剩余条目只写入日志，下次启动时重放
+    void shutdown();
+
+    quint64 commitCount() const { return m_commits; }
+    quint64 entryCount() const { return m_entries; }
+
+signals:
+    // 这批消息已落盘；在写线程发出，界面经排队连接收到
+    void committed(const QVector<quint64>& messageIds);
+
+private:
+    Q_DISABLE_COPY(SendJournal)
+
+    bool openFile();
+    void runWriter();
+    // 写入并 fsync 一批条目，失败时截回写入前的长度
+    bool writeFrames(const QVector<Entry>& batch);
+    void commit(const QVector<Entry>& batch);
+    void checkpoint();
+    static QByteArray encodeFrame(const Entry& entry);
+
+    QString m_path;
+    Sink m_sink;
+    Checkpoint m_checkpoint;
+    ReplayFilter m_replayFilter;
+    QFile m_file;               // 启动前由 recover 使用，启动后只在写线程访问
+    QVector<Entry> m_pending;
+    QMutex m_mutex;             // 保护 m_pending、m_started、m_stopping
+    QWaitCondition m_wake;
+    bool m_started = false;
+    bool m_stopping = false;
+    std::atomic<quint64> m_commits{0};
+    std::atomic<quint64> m_entries{0};
+    QThreadPool m_pool;         // 单线程，写线程常驻其中
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// 有界无锁单生产者单消费者环形队列
+// 只允许一个线程 tryPush、一个线程 tryPop；head 与 tail 各占一条缓存行，避免生产者与消费者互相抖动。
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(int capacity)
+        : m_slots(size_t(capacity) + 1)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 队列满时返回 false，value 保持不变
+    bool tryPush(T& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t next = increment(tail);
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+        m_slots[tail] = std::move(value);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空时返回 false
+    bool tryPop(T& value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(m_slots[head]);
+        m_slots[head] = T();
+        m_head.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    // 近似值，任意线程可调用
+    int size() const
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return int(tail >= head ? tail - head : tail + m_slots.size() - head);
+    }
+
+    int capacity() const { return int(m_slots.size()) - 1; }
+    bool isEmpty() const { return size() == 0; }
+
+private:
+    size_t increment(size_t index) const
+    {
+        return index + 1 == m_slots.size() ? 0 : index + 1;
+    }
+
+    std::vector<T> m_slots;   // 多留一个空位区分满与空
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
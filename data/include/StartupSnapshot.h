@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QImage>
+#include "User.h"
+
+// 启动快照：首屏需要的会话列表、好友列表及预先裁好的 48px 头像
+// 启动时先用它画出第一帧，仓库就绪后再由各列表与真实数据对账；退出时按当时的界面重新保存。
+// 头像按 ARGB32_Premultiplied 原始像素存放，载入时不需要解码。
+class StartupSnapshot {
+public:
+    // 会话列表中的一行，顺序即显示顺序
+    struct ConversationRow {
+        QString id;
+        QString name;
+        QString preview;
+        qint64 lastTimestamp = 0;   // 毫秒时间戳，没有消息时为 0
+        int unreadCount = 0;
+        bool doNotDisturb = false;
+        bool isGroup = false;
+        QString avatarPath;         // 头像来源，对账时据此判断是否需要重新生成
+        QImage avatar;
+    };
+
+    // 好友列表中的一行，顺序即排序后的显示顺序
+    struct FriendRow {
+        User user;
+        QImage avatar;
+    };
+
+    static constexpr quint32 FILE_MAGIC = 0x53534C4E;  // "NLSS"
+    static constexpr quint16 FILE_VERSION = 1;
+    static constexpr int AVATAR_SIZE = 48;
+
+    QVector<ConversationRow> conversations;
+    QVector<FriendRow> friends;
+
+    bool isEmpty() const { return conversations.isEmpty() && friends.isEmpty(); }
+
+    bool load(const QString& path);
+    bool save(const QString& path) const;
+
+    static QString defaultPath();
+    // 本次启动时磁盘上的快照，首次调用时载入，没有、已损坏或设置了 NETHERLINK_NO_SNAPSHOT 时为空（只在界面线程使用）
+    static const StartupSnapshot& atLaunch();
+};
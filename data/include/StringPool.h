@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QReadWriteLock>
+#include "StringHandle.h"
+
+// 全局字符串驻留表
+// 用户/群 id、昵称等大量重复的字符串只保存一份，其余地方持有 32 位句柄，
+// 以句柄为键的查找只需整数哈希。驻留的字符串在程序生命周期内不回收。
+// 线程安全：查询取读锁，新增取写锁。
+class StringPool {
+public:
+    static StringPool& instance();
+
+    // 驻留字符串并返回句柄，已存在时返回原句柄
+    StringHandle intern(const QString& text);
+
+    // 查询已驻留字符串的句柄，不存在时返回 0 且不插入
+    StringHandle find(const QString& text) const;
+
+    // 句柄对应的字符串，与池中共享同一份数据；无效句柄返回空串
+    QString string(StringHandle handle) const;
+
+    // 返回与池中共享数据的副本，用于替换外部持有的重复字符串
+    QString shared(const QString& text);
+
+    int size() const;
+
+private:
+    StringPool();
+    Q_DISABLE_COPY(StringPool)
+
+    QVector<QString> m_strings;           // 下标即句柄
+    QHash<QString, StringHandle> m_index;
+    mutable QReadWriteLock m_lock;
+};
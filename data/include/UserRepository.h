@@ -1,28 +1,33 @@
 #pragma once
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
 #include <QVector>
 #include <QMutex>
 #include <QPixmapCache>
 #include "User.h"
+#include "StringPool.h"
 
 class UserRepository : public QObject {
     Q_OBJECT
 public:
     static UserRepository& instance();
     User getUser(const QString& userID);
+    User getUser(StringHandle userID);
     QVector<User> getAllUser();
     void insertUser(const User& user);
     void removeUser(const QString& userID);
-    QString getName(QString userID);
+    QString getName(const QString& userID);
+    QString getName(StringHandle userID);
+    // 圆形头像，首次取用时生成并放入 QPixmapCache；只能在界面线程调用
     QPixmap getAvatar(const QString& userID);
+    QPixmap getAvatar(StringHandle userID);
 
 private:
     explicit UserRepository(QObject* parent = nullptr);
     Q_DISABLE_COPY(UserRepository)
-    void cacheAvatar(const QString& userID);
-    QMap<QString, User> userMap;
+    QPixmap renderAvatar(const QString& avatarPath) const;
+    QHash<StringHandle, User> userMap;  // 键为驻留后的用户 id
     QMutex mutex; // 用于线程安全
     const int avatarSize = 48;
 };
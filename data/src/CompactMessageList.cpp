@@ -0,0 +1,297 @@
+#include "CompactMessageList.h"
+#include "MessageStore.h"
+#include <QImage>
+#include <QSharedPointer>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+qint64 MessageView::getSeq() const
+{
+    return m_list->m_seq[m_row];
+}
+
+quint64 MessageView::getMessageId() const
+{
+    return m_list->m_messageId[m_row];
+}
+
+qint64 MessageView::timestampMs() const
+{
+    return m_list->m_timestamp[m_row];
+}
+
+QDateTime MessageView::getTimestamp() const
+{
+    return QDateTime::fromMSecsSinceEpoch(m_list->m_timestamp[m_row]);
+}
+
+MessageType MessageView::getType() const
+{
+    return static_cast<MessageType>(m_list->m_type[m_row]);
+}
+
+bool MessageView::isFromMe() const
+{
+    return m_list->m_flags[m_row] & CompactMessageList::FromMe;
+}
+
+bool MessageView::isInGroupChat() const
+{
+    return m_list->m_flags[m_row] & CompactMessageList::GroupChat;
+}
+
+bool MessageView::getIsSelected() const
+{
+    return m_list->m_flags[m_row] & CompactMessageList::Selected;
+}
+
+DeliveryState MessageView::getDeliveryState() const
+{
+    const quint8 flags = m_list->m_flags[m_row];
+    if (flags & CompactMessageList::Pending)
+        return DeliveryState::Pending;
+    if (flags & CompactMessageList::Durable)
+        return DeliveryState::Durable;
+    return DeliveryState::Acked;
+}
+
+GroupRole MessageView::getRole() const
+{
+    return static_cast<GroupRole>(m_list->m_role[m_row]);
+}
+
+StringHandle MessageView::senderHandle() const
+{
+    m_list->resolveSender(m_row);
+    return m_list->m_senderId[m_row];
+}
+
+QString MessageView::getSenderId() const
+{
+    m_list->resolveSender(m_row);
+    return StringPool::instance().string(m_list->m_senderId[m_row]);
+}
+
+QString MessageView::getSenderName() const
+{
+    m_list->resolveSender(m_row);
+    return StringPool::instance().string(m_list->m_senderName[m_row]);
+}
+
+QStringView MessageView::textView() const
+{
+    return m_list->text(m_row);
+}
+
+QString MessageView::getText() const
+{
+    return textView().toString();
+}
+
+QString MessageView::getContent() const
+{
+    switch (getType()) {
+        case MessageType::Text:
+            return getText();
+        case MessageType::Image:
+            return "[图片]";
+        default:
+            return QString();
+    }
+}
+
+QPixmap MessageView::getImage() const
+{
+    return m_list->image(m_row);
+}
+
+int CompactMessageList::append(const ChatMessage& message)
+{
+    const int row = size();
+    auto& pool = StringPool::instance();
+    quint8 flags = 0;
+    if (message.isFromMe())
+        flags |= FromMe;
+    if (message.isInGroupChat())
+        flags |= GroupChat;
+    if (message.getDeliveryState() == DeliveryState::Pending)
+        flags |= Pending;
+    else if (message.getDeliveryState() == DeliveryState::Durable)
+        flags |= Durable;
+
+    m_seq.push_back(message.getSeq());
+    m_messageId.push_back(message.getMessageId());
+    m_timestamp.push_back(message.getTimestamp().toMSecsSinceEpoch());
+    m_senderId.push_back(pool.intern(message.getSenderId()));
+    m_senderName.push_back(pool.intern(message.getSenderName()));
+    m_type.push_back(quint8(message.getType()));
+    m_role.push_back(quint8(message.getRole()));
+    m_flags.push_back(flags);
+
+    m_source.push_back(0);
+    m_recordOffset.push_back(0);
+    m_textOffset.push_back(quint32(m_text.size()));
+    if (message.getType() == MessageType::Text) {
+        const QString text = static_cast<const TextMessage&>(message).getText();
+        m_text += text;
+        m_textLength.push_back(quint32(text.size()));
+    } else {
+        m_textLength.push_back(0);
+        if (message.getType() == MessageType::Image)
+            m_images.insert(row, QPixmap::fromImage(static_cast<const ImageMessage&>(message).getImage()));
+    }
+    return row;
+}
+
+int CompactMessageList::appendRecord(const MappedSegmentPtr& segment, quint32 offset, quint32 length)
+{
+    MessageStore::RecordHeader header;
+    if (!segment || !segment->contains(offset, length) || length < sizeof(header))
+        return -1;
+    const char* record = segment->data() + offset;
+    std::memcpy(&header, record, sizeof(header));
+    const qint64 payload = MessageStore::payloadOffset(header, length);
+    if (payload < 0)
+        return -1;
+
+    // 同一批记录通常来自同一个段
+    auto it = std::find(m_segments.cbegin(), m_segments.cend(), segment);
+    if (it == m_segments.cend()) {
+        m_segments.push_back(segment);
+        it = m_segments.cend() - 1;
+    }
+
+    quint64 messageId = 0;
+    if (header.version >= 2)
+        std::memcpy(&messageId, record + sizeof(header), sizeof(messageId));
+
+    const int row = size();
+    m_seq.push_back(header.seq);
+    m_messageId.push_back(messageId);
+    m_timestamp.push_back(header.timestamp);
+    m_senderId.push_back(0);
+    m_senderName.push_back(0);
+    m_type.push_back(header.type);
+    m_role.push_back(header.role);
+    m_flags.push_back(header.flags & (FromMe | GroupChat));
+    m_source.push_back(quint16(it - m_segments.cbegin() + 1));
+    m_recordOffset.push_back(offset);
+    // 记录按 8 字节对齐、负载前的字段都是 QChar 的整数倍，文本在映射中按 QChar 对齐
+    m_textOffset.push_back(quint32((offset + payload) / qint64(sizeof(QChar))));
+    m_textLength.push_back(header.type == quint8(MessageType::Text) ? header.payloadLength / quint32(sizeof(QChar)) : 0);
+    return row;
+}
+
+const char* CompactMessageList::recordOf(int row) const
+{
+    const quint16 source = m_source[row];
+    return source == 0 ? nullptr : m_segments[source - 1]->data() + m_recordOffset[row];
+}
+
+void CompactMessageList::resolveSender(int row) const
+{
+    const char* record = recordOf(row);
+    if (!record || m_senderId[row] != 0)
+        return;
+    MessageStore::RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    const auto* cursor = reinterpret_cast<const QChar*>(record + MessageStore::headerSize(header));
+    auto& pool = StringPool::instance();
+    m_senderId[row] = pool.intern(QString(cursor, header.senderIdLength));
+    m_senderName[row] = pool.intern(QString(cursor + header.senderIdLength, header.senderNameLength));
+}
+
+QStringView CompactMessageList::text(int row) const
+{
+    const quint16 source = m_source[row];
+    if (source == 0)
+        return QStringView(m_text).mid(m_textOffset[row], m_textLength[row]);
+    const auto* base = reinterpret_cast<const QChar*>(m_segments[source - 1]->data());
+    return QStringView(base + m_textOffset[row], m_textLength[row]);
+}
+
+QPixmap CompactMessageList::image(int row) const
+{
+    auto it = m_images.constFind(row);
+    if (it != m_images.constEnd())
+        return it.value();
+    const char* record = recordOf(row);
+    if (!record || m_type[row] != quint8(MessageType::Image))
+        return QPixmap();
+    // 映射行的图片在第一次绘制时解码，之后缓存
+    MessageStore::RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+    const char* payload = m_segments[m_source[row] - 1]->data() + qint64(m_textOffset[row]) * qint64(sizeof(QChar));
+    const QPixmap pixmap = QPixmap::fromImage(QImage::fromData(QByteArray::fromRawData(payload, header.payloadLength)));
+    m_images.insert(row, pixmap);
+    return pixmap;
+}
+
+void CompactMessageList::setSelected(int row, bool selected)
+{
+    if (row < 0 || row >= size())
+        return;
+    if (selected)
+        m_flags[row] |= Selected;
+    else
+        m_flags[row] &= ~Selected;
+}
+
+void CompactMessageList::setDeliveryState(int row, DeliveryState state)
+{
+    if (row < 0 || row >= size())
+        return;
+    m_flags[row] &= ~(Pending | Durable);
+    if (state == DeliveryState::Pending)
+        m_flags[row] |= Pending;
+    else if (state == DeliveryState::Durable)
+        m_flags[row] |= Durable;
+}
+
+void CompactMessageList::setSeq(int row, qint64 seq)
+{
+    if (row >= 0 && row < size())
+        m_seq[row] = seq;
+}
+
+void CompactMessageList::clear()
+{
+    m_seq.clear();
+    m_messageId.clear();
+    m_timestamp.clear();
+    m_senderId.clear();
+    m_senderName.clear();
+    m_textOffset.clear();
+    m_textLength.clear();
+    m_type.clear();
+    m_role.clear();
+    m_flags.clear();
+    m_source.clear();
+    m_recordOffset.clear();
+    m_segments.clear();
+    m_text.clear();
+    m_images.clear();
+}
+
+qint64 CompactMessageList::memoryUsage() const
+{
+    // 只统计列数据和文本区；驻留字符串归 StringPool，图片像素由 QPixmap 自己管理，映射的页面由系统按需换入
+    return m_seq.capacity() * qint64(sizeof(qint64))
+         + m_messageId.capacity() * qint64(sizeof(quint64))
+         + m_timestamp.capacity() * qint64(sizeof(qint64))
+         + (m_senderId.capacity() + m_senderName.capacity()) * qint64(sizeof(StringHandle))
+         + (m_textOffset.capacity() + m_textLength.capacity() + m_recordOffset.capacity()) * qint64(sizeof(quint32))
+         + m_type.capacity() + m_role.capacity() + m_flags.capacity()
+         + m_source.capacity() * qint64(sizeof(quint16))
+         + m_text.capacity() * qint64(sizeof(QChar));
+}
+
+qint64 CompactMessageList::imageMemoryUsage() const
+{
+    qint64 bytes = 0;
+    for (const QPixmap& image : std::as_const(m_images)) {
+        bytes += qint64(image.width()) * image.height() * image.depth() / 8;
+    }
+    return bytes;
+}
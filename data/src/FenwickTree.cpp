@@ -0,0 +1,78 @@
+#include "FenwickTree.h"
+
+namespace {
+    inline int lowBit(int i)
+    {
+        return i & -i;
+    }
+}
+
+void FenwickTree::build(const QVector<qint64>& values)
+{
+    m_tree = values;
+    const int n = size();
+    // 每个节点把自己的和推给父节点
+    for (int i = 1; i <= n; ++i) {
+        const int parent = i + lowBit(i);
+        if (parent <= n)
+            m_tree[parent - 1] += m_tree[i - 1];
+    }
+}
+
+void FenwickTree::clear()
+{
+    m_tree.clear();
+}
+
+void FenwickTree::append(qint64 value)
+{
+    // 新节点 i 覆盖 (i - lowbit(i), i]，其中除自身外的部分由已有节点求出
+    const int i = size() + 1;
+    m_tree.push_back(value + prefixSum(i - 1) - prefixSum(i - lowBit(i)));
+}
+
+void FenwickTree::truncate(int count)
+{
+    if (count < size())
+        m_tree.resize(qMax(0, count));
+}
+
+void FenwickTree::add(int index, qint64 delta)
+{
+    for (int i = index + 1; i <= size(); i += lowBit(i)) {
+        m_tree[i - 1] += delta;
+    }
+}
+
+qint64 FenwickTree::prefixSum(int count) const
+{
+    qint64 sum = 0;
+    for (int i = qMin(count, size()); i > 0; i -= lowBit(i)) {
+        sum += m_tree[i - 1];
+    }
+    return sum;
+}
+
+qint64 FenwickTree::valueAt(int index) const
+{
+    return prefixSum(index + 1) - prefixSum(index);
+}
+
+int FenwickTree::find(qint64 target) const
+{
+    if (target < 0)
+        return 0;
+    int pos = 0;
+    int step = 1;
+    while (step * 2 <= size())
+        step *= 2;
+    // 自顶向下二分，pos 始终满足 prefixSum(pos) <= target
+    for (; step > 0; step /= 2) {
+        const int next = pos + step;
+        if (next <= size() && m_tree[next - 1] <= target) {
+            pos = next;
+            target -= m_tree[next - 1];
+        }
+    }
+    return pos;
+}
@@ -2,6 +2,8 @@
 #include <QPixmapCache>
 #include <QPainterPath>
 #include <QPainter>
+#include <QCoreApplication>
+#include <algorithm>
 
 GroupRepository::GroupRepository(QObject* parent)
         : QObject(parent)
@@ -18,24 +20,16 @@ GroupRepository::GroupRepository(QObject* parent)
         {"g009", "A346宿舍", 4, "u007", ":/resources/avatar/10.jpg"},
     };
 
-    for (const Group& group : groups) {
-        groupMap.insert(group.groupId, group);
+    auto& pool = StringPool::instance();
+    for (Group group : groups) {
+        const StringHandle handle = pool.intern(group.groupId);
+        group.groupId = pool.string(handle);
+        group.ownerId = pool.shared(group.ownerId);
+        groupMap.insert(handle, group);
     }
-    const QString key = QString("group_avatar");
-    const int avatarSize = 48;
-    QPixmap original(groups[0].groupAvatarPath);
-    if (original.isNull()) return;
-    QPixmap rounded(avatarSize, avatarSize);
-    rounded.fill(Qt::transparent);
-    QPainter painter(&rounded);
-    painter.setRenderHint(QPainter::Antialiasing);
-    QPainterPath path;
-    path.addEllipse(0, 0, avatarSize, avatarSize);
-    painter.setClipPath(path);
-    painter.drawPixmap(0, 0, original.scaled(avatarSize, avatarSize,
-                                             Qt::KeepAspectRatioByExpanding,
-                                             Qt::SmoothTransformation));
-    QPixmapCache::insert(key, rounded);
+    // 可能在启动线程上构造，归属界面线程
+    if (QCoreApplication::instance())
+        moveToThread(QCoreApplication::instance()->thread());
 }
 
 GroupRepository& GroupRepository::instance() {
@@ -44,26 +38,78 @@ GroupRepository& GroupRepository::instance() {
 }
 
 Group GroupRepository::getGroup(const QString& groupID) {
+    return getGroup(StringPool::instance().find(groupID));
+}
+
+Group GroupRepository::getGroup(StringHandle groupID) {
     QMutexLocker locker(&mutex);
     return groupMap.value(groupID, Group());
 }
 
 QVector<Group> GroupRepository::getAllGroup() {
     QMutexLocker locker(&mutex);
-    return QVector<Group>::fromList(groupMap.values());
+    QVector<Group> groups = QVector<Group>::fromList(groupMap.values());
+    // 哈希表无序，按 id 排序保持原先的顺序
+    std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) { return a.groupId < b.groupId; });
+    return groups;
 }
 
 void GroupRepository::insertGroup(const Group& group) {
+    auto& pool = StringPool::instance();
+    const StringHandle handle = pool.intern(group.groupId);
+    Group stored = group;
+    stored.groupId = pool.string(handle);
+    stored.ownerId = pool.shared(group.ownerId);
     QMutexLocker locker(&mutex);
-    groupMap[group.groupId] = group;
+    groupMap[handle] = stored;
 }
 
 void GroupRepository::removeGroup(const QString& groupID) {
+    const StringHandle handle = StringPool::instance().find(groupID);
     QMutexLocker locker(&mutex);
-    groupMap.remove(groupID);
+    groupMap.remove(handle);
+}
+
+bool GroupRepository::isGroup(const QString& id) {
+    return isGroup(StringPool::instance().find(id));
 }
 
-bool GroupRepository::isGroup(QString &id) {
+bool GroupRepository::isGroup(StringHandle id) {
     QMutexLocker locker(&mutex);
-    return groupMap.count(id) != 0;
+    return groupMap.contains(id);
+}
+
+QPixmap GroupRepository::getAvatar(const QString& groupID) {
+    return getAvatar(StringPool::instance().find(groupID));
+}
+
+QPixmap GroupRepository::getAvatar(StringHandle groupID) {
+    QString avatarPath;
+    {
+        QMutexLocker locker(&mutex);
+        auto it = groupMap.constFind(groupID);
+        if (it == groupMap.constEnd())
+            return QPixmap();
+        avatarPath = it->groupAvatarPath;
+    }
+    // 群头像按图片共享缓存，多个群用同一张图时只生成一次
+    const QString key = QString("group_avatar_%1").arg(avatarPath);
+    QPixmap pixmap;
+    if (QPixmapCache::find(key, &pixmap))
+        return pixmap;
+    QPixmap original(avatarPath);
+    if (original.isNull()) return QPixmap();
+    QPixmap rounded(avatarSize, avatarSize);
+    rounded.fill(Qt::transparent);
+    QPainter painter(&rounded);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QPainterPath path;
+    path.addEllipse(0, 0, avatarSize, avatarSize);
+    painter.setClipPath(path);
+    painter.drawPixmap(0, 0, original.scaled(avatarSize, avatarSize,
+                                             Qt::KeepAspectRatioByExpanding,
+                                             Qt::SmoothTransformation));
+    painter.end();
+    QPixmapCache::insert(key, rounded);
+    return rounded;
 }
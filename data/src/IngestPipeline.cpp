@@ -0,0 +1,302 @@
+#include "IngestPipeline.h"
+#include "MessageRepository.h"
+#include "MessageStore.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <utility>
+
+namespace {
+    const char* const STAGE_NAMES[] = { "decode", "dedupe", "persist", "index", "notify" };
+
+    // 原子地把 target 提升到 value
+    template <typename T>
+    void raise(std::atomic<T>& target, T value)
+    {
+        T current = target.load(std::memory_order_relaxed);
+        while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    template <typename T>
+    int messageCount(const QHash<QString, QVector<T>>& batches)
+    {
+        int count = 0;
+        for (const auto& messages : batches) {
+            count += messages.size();
+        }
+        return count;
+    }
+}
+
+IngestPipeline::IngestPipeline(QObject* parent)
+        : QObject(parent)
+{
+    // 先建好仓库，保证它晚于流水线析构
+    MessageRepository::instance();
+    // 可能首次在网络线程被访问，通知须回到界面线程处理
+    if (QCoreApplication::instance())
+        moveToThread(QCoreApplication::instance()->thread());
+
+    m_clock.start();
+    for (QSemaphore& free : m_free) {
+        free.release(QUEUE_CAPACITY);
+    }
+    m_pool.setMaxThreadCount(StageCount);
+    m_pool.setExpiryTimeout(-1);
+    m_pool.start([this] { runDecode(); });
+    m_pool.start([this] { runDedupe(); });
+    m_pool.start([this] { runPersist(); });
+    m_pool.start([this] { runIndex(); });
+    m_pool.start([this] { runNotify(); });
+
+    if (QCoreApplication::instance())
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &IngestPipeline::shutdown);
+}
+
+IngestPipeline::~IngestPipeline()
+{
+    shutdown();
+}
+
+IngestPipeline& IngestPipeline::instance()
+{
+    static IngestPipeline pipeline;
+    return pipeline;
+}
+
+bool IngestPipeline::submit(IngestBatch batch)
+{
+    if (batch.isEmpty())
+        return true;
+    QMutexLocker locker(&m_submitMutex);
+    if (m_stopping)
+        return false;
+    m_submittedCount += batch.size();
+    push(Decode, m_submitted, batch);
+    return true;
+}
+
+bool IngestPipeline::submit(const QString& conversationId, QSharedPointer<ChatMessage> message)
+{
+    return submit(IngestBatch{ { conversationId, QByteArray(), std::move(message) } });
+}
+
+void IngestPipeline::shutdown()
+{
+    {
+        QMutexLocker locker(&m_submitMutex);
+        if (m_stopping.exchange(true))
+            return;
+    }
+    // 唤醒所有阶段，各自处理完输入后依次退出
+    for (QSemaphore& ready : m_ready) {
+        ready.release();
+    }
+    m_pool.waitForDone();
+}
+
+IngestPipeline::Metrics IngestPipeline::metrics() const
+{
+    Metrics result;
+    const int depths[StageCount] = {
+        m_submitted.size(), m_decoded.size(), m_unique.size(), m_persisted.size(), m_indexed.size()
+    };
+    for (int stage = 0; stage < StageCount; ++stage) {
+        StageMetrics metrics;
+        metrics.name = STAGE_NAMES[stage];
+        metrics.depth = depths[stage];
+        metrics.capacity = QUEUE_CAPACITY;
+        metrics.highWater = m_stages[stage].highWater;
+        metrics.processed = m_stages[stage].processed;
+        metrics.stalls = m_stages[stage].stalls;
+        result.stages.push_back(metrics);
+    }
+    result.submitted = m_submittedCount;
+    result.duplicates = m_duplicates;
+    result.malformed = m_malformed;
+    result.uiPending = m_uiPending;
+    result.lastUiLatencyMs = m_lastUiLatency;
+    result.maxUiLatencyMs = m_maxUiLatency;
+    return result;
+}
+
+template <typename T>
+void IngestPipeline::push(Stage stage, SpscQueue<T>& queue, T& value)
+{
+    StageState& state = m_stages[stage];
+    if (!m_free[stage].tryAcquire()) {
+        // 下游处理不过来：记一次阻塞，等它取走一个批次
+        state.stalls++;
+        m_free[stage].acquire();
+    }
+    // 占到了空位，推入不会失败
+    const bool pushed = queue.tryPush(value);
+    Q_ASSERT(pushed);
+    Q_UNUSED(pushed);
+    raise(state.highWater, queue.size());
+    m_ready[stage].release();
+}
+
+template <typename T>
+bool IngestPipeline::pop(Stage stage, SpscQueue<T>& queue, T& value)
+{
+    while (true) {
+        m_ready[stage].acquire();
+        if (take(stage, queue, value))
+            return true;
+        const bool upstreamDone = stage == Decode ? bool(m_stopping) : bool(m_stages[stage - 1].done);
+        // 上游结束后再检查一次，防止结束前最后推入的批次被漏掉
+        if (upstreamDone)
+            return take(stage, queue, value);
+    }
+}
+
+template <typename T>
+bool IngestPipeline::take(Stage stage, SpscQueue<T>& queue, T& value)
+{
+    if (!queue.tryPop(value))
+        return false;
+    m_free[stage].release();
+    return true;
+}
+
+void IngestPipeline::finish(Stage stage)
+{
+    m_stages[stage].done = true;
+    if (stage + 1 < StageCount)
+        m_ready[stage + 1].release();
+}
+
+void IngestPipeline::runDecode()
+{
+    IngestBatch batch;
+    while (pop(Decode, m_submitted, batch)) {
+        IngestBatch decoded;
+        decoded.reserve(batch.size());
+        for (IngestItem& item : batch) {
+            if (!item.message) {
+                // 图片只解码为 QImage，可以在工作线程进行；QPixmap 由界面线程显示时再转换。
+                // 原始记录随消息一起往下传，持久化时直接写入，不再重新编码
+                item.message = MessageStore::decode(item.record.constData(), item.record.size());
+                if (!item.message) {
+                    m_malformed++;
+                    continue;
+                }
+            }
+            decoded.push_back(std::move(item));
+        }
+        m_stages[Decode].processed += batch.size();
+        if (!decoded.isEmpty())
+            push(Dedupe, m_decoded, decoded);
+    }
+    finish(Decode);
+}
+
+void IngestPipeline::runDedupe()
+{
+    IngestBatch batch;
+    while (pop(Dedupe, m_decoded, batch)) {
+        EncodedBatches unique;
+        for (const IngestItem& item : std::as_const(batch)) {
+            // 同一批次流经时先挡掉最近重发的消息，仓库写入时还会按消息 id 做最终的幂等判断
+            if (isDuplicate(item.conversationId, *item.message)) {
+                m_duplicates++;
+                continue;
+            }
+            unique[item.conversationId].push_back({ item.message, item.record });
+        }
+        m_stages[Dedupe].processed += batch.size();
+        if (!unique.isEmpty())
+            push(Persist, m_unique, unique);
+    }
+    finish(Dedupe);
+}
+
+void IngestPipeline::runPersist()
+{
+    auto& repo = MessageRepository::instance();
+    EncodedBatches batches;
+    while (pop(Persist, m_unique, batches)) {
+        // 积压时把多个批次合成一次写入，只发布一次快照
+        EncodedBatches next;
+        for (int merged = 1; merged < PERSIST_MERGE_LIMIT && take(Persist, m_unique, next); ++merged) {
+            for (auto it = next.begin(); it != next.end(); ++it) {
+                batches[it.key()] += it.value();
+            }
+        }
+        MessageBatches stored = repo.persist(batches);
+        m_stages[Persist].processed += messageCount(batches);
+        if (!stored.isEmpty())
+            push(Index, m_persisted, stored);
+        batches.clear();
+    }
+    finish(Persist);
+}
+
+void IngestPipeline::runIndex()
+{
+    auto& repo = MessageRepository::instance();
+    MessageBatches batches;
+    while (pop(Index, m_persisted, batches)) {
+        repo.indexMessages(batches);
+        m_stages[Index].processed += messageCount(batches);
+        QSet<QString> changed(batches.keyBegin(), batches.keyEnd());
+        push(Notify, m_indexed, changed);
+    }
+    finish(Index);
+}
+
+void IngestPipeline::runNotify()
+{
+    QSet<QString> pending;
+    QSet<QString> changed;
+    while (true) {
+        // 有新的变更、界面处理完上一次通知、或上游结束时醒来
+        m_ready[Notify].acquire();
+        const bool upstreamDone = m_stages[Index].done;
+        while (take(Notify, m_indexed, changed)) {
+            m_stages[Notify].processed += changed.size();
+            pending.unite(changed);
+        }
+        // 上一次通知处理完之前不再投递，变更留在 pending 中继续合并
+        if (!pending.isEmpty() && !m_uiPending)
+            postNotification(std::exchange(pending, {}));
+        if (upstreamDone && m_indexed.isEmpty())
+            break;
+    }
+    if (!pending.isEmpty())
+        postNotification(std::move(pending));
+    finish(Notify);
+}
+
+void IngestPipeline::postNotification(QSet<QString> conversationIds)
+{
+    m_uiPending = true;
+    const qint64 postedAt = m_clock.elapsed();
+    QMetaObject::invokeMethod(this, [this, conversationIds = std::move(conversationIds), postedAt] {
+        MessageRepository::instance().notifyChanged(conversationIds);
+        const qint64 latency = m_clock.elapsed() - postedAt;
+        m_lastUiLatency = latency;
+        raise(m_maxUiLatency, latency);
+        m_uiPending = false;
+        // 期间合并的变更可以投递了
+        m_ready[Notify].release();
+        if (latency > UI_LAG_WARN_MS)
+            emit uiLagging(latency);
+    }, Qt::QueuedConnection);
+}
+
+bool IngestPipeline::isDuplicate(const QString& conversationId, const ChatMessage& message)
+{
+    // 没有 id 的消息（本地新建、尚未分配）不可能是重发
+    if (message.getMessageId() == 0)
+        return false;
+    const size_t key = qHashMulti(0, conversationId, message.getMessageId());
+    if (m_recent.contains(key))
+        return true;
+    m_recent.insert(key);
+    m_recentOrder.enqueue(key);
+    if (m_recentOrder.size() > DEDUPE_WINDOW)
+        m_recent.remove(m_recentOrder.dequeue());
+    return false;
+}
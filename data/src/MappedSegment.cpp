@@ -0,0 +1,26 @@
+#include "MappedSegment.h"
+#include <QDebug>
+
+MappedSegment::MappedSegment(const QString& path)
+    : m_file(path)
+{
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() == 0)
+        return;
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qWarning() << "MappedSegment: failed to map" << path << m_file.errorString();
+        m_size = 0;
+    }
+}
+
+MappedSegment::~MappedSegment()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+}
+
+bool MappedSegment::contains(qint64 offset, qint64 length) const
+{
+    return offset >= 0 && length >= 0 && offset + length <= m_size;
+}
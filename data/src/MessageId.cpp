@@ -0,0 +1,40 @@
+#include "MessageId.h"
+#include <QDateTime>
+#include <QRandomGenerator>
+#include <atomic>
+
+namespace MessageId {
+
+namespace {
+    constexpr quint64 SEQUENCE_MASK = (quint64(1) << SEQUENCE_BITS) - 1;
+
+    // 上一次分配的 (毫秒 << SEQUENCE_BITS | 序号)，节点号在拼接时加入
+    std::atomic<quint64> lastStamp{0};
+}
+
+quint32 node()
+{
+    static const quint32 value = QRandomGenerator::global()->bounded(1u << NODE_BITS);
+    return value;
+}
+
+quint64 next()
+{
+    const quint64 now = quint64(qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - EPOCH_MS)) << SEQUENCE_BITS;
+    quint64 last = lastStamp.load(std::memory_order_relaxed);
+    quint64 stamp;
+    do {
+        // 同一毫秒或时钟回拨时在上次基础上加一，序号溢出自然进位到下一毫秒
+        stamp = now > last ? now : last + 1;
+    } while (!lastStamp.compare_exchange_weak(last, stamp, std::memory_order_relaxed));
+
+    const quint64 millis = stamp >> SEQUENCE_BITS;
+    return (millis << (NODE_BITS + SEQUENCE_BITS)) | (quint64(node()) << SEQUENCE_BITS) | (stamp & SEQUENCE_MASK);
+}
+
+qint64 timestampOf(quint64 id)
+{
+    return qint64(id >> (NODE_BITS + SEQUENCE_BITS)) + EPOCH_MS;
+}
+
+}
@@ -0,0 +1,82 @@
+#include "MessageIdFilter.h"
+
+namespace {
+    // splitmix64，把相邻的 id 打散
+    quint64 mix(quint64 x)
+    {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+}
+
+MessageIdFilter::MessageIdFilter()
+    : m_bits(INITIAL_BITS / 64, 0)
+    , m_mask(INITIAL_BITS - 1)
+{
+}
+
+bool MessageIdFilter::contains(quint64 id) const
+{
+    return mayContain(id) && m_recent.contains(id);
+}
+
+void MessageIdFilter::insert(quint64 id)
+{
+    if (m_recent.contains(id))
+        return;
+    m_recent.insert(id);
+    m_order.enqueue(id);
+    if (m_order.size() > RECENT_CAPACITY)
+        m_recent.remove(m_order.dequeue());
+
+    setBits(id);
+    if (++m_bloomCount > int(m_mask + 1) / BITS_PER_ID)
+        rebuild();
+}
+
+qint64 MessageIdFilter::memoryUsage() const
+{
+    // QSet 每个节点约为键加两个指针
+    return m_bits.size() * qint64(sizeof(quint64))
+         + m_recent.size() * qint64(sizeof(quint64) * 3)
+         + m_order.size() * qint64(sizeof(quint64));
+}
+
+bool MessageIdFilter::mayContain(quint64 id) const
+{
+    // 双重哈希：第 i 个位置为 h1 + i * h2
+    const quint64 h = mix(id);
+    const quint32 h1 = quint32(h);
+    const quint32 h2 = quint32(h >> 32) | 1;
+    for (int i = 0; i < HASH_COUNT; ++i) {
+        const quint32 bit = (h1 + quint32(i) * h2) & m_mask;
+        if (!(m_bits[bit >> 6] & (quint64(1) << (bit & 63))))
+            return false;
+    }
+    return true;
+}
+
+void MessageIdFilter::setBits(quint64 id)
+{
+    const quint64 h = mix(id);
+    const quint32 h1 = quint32(h);
+    const quint32 h2 = quint32(h >> 32) | 1;
+    for (int i = 0; i < HASH_COUNT; ++i) {
+        const quint32 bit = (h1 + quint32(i) * h2) & m_mask;
+        m_bits[bit >> 6] |= quint64(1) << (bit & 63);
+    }
+}
+
+void MessageIdFilter::rebuild()
+{
+    const quint32 bits = qMin<quint32>((m_mask + 1) * 2, MAX_BITS);
+    m_mask = bits - 1;
+    m_bits.fill(0, bits / 64);
+    m_bloomCount = 0;
+    for (quint64 id : std::as_const(m_order)) {
+        setBits(id);
+        ++m_bloomCount;
+    }
+}
@@ -1,10 +1,104 @@
 #include "MessageRepository.h"
 #include "UserRepository.h"
 #include "GroupRepository.h"
+#include "MessageId.h"
+#include "DataLocation.h"
 #include <QRandomGenerator>
+#include <QTimer>
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
 
-MessageRepository::MessageRepository(QObject* parent)
+static QString storagePath()
+{
+    return dataLocation() + "/messages";
+}
+
+
+// 参与全文索引的文本，非文本消息为空
+static QString indexedText(const ChatMessage& message)
+{
+    return message.getType() == MessageType::Text ? message.getContent() : QString();
+}
+
+MessageRepository::MessageRepository(const QString& rootPath, QObject* parent)
         : QObject(parent)
+        , m_rootPath(rootPath)
+        , m_storage(rootPath)
+        , m_pages(PAGE_CACHE_SIZE)
+        , m_snapshots(std::make_shared<const SnapshotMap>())
+        , m_indexSaveTimer(this)
+        , m_tieringTimer(this)
+{
+    m_ioPool.setMaxThreadCount(1);
+    m_indexSaveTimer.setSingleShot(true);
+    m_indexSaveTimer.setInterval(INDEX_SAVE_DELAY_MS);
+    connect(&m_indexSaveTimer, &QTimer::timeout, this, [this] {
+        m_ioPool.start([this] { saveSearchIndex(); });
+    });
+    // 冷数据整理在后台进行，首次稍晚于启动，避开首屏加载
+    m_tieringTimer.setInterval(TIERING_INTERVAL_MS);
+    connect(&m_tieringTimer, &QTimer::timeout, this, [this] {
+        m_ioPool.start([this] { applyTiering(); });
+    });
+    // 构造可能在启动线程上进行，定时器要等仓库移到界面线程后再启动
+    QMetaObject::invokeMethod(this, [this] {
+        QTimer::singleShot(TIERING_START_DELAY_MS, this, [this] {
+            m_ioPool.start([this] { applyTiering(); });
+            m_tieringTimer.start();
+        });
+    }, Qt::QueuedConnection);
+
+    m_searchIndex.load(searchIndexPath());
+    loadReadCursors();
+    seedSampleMessages();
+    catchUpSearchIndex();
+
+    // 为磁盘上已有的会话建立快照，一次性发布
+    QMutexLocker locker(&m_writeMutex);
+    auto& pool = StringPool::instance();
+    auto snapshots = std::make_shared<SnapshotMap>(*loadSnapshots());
+    const QStringList conversations = m_storage.conversations();
+    for (const QString& conversationId : conversations) {
+        const StringHandle handle = pool.intern(conversationId);
+        if (!snapshots->contains(handle))
+            snapshots->insert(handle, std::make_shared<const ConversationSnapshot>(buildSnapshot(conversationId)));
+    }
+    std::atomic_store(&m_snapshots, std::shared_ptr<const SnapshotMap>(std::move(snapshots)));
+
+    // 变更通知与定时器都在界面线程处理；子对象（两个定时器）随之迁移
+    if (QCoreApplication::instance())
+        moveToThread(QCoreApplication::instance()->thread());
+}
+
+MessageRepository::~MessageRepository()
+{
+    m_ioPool.waitForDone();
+    saveSearchIndex();
+    if (m_cursorsDirty.exchange(false))
+        saveReadCursors();
+}
+
+MessageRepository& MessageRepository::instance()
+{
+    static MessageRepository repo(storagePath());
+    return repo;
+}
+
+QString MessageRepository::searchIndexPath() const
+{
+    return m_rootPath + "/search.idx";
+}
+
+QString MessageRepository::readCursorsPath() const
+{
+    return m_rootPath + "/read-cursors.dat";
+}
+
+void MessageRepository::seedSampleMessages()
 {
     auto applyRandomOffset = [](QSharedPointer<ChatMessage> &msg) {
         // 随机产生 [-180, +180] 之间的秒数
@@ -12,9 +106,11 @@ MessageRepository::MessageRepository(QObject* parent)
         msg->setTimestamp(msg->getTimestamp().addSecs(offset));
     };
 
-    // 群聊初始消息
+    // 群聊初始消息（仅在本地还没有该会话记录时写入）
     auto groups = GroupRepository::instance().getAllGroup();
     for (auto group : groups) {
+        if (m_storage.count(group.groupId) > 0)
+            continue;
         auto text = QString("欢迎来到%1!").arg(group.groupName);
         auto msg = QSharedPointer<ChatMessage>(new TextMessage(
                 text,
@@ -35,6 +131,8 @@ MessageRepository::MessageRepository(QObject* parent)
     // 单聊初始消息
     auto users = UserRepository::instance().getAllUser();
     for (auto user : users) {
+        if (m_storage.count(user.id) > 0)
+            continue;
         auto text1 = QString("你好，我是%1!").arg(user.nick);
         auto text2 = QString("很高兴认识你！");
 
@@ -54,58 +152,710 @@ MessageRepository::MessageRepository(QObject* parent)
         msg1->setTimestamp(QDateTime::fromString("2024-05-21T13:14:00", Qt::ISODate));
         msg2->setTimestamp(QDateTime::fromString("2024-05-21T13:14:00", Qt::ISODate));
         applyRandomOffset(msg2);
-        addMessage(user.id, msg1);
-        addMessage(user.id, msg2);
+        addMessages(user.id, { msg1, msg2 });
     }
 }
 
-MessageRepository& MessageRepository::instance()
+ConversationSnapshotPtr MessageRepository::snapshot(const QString& conversationId) const
 {
-    static MessageRepository repo;
-    return repo;
+    return snapshot(StringPool::instance().find(conversationId));
+}
+
+ConversationSnapshotPtr MessageRepository::snapshot(StringHandle conversationId) const
+{
+    return loadSnapshots()->value(conversationId);
 }
 
 QVector<QSharedPointer<ChatMessage>>
 MessageRepository::getMessages(const QString& conversationId)
 {
-    QMutexLocker locker(&m_mutex);
-    return m_store.value(conversationId);
+    return readRange(conversationId, 0, m_storage.count(conversationId));
+}
+
+QVector<QSharedPointer<ChatMessage>>
+MessageRepository::fetchRange(const QString& conversationId, qint64 beforeSeq, int count)
+{
+    // 落在快照尾部内的请求直接返回，不碰磁盘和锁
+    if (const ConversationSnapshotPtr snap = snapshot(conversationId)) {
+        const MessagePage& tail = snap->tail;
+        const auto it = std::lower_bound(tail.begin(), tail.end(), beforeSeq,
+                                         [](const QSharedPointer<ChatMessage>& msg, qint64 seq) {
+                                             return msg->getSeq() < seq;
+                                         });
+        const int end = int(it - tail.begin());
+        if (end >= count || tail.size() == snap->summary.totalCount)
+            return tail.mid(qMax(0, end - count), qMin(end, count));
+    }
+
+    const int end = m_storage.lowerBound(conversationId, beforeSeq);
+    return readRange(conversationId, qMax(0, end - count), end);
+}
+
+QVector<QSharedPointer<ChatMessage>>
+MessageRepository::fetchLatest(const QString& conversationId, int count)
+{
+    if (const ConversationSnapshotPtr snap = snapshot(conversationId)) {
+        const MessagePage& tail = snap->tail;
+        if (count <= tail.size() || tail.size() == snap->summary.totalCount)
+            return tail.mid(qMax(0, int(tail.size()) - count));
+    }
+
+    const int end = m_storage.count(conversationId);
+    return readRange(conversationId, qMax(0, end - count), end);
+}
+
+QVector<MessageStore::MappedRecord>
+MessageRepository::mapRange(const QString& conversationId, qint64 beforeSeq, int count)
+{
+    // 快照尾部的消息已在内存中，直接复用
+    if (const ConversationSnapshotPtr snap = snapshot(conversationId)) {
+        const MessagePage& tail = snap->tail;
+        const auto it = std::lower_bound(tail.begin(), tail.end(), beforeSeq,
+                                         [](const QSharedPointer<ChatMessage>& msg, qint64 seq) {
+                                             return msg->getSeq() < seq;
+                                         });
+        const int end = int(it - tail.begin());
+        if (end >= count || tail.size() == snap->summary.totalCount) {
+            QVector<MessageStore::MappedRecord> result;
+            for (const auto& message : tail.mid(qMax(0, end - count), qMin(end, count))) {
+                MessageStore::MappedRecord record;
+                record.message = message;
+                result.push_back(std::move(record));
+            }
+            return result;
+        }
+    }
+
+    const int end = m_storage.lowerBound(conversationId, beforeSeq);
+    const int first = qMax(0, end - count);
+    return m_storage.mapRecords(conversationId, first, end - first);
+}
+
+QVector<MessageSearchHit> MessageRepository::search(const QString& query, int limit)
+{
+    auto& pool = StringPool::instance();
+    QVector<MessageSearchHit> result;
+    const auto hits = m_searchIndex.search(query, limit);
+    result.reserve(hits.size());
+    for (const auto& hit : hits) {
+        MessageSearchHit item;
+        item.conversationId = pool.string(hit.conversation);
+        // 索引存盘前崩溃可能残留已删除的消息，以存储为准
+        item.messageIndex = m_storage.indexOf(item.conversationId, hit.seq);
+        if (item.messageIndex < 0)
+            continue;
+        item.seq = hit.seq;
+        item.score = hit.score;
+        result.push_back(item);
+    }
+    return result;
+}
+
+void MessageRepository::setTieringPolicy(const TieringPolicy& policy)
+{
+    QMutexLocker locker(&m_writeMutex);
+    m_tieringPolicy = policy;
+}
+
+TieringPolicy MessageRepository::tieringPolicy()
+{
+    QMutexLocker locker(&m_writeMutex);
+    return m_tieringPolicy;
+}
+
+StorageStats MessageRepository::storageStats()
+{
+    StorageStats stats;
+    auto& pool = StringPool::instance();
+    const auto snapshots = loadSnapshots();
+    for (auto it = snapshots->cbegin(); it != snapshots->cend(); ++it) {
+        const MessageStore::TierStats tier = m_storage.tierStats(pool.string(it.key()));
+        stats.conversations++;
+        stats.hotMessages += tier.hotMessages;
+        stats.coldMessages += tier.coldMessages;
+        stats.hotBytes += tier.hotBytes;
+        stats.coldBytes += tier.coldBytes;
+        stats.snapshotMessages += it.value()->tail.size();
+    }
+    stats.duplicatesDropped = m_duplicates;
+    stats.movedToCold = m_movedToCold;
+    QMutexLocker locker(&m_pageMutex);
+    stats.cachedPages = m_pages.size();
+    return stats;
+}
+
+bool MessageRepository::syncStorage()
+{
+    return m_storage.sync();
+}
+
+QSet<quint64> MessageRepository::storedMessageIds(const QString& conversationId, const QSet<quint64>& ids,
+                                                  qint64 sinceMs)
+{
+    return m_storage.existingIds(conversationId, ids, sinceMs);
 }
 
 QSharedPointer<ChatMessage>
 MessageRepository::getLastMessage(const QString& conversationId)
 {
-    QMutexLocker locker(&m_mutex);
-    const auto vec = m_store.value(conversationId);
-    if (!vec.isEmpty())
-        return vec.last();
-    return QSharedPointer<ChatMessage>(nullptr);
+    const ConversationSnapshotPtr snap = snapshot(conversationId);
+    return snap ? snap->summary.lastMessage : QSharedPointer<ChatMessage>();
+}
+
+int MessageRepository::messageCount(const QString& conversationId)
+{
+    const ConversationSnapshotPtr snap = snapshot(conversationId);
+    return snap ? snap->summary.totalCount : 0;
+}
+
+ConversationSummary MessageRepository::getSummary(const QString& conversationId)
+{
+    if (const ConversationSnapshotPtr snap = snapshot(conversationId))
+        return snap->summary;
+    ConversationSummary summary;
+    summary.conversationId = conversationId;
+    return summary;
+}
+
+QVector<ConversationSummary> MessageRepository::getSummaries()
+{
+    const std::shared_ptr<const SnapshotMap> snapshots = loadSnapshots();
+    QVector<ConversationSummary> result;
+    result.reserve(snapshots->size());
+    for (const ConversationSnapshotPtr& snap : *snapshots) {
+        result.push_back(snap->summary);
+    }
+    return result;
+}
+
+void MessageRepository::markRead(const QString& conversationId, qint64 upToSeq)
+{
+    {
+        QMutexLocker locker(&m_writeMutex);
+        const ConversationSnapshotPtr snap = snapshot(conversationId);
+        if (!snap || !snap->summary.lastMessage)
+            return;
+        const qint64 lastSeq = snap->summary.lastMessage->getSeq();
+        upToSeq = qMin(upToSeq, lastSeq);
+        if (upToSeq <= snap->summary.readSeq)
+            return;
+        ConversationSnapshot next = *snap;
+        next.summary.readSeq = upToSeq;
+        // 读到最后一条是常见情况，无需访问存储；否则只数游标之后的条目
+        next.summary.unreadCount = upToSeq == lastSeq ? 0 : m_storage.incomingCount(conversationId, upToSeq);
+        m_readCursors.insert(StringPool::instance().intern(conversationId), upToSeq);
+        m_cursorsDirty = true;
+        publish(conversationId, std::move(next));
+    }
+    markChanged({ conversationId });
+}
+
+void MessageRepository::clearUnread(const QString& conversationId)
+{
+    const ConversationSnapshotPtr snap = snapshot(conversationId);
+    if (snap && snap->summary.lastMessage && snap->summary.unreadCount > 0)
+        markRead(conversationId, snap->summary.lastMessage->getSeq());
 }
 
 void MessageRepository::addMessage(const QString& conversationId,
                                    QSharedPointer<ChatMessage> message)
 {
     {
-        QMutexLocker locker(&m_mutex);
-        m_store[conversationId].push_back(message);
+        QMutexLocker locker(&m_writeMutex);
+        ConversationSnapshot next = currentSnapshot(conversationId);
+        if (!appendLocked(conversationId, next, message))
+            return;
+        publish(conversationId, std::move(next));
     }
+    markChanged({ conversationId });
     // 发射最新一条
     emit lastMessageChanged(conversationId, message);
 }
 
+void MessageRepository::addMessages(const QString& conversationId,
+                                    const QVector<QSharedPointer<ChatMessage>>& batch)
+{
+    if (batch.isEmpty())
+        return;
+    {
+        QMutexLocker locker(&m_writeMutex);
+        ConversationSnapshot next = currentSnapshot(conversationId);
+        int appended = 0;
+        for (const auto& message : batch) {
+            appended += appendLocked(conversationId, next, message);
+        }
+        if (appended == 0)
+            return;
+        publish(conversationId, std::move(next));
+    }
+    markChanged({ conversationId });
+}
+
+void MessageRepository::ingest(const QHash<QString, QVector<QSharedPointer<ChatMessage>>>& batches)
+{
+    const auto stored = persist(batches);
+    indexMessages(stored);
+    markChanged(QSet<QString>(stored.keyBegin(), stored.keyEnd()));
+}
+
+QHash<QString, QVector<QSharedPointer<ChatMessage>>>
+MessageRepository::persist(const QHash<QString, QVector<QSharedPointer<ChatMessage>>>& batches)
+{
+    EncodedBatches encoded;
+    for (auto it = batches.cbegin(); it != batches.cend(); ++it) {
+        QVector<EncodedMessage>& messages = encoded[it.key()];
+        messages.reserve(it.value().size());
+        for (const auto& message : it.value()) {
+            messages.push_back({ message, QByteArray() });
+        }
+    }
+    return persist(encoded);
+}
+
+QHash<QString, QVector<QSharedPointer<ChatMessage>>>
+MessageRepository::persist(const EncodedBatches& batches)
+{
+    QHash<QString, QVector<QSharedPointer<ChatMessage>>> stored;
+    QMutexLocker locker(&m_writeMutex);
+    QHash<QString, ConversationSnapshot> updates;
+    for (auto it = batches.cbegin(); it != batches.cend(); ++it) {
+        if (it.value().isEmpty())
+            continue;
+        ConversationSnapshot next = currentSnapshot(it.key());
+        QVector<QSharedPointer<ChatMessage>> written;
+        for (const EncodedMessage& item : it.value()) {
+            if (appendLocked(it.key(), next, item.message, false, item.record))
+                written.push_back(item.message);
+        }
+        // 整批都是重复的会话不发布、不通知
+        if (written.isEmpty())
+            continue;
+        stored.insert(it.key(), std::move(written));
+        updates.insert(it.key(), std::move(next));
+    }
+    publish(std::move(updates));
+    return stored;
+}
+
+void MessageRepository::indexMessages(const QHash<QString, QVector<QSharedPointer<ChatMessage>>>& batches)
+{
+    auto& pool = StringPool::instance();
+    for (auto it = batches.cbegin(); it != batches.cend(); ++it) {
+        const StringHandle handle = pool.intern(it.key());
+        for (const auto& message : it.value()) {
+            m_searchIndex.add(handle, message->getSeq(), indexedText(*message));
+        }
+    }
+}
+
+void MessageRepository::notifyChanged(const QSet<QString>& conversationIds)
+{
+    markChanged(conversationIds);
+}
+
 void MessageRepository::removeMessage(const QString& conversationId, int index)
 {
     QSharedPointer<ChatMessage> lastMsg;
     {
-        QMutexLocker locker(&m_mutex);
-        auto &vec = m_store[conversationId];
-        if (index >= 0 && index < vec.size())
-            vec.removeAt(index);
-        // 更新 lastMsg
-        if (!vec.isEmpty())
-            lastMsg = vec.last();
-        else
-            m_store.remove(conversationId);
+        QMutexLocker locker(&m_writeMutex);
+        if (!removeAndPublishLocked(conversationId, index, lastMsg))
+            return;
+    }
+    scheduleCompaction(conversationId);
+    markChanged({ conversationId });
+    emit lastMessageChanged(conversationId, lastMsg);
+}
+
+void MessageRepository::removeMessageById(const QString& conversationId, quint64 messageId)
+{
+    if (messageId == 0)
+        return;
+    QSharedPointer<ChatMessage> lastMsg;
+    {
+        // id 到索引的解析与删除在同一把锁内，中间不会有别的删除挪动索引
+        QMutexLocker locker(&m_writeMutex);
+        const int index = indexOfIdLocked(conversationId, messageId);
+        if (index < 0) {
+            // 还没入库（发送日志尚未交给仓库），入库时由 appendLocked 写成墓碑
+            m_removedBeforeStored[StringPool::instance().intern(conversationId)].insert(messageId);
+            return;
+        }
+        if (!removeAndPublishLocked(conversationId, index, lastMsg))
+            return;
     }
+    scheduleCompaction(conversationId);
+    markChanged({ conversationId });
     emit lastMessageChanged(conversationId, lastMsg);
 }
+
+int MessageRepository::indexOfIdLocked(const QString& conversationId, quint64 messageId)
+{
+    // 刚发出的消息都在尾部，不用读盘
+    if (const ConversationSnapshotPtr snap = snapshot(conversationId)) {
+        const int tailStart = snap->summary.totalCount - int(snap->tail.size());
+        for (int i = int(snap->tail.size()) - 1; i >= 0; --i) {
+            if (snap->tail.at(i)->getMessageId() == messageId)
+                return tailStart + i;
+        }
+    }
+    return m_storage.indexOfId(conversationId, messageId);
+}
+
+bool MessageRepository::removeAndPublishLocked(const QString& conversationId, int index,
+                                               QSharedPointer<ChatMessage>& lastMsg)
+{
+    // 不存在的会话不建快照（建快照会在磁盘上创建会话目录）
+    const ConversationSnapshotPtr current = snapshot(conversationId);
+    if (!current || index < 0 || index >= current->summary.totalCount)
+        return false;
+    ConversationSnapshot next = *current;
+    // 删除失败时不发布、不通知
+    if (!removeLocked(conversationId, next, index))
+        return false;
+    // 更新 lastMsg
+    if (!next.tail.isEmpty())
+        lastMsg = next.tail.last();
+    next.summary.lastMessage = lastMsg;
+    next.summary.lastTimestamp = lastMsg ? lastMsg->getTimestamp() : QDateTime();
+    publish(conversationId, std::move(next));
+    return true;
+}
+
+bool MessageRepository::removeLocked(const QString& conversationId, ConversationSnapshot& next, int index)
+{
+    ConversationSummary& summary = next.summary;
+    const MessagePage removed = readRange(conversationId, index, index + 1);
+    if (removed.isEmpty() || !m_storage.remove(conversationId, index))
+        return false;
+
+    const StringHandle handle = StringPool::instance().intern(conversationId);
+    m_searchIndex.remove(handle, removed.first()->getSeq());
+    {
+        QMutexLocker pageLocker(&m_pageMutex);
+        invalidatePages(handle, index);
+    }
+    // 删除已读游标之后的来信时同步减少未读数
+    if (!removed.first()->isFromMe() && removed.first()->getSeq() > summary.readSeq && summary.unreadCount > 0)
+        summary.unreadCount--;
+    // 删除点落在快照尾部内时同步移除，尾部删空则重新读取
+    const int tailStart = summary.totalCount - int(next.tail.size());
+    if (index >= tailStart)
+        next.tail.remove(index - tailStart);
+    summary.totalCount--;
+    if (next.tail.isEmpty() && summary.totalCount > 0)
+        next.tail = readRange(conversationId, qMax(0, summary.totalCount - TAIL_SIZE), summary.totalCount);
+    return true;
+}
+
+void MessageRepository::scheduleCompaction(const QString& conversationId)
+{
+    if (!m_storage.needsCompaction(conversationId))
+        return;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        if (m_compactionQueued.contains(conversationId))
+            return;
+        m_compactionQueued.insert(conversationId);
+    }
+    m_ioPool.start([this, conversationId] {
+        {
+            QMutexLocker locker(&m_pendingMutex);
+            m_compactionQueued.remove(conversationId);
+        }
+        // 整理不改变消息的索引和内容，页缓存和快照不受影响
+        m_storage.compact(conversationId);
+    });
+}
+
+MessageRepository::MessagePage
+MessageRepository::loadPage(const QString& conversationId, int page)
+{
+    const quint64 key = pageKey(conversationId, page);
+    if (MessagePage* cached = m_pages.object(key))
+        return *cached;
+
+    auto* loaded = new MessagePage(m_storage.read(conversationId, page * PAGE_SIZE, PAGE_SIZE));
+    const MessagePage result = *loaded;
+    m_pages.insert(key, loaded);
+    return result;
+}
+
+MessageRepository::MessagePage
+MessageRepository::readRange(const QString& conversationId, int first, int last)
+{
+    MessagePage result;
+    if (first >= last)
+        return result;
+    result.reserve(last - first);
+    QMutexLocker locker(&m_pageMutex);
+    // 按页取出后截取需要的部分
+    for (int page = first / PAGE_SIZE; page * PAGE_SIZE < last; ++page) {
+        const MessagePage messages = loadPage(conversationId, page);
+        const int pageStart = page * PAGE_SIZE;
+        const int from = qMax(first, pageStart) - pageStart;
+        const int to = qMin(last, pageStart + int(messages.size())) - pageStart;
+        if (from < to)
+            result += messages.mid(from, to - from);
+    }
+    return result;
+}
+
+void MessageRepository::invalidatePages(StringHandle conversationId, int fromIndex)
+{
+    // 删除会让其后所有消息前移一位，受影响的页全部作废；
+    // 只遍历缓存中的页（至多 PAGE_CACHE_SIZE 个），与会话长度无关
+    const quint64 first = (quint64(conversationId) << 32) | quint32(fromIndex / PAGE_SIZE);
+    const quint64 last = (quint64(conversationId) << 32) | 0xFFFFFFFFu;
+    const QList<quint64> keys = m_pages.keys();
+    for (quint64 key : keys) {
+        if (key >= first && key <= last)
+            m_pages.remove(key);
+    }
+}
+
+ConversationSnapshot MessageRepository::buildSnapshot(const QString& conversationId)
+{
+    // 从存储构建，此后随增删增量维护
+    ConversationSnapshot snap;
+    ConversationSummary& summary = snap.summary;
+    summary.conversationId = StringPool::instance().shared(conversationId);
+    summary.totalCount = m_storage.count(conversationId);
+    summary.readSeq = m_readCursors.value(StringPool::instance().intern(conversationId), 0);
+    summary.unreadCount = m_storage.incomingCount(conversationId, summary.readSeq);
+    snap.tail = readRange(conversationId, qMax(0, summary.totalCount - TAIL_SIZE), summary.totalCount);
+    if (!snap.tail.isEmpty()) {
+        summary.lastMessage = snap.tail.last();
+        summary.lastTimestamp = snap.tail.last()->getTimestamp();
+    }
+    return snap;
+}
+
+ConversationSnapshot MessageRepository::currentSnapshot(const QString& conversationId)
+{
+    if (const ConversationSnapshotPtr snap = snapshot(conversationId))
+        return *snap;
+    return buildSnapshot(conversationId);
+}
+
+bool MessageRepository::appendLocked(const QString& conversationId, ConversationSnapshot& next,
+                                     const QSharedPointer<ChatMessage>& message, bool index,
+                                     const QByteArray& record)
+{
+    MessageIdFilter& filter = idFilter(conversationId);
+    if (message->getMessageId() == 0) {
+        message->setMessageId(MessageId::next());
+    } else if (filter.contains(message->getMessageId())) {
+        m_duplicates++;
+        return false;
+    }
+    auto removed = m_removedBeforeStored.find(StringPool::instance().intern(conversationId));
+    if (removed != m_removedBeforeStored.end() && removed->remove(message->getMessageId())) {
+        if (removed->isEmpty())
+            m_removedBeforeStored.erase(removed);
+        // 入库前已被删除：照常写入再立即打墓碑，发送日志重放时据此认出已处理过，
+        // 快照、页缓存和搜索索引都不经过这条消息
+        if (m_storage.append(conversationId, *message, record) >= 0) {
+            m_storage.remove(conversationId, m_storage.count(conversationId) - 1);
+            filter.insert(message->getMessageId());
+        }
+        return false;
+    }
+
+    const qint64 seq = m_storage.append(conversationId, *message, record);
+    if (seq < 0)
+        return false;
+    message->setSeq(seq);
+    filter.insert(message->getMessageId());
+    // 分阶段写入时索引稍后补上；同一会话的索引仍按序号递增加入
+    if (index)
+        m_searchIndex.add(StringPool::instance().intern(conversationId), seq, indexedText(*message));
+
+    ConversationSummary& summary = next.summary;
+    {
+        // 如果最后一页已在缓存中，直接追加，避免重新读盘；
+        // 读者可能在 append 之后刚把这页读进来，那时页里已有这条消息
+        QMutexLocker pageLocker(&m_pageMutex);
+        const int position = summary.totalCount;
+        MessagePage* page = m_pages.object(pageKey(conversationId, position / PAGE_SIZE));
+        if (page && (page->isEmpty() || page->last()->getSeq() < seq))
+            page->push_back(message);
+    }
+
+    next.tail.push_back(message);
+    if (next.tail.size() > TAIL_SIZE)
+        next.tail.removeFirst();
+
+    summary.totalCount++;
+    if (!message->isFromMe() && seq > summary.readSeq)
+        summary.unreadCount++;
+    summary.lastMessage = message;
+    summary.lastTimestamp = message->getTimestamp();
+    return true;
+}
+
+MessageIdFilter& MessageRepository::idFilter(const QString& conversationId)
+{
+    const StringHandle handle = StringPool::instance().intern(conversationId);
+    auto it = m_idFilters.find(handle);
+    if (it != m_idFilters.end())
+        return it.value();
+
+    // 重启后只记得最近的一批 id，更早的消息重放仍可能重复写入
+    MessageIdFilter& filter = m_idFilters[handle];
+    const int count = m_storage.count(conversationId);
+    const QVector<quint64> recent = m_storage.messageIds(conversationId, qMax(0, count - DEDUPE_SEED_COUNT),
+                                                         DEDUPE_SEED_COUNT);
+    for (quint64 id : recent) {
+        filter.insert(id);
+    }
+    return filter;
+}
+
+void MessageRepository::publish(const QString& conversationId, ConversationSnapshot next)
+{
+    QHash<QString, ConversationSnapshot> updates;
+    updates.insert(conversationId, std::move(next));
+    publish(std::move(updates));
+}
+
+void MessageRepository::publish(QHash<QString, ConversationSnapshot> updates)
+{
+    if (updates.isEmpty())
+        return;
+    // 复制会话表（QHash 的值只是指针，代价与会话数成正比），替换后整体发布
+    auto& pool = StringPool::instance();
+    auto snapshots = std::make_shared<SnapshotMap>(*loadSnapshots());
+    for (auto it = updates.begin(); it != updates.end(); ++it) {
+        snapshots->insert(pool.intern(it.key()), std::make_shared<const ConversationSnapshot>(std::move(it.value())));
+    }
+    std::atomic_store(&m_snapshots, std::shared_ptr<const SnapshotMap>(std::move(snapshots)));
+}
+
+void MessageRepository::markChanged(const QSet<QString>& conversationIds)
+{
+    if (conversationIds.isEmpty())
+        return;
+    QMutexLocker locker(&m_pendingMutex);
+    const bool schedule = m_pendingChanges.isEmpty();
+    m_pendingChanges.unite(conversationIds);
+    if (!schedule)
+        return;
+    // 定时器必须在仓库所在线程启动
+    QMetaObject::invokeMethod(this, [this] {
+        QTimer::singleShot(CHANGE_COALESCE_MS, this, &MessageRepository::flushChanges);
+    }, Qt::QueuedConnection);
+}
+
+void MessageRepository::flushChanges()
+{
+    QSet<QString> changed;
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        changed.swap(m_pendingChanges);
+    }
+    if (!changed.isEmpty())
+        emit conversationsChanged(changed);
+    // 未读数直接取自快照摘要，只通知确有变化的会话
+    for (const QString& conversationId : std::as_const(changed)) {
+        const ConversationSnapshotPtr snap = snapshot(conversationId);
+        const int unread = snap ? snap->summary.unreadCount : 0;
+        auto it = m_notifiedUnread.find(conversationId);
+        if (it != m_notifiedUnread.end() && it.value() == unread)
+            continue;
+        m_notifiedUnread.insert(conversationId, unread);
+        emit unreadChanged(conversationId, unread);
+    }
+    if (m_searchIndex.isDirty() && !m_indexSaveTimer.isActive())
+        m_indexSaveTimer.start();
+    if (m_cursorsDirty.exchange(false))
+        m_ioPool.start([this] { saveReadCursors(); });
+}
+
+void MessageRepository::catchUpSearchIndex()
+{
+    static constexpr int CHUNK = 256;
+    auto& pool = StringPool::instance();
+    const QStringList conversations = m_storage.conversations();
+    for (const QString& conversationId : conversations) {
+        const StringHandle handle = pool.intern(conversationId);
+        const int total = m_storage.count(conversationId);
+        int first = m_storage.lowerBound(conversationId, m_searchIndex.watermark(handle) + 1);
+        for (; first < total; first += CHUNK) {
+            const auto messages = m_storage.read(conversationId, first, CHUNK);
+            for (const auto& message : messages) {
+                m_searchIndex.add(handle, message->getSeq(), indexedText(*message));
+            }
+        }
+    }
+}
+
+void MessageRepository::saveSearchIndex()
+{
+    if (m_searchIndex.isDirty())
+        m_searchIndex.save(searchIndexPath());
+}
+
+void MessageRepository::loadReadCursors()
+{
+    QFile file(readCursorsPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    QHash<QString, qint64> cursors;
+    in >> cursors;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "MessageRepository: corrupted read cursors" << file.fileName();
+        return;
+    }
+    auto& pool = StringPool::instance();
+    QMutexLocker locker(&m_writeMutex);
+    for (auto it = cursors.cbegin(); it != cursors.cend(); ++it) {
+        m_readCursors.insert(pool.intern(it.key()), it.value());
+    }
+}
+
+void MessageRepository::saveReadCursors()
+{
+    QHash<QString, qint64> cursors;
+    {
+        QMutexLocker locker(&m_writeMutex);
+        auto& pool = StringPool::instance();
+        for (auto it = m_readCursors.cbegin(); it != m_readCursors.cend(); ++it) {
+            cursors.insert(pool.string(it.key()), it.value());
+        }
+    }
+    QSaveFile file(readCursorsPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "MessageRepository: failed to save read cursors" << file.fileName();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << cursors;
+    if (!file.commit())
+        qWarning() << "MessageRepository: failed to save read cursors" << file.fileName();
+}
+
+void MessageRepository::applyTiering()
+{
+    const TieringPolicy policy = tieringPolicy();
+    const qint64 olderThanMs = QDateTime::currentMSecsSinceEpoch() - policy.maxHotAgeSecs * 1000;
+    auto& pool = StringPool::instance();
+    const auto snapshots = loadSnapshots();
+    // 压缩不改变消息索引和内容，已缓存的页与快照无需失效
+    for (auto it = snapshots->cbegin(); it != snapshots->cend(); ++it) {
+        m_movedToCold += m_storage.compressCold(pool.string(it.key()), olderThanMs,
+                                                policy.hotMessagesPerConversation);
+    }
+}
+
+std::shared_ptr<const MessageRepository::SnapshotMap> MessageRepository::loadSnapshots() const
+{
+    return std::atomic_load(&m_snapshots);
+}
+
+quint64 MessageRepository::pageKey(const QString& conversationId, int page)
+{
+    return (quint64(StringPool::instance().intern(conversationId)) << 32) | quint32(page);
+}
@@ -0,0 +1,325 @@
+#include "MessageSearchIndex.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+
+static bool isCjk(char32_t ch)
+{
+    return (ch >= 0x3040 && ch <= 0x30FF)      // 平假名、片假名
+        || (ch >= 0x3400 && ch <= 0x4DBF)      // 汉字扩展 A
+        || (ch >= 0x4E00 && ch <= 0x9FFF)      // 基本汉字
+        || (ch >= 0xAC00 && ch <= 0xD7AF)      // 谚文
+        || (ch >= 0xF900 && ch <= 0xFAFF)      // 兼容汉字
+        || (ch >= 0x20000 && ch <= 0x2FA1F);   // 扩展 B 及以后
+}
+
+QStringList MessageSearchIndex::tokenize(QStringView text, bool withUnigrams)
+{
+    QStringList tokens;
+    QString word;
+    QVector<char32_t> run;   // 当前连续的 CJK 字符
+
+    auto flushWord = [&] {
+        if (!word.isEmpty()) {
+            tokens.append(word);
+            word.clear();
+        }
+    };
+    auto flushRun = [&] {
+        if (run.size() == 1 || withUnigrams) {
+            for (char32_t ch : std::as_const(run)) {
+                tokens.append(QString::fromUcs4(&ch, 1));
+            }
+        }
+        for (int i = 0; i + 1 < run.size(); ++i) {
+            tokens.append(QString::fromUcs4(run.constData() + i, 2));
+        }
+        run.clear();
+    };
+
+    const QList<uint> ucs4 = text.toUcs4();
+    for (uint code : ucs4) {
+        const char32_t ch = code;
+        if (isCjk(ch)) {
+            flushWord();
+            run.push_back(ch);
+        } else if (QChar::isLetterOrNumber(ch)) {
+            flushRun();
+            const char32_t lower = QChar::toLower(ch);
+            word += QString::fromUcs4(&lower, 1);
+        } else {
+            flushWord();
+            flushRun();
+        }
+    }
+    flushWord();
+    flushRun();
+    return tokens;
+}
+
+void MessageSearchIndex::add(StringHandle conversation, qint64 seq, QStringView text)
+{
+    QHash<QString, quint32> counts;
+    const QStringList terms = tokenize(text, true);
+    for (const QString& term : terms) {
+        counts[term]++;
+    }
+
+    QWriteLocker locker(&m_lock);
+    // 没有文本的消息（如图片）也登记文档，用于记录已建索引的位置
+    const quint32 doc = quint32(m_docs.size());
+    m_docs.push_back({ conversation, quint32(seq) });
+    // 通常按序号递增到达；分阶段写入时可能略有交错，插到有序位置
+    QVector<quint32>& docs = m_conversationDocs[conversation];
+    if (docs.isEmpty() || m_docs[docs.last()].seq < quint32(seq)) {
+        docs.push_back(doc);
+    } else {
+        auto pos = std::lower_bound(docs.begin(), docs.end(), quint32(seq),
+                                    [this](quint32 d, quint32 value) { return m_docs[d].seq < value; });
+        docs.insert(pos, doc);
+    }
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+        m_postings[it.key()].push_back({ doc, it.value() });
+    }
+    m_dirty = true;
+}
+
+void MessageSearchIndex::remove(StringHandle conversation, qint64 seq)
+{
+    QWriteLocker locker(&m_lock);
+    const int doc = findDoc(conversation, seq);
+    if (doc < 0)
+        return;
+    m_docs[doc].conversation = 0;
+    m_dirty = true;
+}
+
+QVector<MessageSearchIndex::Hit> MessageSearchIndex::search(const QString& query, int limit) const
+{
+    QStringList terms = tokenize(query);
+    terms.removeDuplicates();
+    if (terms.isEmpty() || limit <= 0)
+        return {};
+
+    QReadLocker locker(&m_lock);
+    QVector<PostingList> lists;
+    lists.reserve(terms.size());
+    for (const QString& term : std::as_const(terms)) {
+        PostingList list = m_postings.value(term);
+        if (list.isEmpty())
+            return {};
+        lists.push_back(std::move(list));
+    }
+
+    // 从最短的倒排表开始求交集，候选集只会越来越小
+    std::sort(lists.begin(), lists.end(),
+              [](const PostingList& a, const PostingList& b) { return a.size() < b.size(); });
+    PostingList candidates = lists.first();
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        const PostingList& list = lists[i];
+        PostingList next;
+        auto it = list.cbegin();
+        for (const Posting& posting : std::as_const(candidates)) {
+            it = std::lower_bound(it, list.cend(), posting.doc,
+                                  [](const Posting& p, quint32 doc) { return p.doc < doc; });
+            if (it == list.cend())
+                break;
+            if (it->doc == posting.doc)
+                next.push_back({ posting.doc, posting.count + it->count });
+        }
+        candidates = std::move(next);
+    }
+
+    PostingList live;
+    live.reserve(candidates.size());
+    for (const Posting& posting : std::as_const(candidates)) {
+        if (m_docs[posting.doc].conversation != 0)
+            live.push_back(posting);
+    }
+    auto better = [](const Posting& a, const Posting& b) {
+        return a.count != b.count ? a.count > b.count : a.doc > b.doc;
+    };
+    const int n = qMin(limit, int(live.size()));
+    std::partial_sort(live.begin(), live.begin() + n, live.end(), better);
+
+    QVector<Hit> hits;
+    hits.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        const DocRef& ref = m_docs[live[i].doc];
+        hits.push_back({ ref.conversation, qint64(ref.seq), int(live[i].count) });
+    }
+    return hits;
+}
+
+qint64 MessageSearchIndex::watermark(StringHandle conversation) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_conversationDocs.constFind(conversation);
+    if (it == m_conversationDocs.constEnd() || it->isEmpty())
+        return 0;
+    return m_docs[it->last()].seq;
+}
+
+bool MessageSearchIndex::isDirty() const
+{
+    return m_dirty;
+}
+
+bool MessageSearchIndex::save(const QString& path)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    {
+        // 只在内存中序列化时持锁，写文件不阻塞更新
+        QReadLocker locker(&m_lock);
+        m_dirty = false;
+
+        QDataStream out(&buffer);
+        out << FILE_MAGIC << FILE_VERSION;
+
+        // 会话表，文档中以表内下标引用，载入时重新驻留
+        QHash<StringHandle, quint32> conversationIndex;
+        QStringList conversationIds;
+        QVector<quint32> remap(m_docs.size(), UINT32_MAX);
+        quint32 liveCount = 0;
+        for (int doc = 0; doc < m_docs.size(); ++doc) {
+            const StringHandle conversation = m_docs[doc].conversation;
+            if (conversation == 0)
+                continue;
+            remap[doc] = liveCount++;
+            if (!conversationIndex.contains(conversation)) {
+                conversationIndex.insert(conversation, quint32(conversationIds.size()));
+                conversationIds.append(StringPool::instance().string(conversation));
+            }
+        }
+        out << conversationIds << liveCount;
+        for (const DocRef& ref : std::as_const(m_docs)) {
+            if (ref.conversation != 0)
+                out << conversationIndex.value(ref.conversation) << ref.seq;
+        }
+
+        // 词条数先占位，过滤掉只剩已删除文档的词条后回填
+        const qint64 termCountPos = buffer.pos();
+        quint32 termCount = 0;
+        out << termCount;
+        for (auto it = m_postings.cbegin(); it != m_postings.cend(); ++it) {
+            PostingList list;
+            for (const Posting& posting : it.value()) {
+                if (remap[posting.doc] != UINT32_MAX)
+                    list.push_back({ remap[posting.doc], posting.count });
+            }
+            if (list.isEmpty())
+                continue;
+            out << it.key() << quint32(list.size());
+            for (const Posting& posting : std::as_const(list)) {
+                out << posting.doc << posting.count;
+            }
+            ++termCount;
+        }
+        buffer.seek(termCountPos);
+        out << termCount;
+    }
+
+    QSaveFile file(path);
+    const bool ok = file.open(QIODevice::WriteOnly)
+            && file.write(buffer.data()) == buffer.size()
+            && file.commit();
+    if (!ok) {
+        qWarning() << "MessageSearchIndex: failed to save" << path;
+        m_dirty = true;
+    }
+    return ok;
+}
+
+bool MessageSearchIndex::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != FILE_MAGIC || version != FILE_VERSION)
+        return false;
+
+    QStringList conversationIds;
+    quint32 docCount = 0;
+    in >> conversationIds >> docCount;
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    QVector<StringHandle> handles;
+    handles.reserve(conversationIds.size());
+    for (const QString& id : std::as_const(conversationIds)) {
+        handles.push_back(StringPool::instance().intern(id));
+    }
+
+    QVector<DocRef> docs;
+    QHash<StringHandle, QVector<quint32>> conversationDocs;
+    // 计数来自文件，预留时设上限，防止损坏的文件触发超大分配
+    docs.reserve(qMin<quint32>(docCount, 1u << 20));
+    for (quint32 doc = 0; doc < docCount && in.status() == QDataStream::Ok; ++doc) {
+        quint32 conversation = 0;
+        quint32 seq = 0;
+        in >> conversation >> seq;
+        if (conversation >= quint32(handles.size()))
+            return false;
+        docs.push_back({ handles[conversation], seq });
+        conversationDocs[handles[conversation]].push_back(doc);
+    }
+
+    // 乱序加入的文档在会话表中插在有序位置，文档号顺序不等于序号顺序，载入后要重新按序号排
+    for (QVector<quint32>& list : conversationDocs) {
+        std::stable_sort(list.begin(), list.end(),
+                         [&docs](quint32 a, quint32 b) { return docs[a].seq < docs[b].seq; });
+    }
+
+    QHash<QString, PostingList> postings;
+    quint32 termCount = 0;
+    in >> termCount;
+    postings.reserve(qMin<quint32>(termCount, 1u << 20));
+    for (quint32 i = 0; i < termCount && in.status() == QDataStream::Ok; ++i) {
+        QString term;
+        quint32 size = 0;
+        in >> term >> size;
+        PostingList list;
+        list.reserve(qMin<quint32>(size, docCount));
+        for (quint32 j = 0; j < size && in.status() == QDataStream::Ok; ++j) {
+            Posting posting;
+            in >> posting.doc >> posting.count;
+            if (posting.doc >= docCount)
+                return false;
+            list.push_back(posting);
+        }
+        postings.insert(term, std::move(list));
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "MessageSearchIndex: corrupted index" << path;
+        return false;
+    }
+
+    QWriteLocker locker(&m_lock);
+    m_docs = std::move(docs);
+    m_conversationDocs = std::move(conversationDocs);
+    m_postings = std::move(postings);
+    m_dirty = false;
+    return true;
+}
+
+int MessageSearchIndex::findDoc(StringHandle conversation, qint64 seq) const
+{
+    auto it = m_conversationDocs.constFind(conversation);
+    if (it == m_conversationDocs.constEnd())
+        return -1;
+    const QVector<quint32>& docs = it.value();
+    auto pos = std::lower_bound(docs.cbegin(), docs.cend(), seq,
+                                [this](quint32 doc, qint64 value) { return qint64(m_docs[doc].seq) < value; });
+    if (pos == docs.cend() || qint64(m_docs[*pos].seq) != seq)
+        return -1;
+    return int(*pos);
+}
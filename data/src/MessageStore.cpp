@@ -0,0 +1,1062 @@
+#include "MessageStore.h"
+#include "StringPool.h"
+#include "FileSync.h"
+#include <QDir>
+#include <QBuffer>
+#include <QImage>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QDebug>
+#include <cstring>
+#include <algorithm>
+
+// 记录与索引均按主机字节序直接落盘，仅支持小端平台
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+#error "MessageStore requires a little-endian host"
+#endif
+
+static_assert(sizeof(MessageStore::RecordHeader) == 40, "unexpected RecordHeader layout");
+static_assert(sizeof(MessageStore::IndexEntry) == 32, "unexpected IndexEntry layout");
+
+namespace {
+    // 记录按 8 字节对齐，保证段内每条记录头都可以直接按结构体访问
+    qint64 alignedSize(qint64 size)
+    {
+        return (size + 7) & ~qint64(7);
+    }
+}
+
+MessageStore::MessageStore(const QString& rootPath)
+    : m_rootPath(rootPath)
+    , m_blockCache(BLOCK_CACHE_SIZE)
+{
+    QDir().mkpath(m_rootPath);
+}
+
+MessageStore::~MessageStore()
+{
+    qDeleteAll(m_logs);
+    retryRemovals();
+}
+
+QStringList MessageStore::conversations() const
+{
+    QStringList result;
+    const QStringList dirs = QDir(m_rootPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& dir : dirs) {
+        result.append(QString::fromUtf8(QByteArray::fromPercentEncoding(dir.toLatin1())));
+    }
+    return result;
+}
+
+int MessageStore::count(const QString& conversationId)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    return log ? int(log->live.total()) : 0;
+}
+
+int MessageStore::incomingCount(const QString& conversationId, qint64 afterSeq)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return 0;
+    // 索引按序号递增，afterSeq 之后的来信数即总数减去前缀和
+    auto it = std::upper_bound(log->index.cbegin(), log->index.cend(), afterSeq,
+                               [](qint64 value, const IndexEntry& entry) { return value < entry.seq; });
+    return int(log->incoming.total() - log->incoming.prefixSum(int(it - log->index.cbegin())));
+}
+
+bool MessageStore::sync()
+{
+    QMutexLocker locker(&m_mutex);
+    bool ok = true;
+    for (Log* log : std::as_const(m_logs)) {
+        if (log->segmentFile.isOpen() && !syncToDisk(log->segmentFile))
+            ok = false;
+        if (log->indexFile.isOpen() && !syncToDisk(log->indexFile))
+            ok = false;
+    }
+    if (!ok)
+        qWarning() << "MessageStore: failed to sync to disk";
+    return ok;
+}
+
+qint64 MessageStore::append(const QString& conversationId, const ChatMessage& message, const QByteArray& encoded)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId, true);
+    if (!log)
+        return -1;
+
+    const qint64 seq = log->nextSeq;
+    QByteArray record = encoded.isEmpty() ? QByteArray() : restamp(encoded, seq, message.getMessageId());
+    if (record.isEmpty())
+        record = encode(message, seq);
+
+    // 当前段写满后滚动到新段，旧段从此只读
+    if (log->segmentFile.size() > 0
+            && log->segmentFile.size() + record.size() > SEGMENT_SIZE_LIMIT) {
+        if (!openSegment(log, log->activeSegment + 1))
+            return -1;
+        log->segmentFile.resize(0);
+    }
+
+    // 先写记录再写索引：崩溃时段尾多出的记录会在下次打开时被截掉
+    const qint64 offset = log->segmentFile.size();
+    if (log->segmentFile.write(record) != record.size() || !log->segmentFile.flush()) {
+        qWarning() << "MessageStore: failed to write segment" << log->segmentFile.fileName();
+        return -1;
+    }
+
+    IndexEntry entry{};
+    entry.seq = seq;
+    entry.timestamp = message.getTimestamp().toMSecsSinceEpoch();
+    entry.segment = log->activeSegment;
+    entry.offset = static_cast<quint32>(offset);
+    entry.length = static_cast<quint32>(record.size());
+    entry.flags = (message.isFromMe() ? FromMe : 0) | (message.isInGroupChat() ? GroupChat : 0);
+    if (log->indexFile.write(reinterpret_cast<const char*>(&entry), sizeof(entry)) != sizeof(entry)
+            || !log->indexFile.flush()) {
+        qWarning() << "MessageStore: failed to write index" << log->indexFile.fileName();
+        return -1;
+    }
+
+    log->index.push_back(entry);
+    log->live.append(1);
+    log->incoming.append(message.isFromMe() ? 0 : 1);
+    log->nextSeq = seq + 1;
+    return seq;
+}
+
+int MessageStore::lowerBound(const QString& conversationId, qint64 seq)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return 0;
+    auto it = std::lower_bound(log->index.cbegin(), log->index.cend(), seq,
+                               [](const IndexEntry& entry, qint64 value) { return entry.seq < value; });
+    return int(log->live.prefixSum(int(it - log->index.cbegin())));
+}
+
+int MessageStore::indexOf(const QString& conversationId, qint64 seq)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return -1;
+    auto it = std::lower_bound(log->index.cbegin(), log->index.cend(), seq,
+                               [](const IndexEntry& entry, qint64 value) { return entry.seq < value; });
+    if (it == log->index.cend() || it->seq != seq || (it->flags & Deleted))
+        return -1;
+    return int(log->live.prefixSum(int(it - log->index.cbegin())));
+}
+
+QVector<QSharedPointer<ChatMessage>>
+MessageStore::read(const QString& conversationId, int first, int count)
+{
+    QVector<QSharedPointer<ChatMessage>> result;
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return result;
+    result.reserve(qMax(0, qMin(count, int(log->live.total()) - qMax(0, first))));
+    forEachRecord(log, first, count, [&result](const char* data, qint64 size, const MappedSegmentPtr&) {
+        auto message = decode(data, size);
+        if (message)
+            result.push_back(message);
+    });
+    return result;
+}
+
+int MessageStore::indexOfId(const QString& conversationId, quint64 messageId)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log || messageId == 0)
+        return -1;
+    const auto contains = [this, log, messageId](const QVector<int>& slots) {
+        bool found = false;
+        visitSlots(log, slots, [messageId, &found](const char* data, qint64 size, const MappedSegmentPtr&) {
+            found = found || recordId(data, size) == messageId;
+        });
+        return found;
+    };
+    // 要找的多是刚发出的消息：从最新的条目往前分块只读记录头，命中的块再逐条定位
+    QVector<int> slots;
+    for (int end = log->index.size(); end > 0; end -= ID_SCAN_CHUNK) {
+        slots.clear();
+        for (int i = qMax(0, end - ID_SCAN_CHUNK); i < end; ++i) {
+            if (!(log->index[i].flags & Deleted))
+                slots.push_back(i);
+        }
+        if (slots.isEmpty() || !contains(slots))
+            continue;
+        for (int slot : std::as_const(slots)) {
+            if (contains({ slot }))
+                return int(log->live.prefixSum(slot));
+        }
+        return -1;
+    }
+    return -1;
+}
+
+QVector<quint64> MessageStore::messageIds(const QString& conversationId, int first, int count)
+{
+    QVector<quint64> result;
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return result;
+    // 只看记录头，不解码负载（图片解码只能在界面线程进行）
+    forEachRecord(log, first, count, [&result](const char* data, qint64 size, const MappedSegmentPtr&) {
+        if (const quint64 id = recordId(data, size))
+            result.push_back(id);
+    });
+    return result;
+}
+
+QSet<quint64> MessageStore::existingIds(const QString& conversationId, const QSet<quint64>& ids, qint64 sinceMs)
+{
+    QSet<quint64> result;
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log || ids.isEmpty())
+        return result;
+    // 索引常驻内存，按时间戳挑出候选条目（包括墓碑），只读这些记录的头
+    QVector<int> slots;
+    for (int i = 0; i < log->index.size(); ++i) {
+        if (log->index[i].timestamp >= sinceMs)
+            slots.push_back(i);
+    }
+    visitSlots(log, slots, [&ids, &result](const char* data, qint64 size, const MappedSegmentPtr&) {
+        const quint64 id = recordId(data, size);
+        if (ids.contains(id))
+            result.insert(id);
+    });
+    return result;
+}
+
+QVector<MessageStore::MappedRecord>
+MessageStore::mapRecords(const QString& conversationId, int first, int count)
+{
+    QVector<MappedRecord> result;
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return result;
+    result.reserve(qMax(0, qMin(count, int(log->live.total()) - qMax(0, first))));
+    forEachRecord(log, first, count, [&result](const char* data, qint64 size, const MappedSegmentPtr& mapping) {
+        MappedRecord record;
+        if (mapping) {
+            record.segment = mapping;
+            record.offset = quint32(data - mapping->data());
+            record.length = quint32(size);
+        } else {
+            record.message = decode(data, size);
+            if (!record.message)
+                return;
+        }
+        result.push_back(std::move(record));
+    });
+    return result;
+}
+
+void MessageStore::forEachRecord(Log* log, int first, int count, const RecordVisitor& visit)
+{
+    first = qMax(0, first);
+    const int end = static_cast<int>(qMin<qint64>(log->live.total(), qint64(first) + count));
+    if (first >= end)
+        return;
+
+    // 换算成物理位置，跳过中间的墓碑
+    QVector<int> slots;
+    slots.reserve(end - first);
+    for (int i = physicalIndex(log, first); i < log->index.size() && slots.size() < end - first; ++i) {
+        if (!(log->index[i].flags & Deleted))
+            slots.push_back(i);
+    }
+    visitSlots(log, slots, visit);
+}
+
+void MessageStore::visitSlots(Log* log, const QVector<int>& slots, const RecordVisitor& visit)
+{
+    const quint32 location = Compressed | Compacted;
+    QFile segment;
+    QByteArray buffer;
+    int i = 0;
+    while (i < slots.size()) {
+        // 同一文件内的连续条目合并成一次读取
+        const IndexEntry& head = log->index[slots[i]];
+        int runEnd = i + 1;
+        while (runEnd < slots.size() && log->index[slots[runEnd]].segment == head.segment
+                && (log->index[slots[runEnd]].flags & location) == (head.flags & location))
+            ++runEnd;
+
+        if (head.flags & Compressed) {
+            // 冷数据按块解压，块内记录由块头的偏移表定位
+            for (int j = i; j < runEnd; ++j) {
+                const IndexEntry& entry = log->index[slots[j]];
+                const QByteArray block = readBlock(log, entry);
+                const quint32 slot = (entry.flags >> 16) & 0xFF;
+                if (block.size() < qint64(sizeof(quint32)))
+                    continue;
+                const auto* table = reinterpret_cast<const quint32*>(block.constData());
+                if (slot >= table[0] || qint64(sizeof(quint32)) * (table[0] + 2) > block.size())
+                    continue;
+                const quint32 from = table[1 + slot];
+                const quint32 to = table[2 + slot];
+                if (from > to || to > quint32(block.size()))
+                    continue;
+                visit(block.constData() + from, to - from, MappedSegmentPtr());
+            }
+            i = runEnd;
+            continue;
+        }
+
+        const IndexEntry& tail = log->index[slots[runEnd - 1]];
+        const qint64 begin = head.offset;
+        const qint64 stop = qint64(tail.offset) + tail.length;
+        // 已封存的段直接在映射上访问
+        if (const MappedSegmentPtr mapping = mapSegment(log, head); mapping && mapping->contains(begin, stop - begin)) {
+            for (int j = i; j < runEnd; ++j) {
+                const IndexEntry& entry = log->index[slots[j]];
+                visit(mapping->data() + entry.offset, entry.length, mapping);
+            }
+            i = runEnd;
+            continue;
+        }
+        segment.setFileName(recordPath(log, head));
+        if (segment.open(QIODevice::ReadOnly) && segment.seek(begin)) {
+            buffer.resize(stop - begin);
+            if (segment.read(buffer.data(), buffer.size()) == buffer.size()) {
+                for (int j = i; j < runEnd; ++j) {
+                    const IndexEntry& entry = log->index[slots[j]];
+                    visit(buffer.constData() + (entry.offset - begin), entry.length, MappedSegmentPtr());
+                }
+            }
+        } else {
+            qWarning() << "MessageStore: failed to read segment" << segment.fileName();
+        }
+        segment.close();
+        i = runEnd;
+    }
+}
+
+bool MessageStore::remove(const QString& conversationId, int index)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log || index < 0 || index >= log->live.total())
+        return false;
+
+    // 段内记录和其余条目都不动，只给该条目打上墓碑并原地改写
+    const int slot = physicalIndex(log, index);
+    IndexEntry entry = log->index[slot];
+    entry.flags |= Deleted;
+    const qint64 position = qint64(slot) * qint64(sizeof(IndexEntry));
+    const bool ok = log->indexFile.seek(position)
+            && log->indexFile.write(reinterpret_cast<const char*>(&entry), sizeof(entry)) == sizeof(entry)
+            && log->indexFile.flush();
+    log->indexFile.seek(log->indexFile.size());
+    if (!ok) {
+        qWarning() << "MessageStore: failed to write tombstone" << log->indexFile.fileName();
+        return false;
+    }
+    log->index[slot] = entry;
+    log->live.add(slot, -1);
+    if (!(entry.flags & FromMe))
+        log->incoming.add(slot, -1);
+    log->tombstones++;
+    return true;
+}
+
+int MessageStore::tombstoneCount(const QString& conversationId)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    return log ? log->tombstones : 0;
+}
+
+bool MessageStore::needsCompaction(const QString& conversationId)
+{
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log || log->tombstones < COMPACT_MIN_TOMBSTONES)
+        return false;
+    // 墓碑占四分之一以上，或绝对数量已经很大
+    return log->tombstones * 4 >= log->index.size() || log->tombstones >= COMPACT_MAX_TOMBSTONES;
+}
+
+qint64 MessageStore::compact(const QString& conversationId)
+{
+    QMutexLocker maintenance(&m_maintenanceMutex);
+    retryRemovals();
+
+    // 需要重写的段：原始段或整理过的段，一半以上是已删除记录
+    struct Rewrite {
+        quint32 segment;
+        QString source;
+        QString target;
+        int first;                  // 该段条目在索引中的范围
+        int last;
+        QVector<quint32> offsets;   // 计划时存活的条目在新文件中的偏移，墓碑为 UINT32_MAX
+        QByteArray data;
+        qint64 sourceBytes = 0;
+    };
+    QVector<Rewrite> rewrites;
+    QVector<IndexEntry> planned;
+
+    // 第一步（持锁）：挑出要重写的段，复制条目
+    {
+        QMutexLocker locker(&m_mutex);
+        Log* log = openLog(conversationId);
+        if (!log)
+            return -1;
+        if (log->tombstones == 0)
+            return 0;
+        planned = log->index;
+        int i = 0;
+        while (i < planned.size()) {
+            const IndexEntry& head = planned[i];
+            int runEnd = i + 1;
+            while (runEnd < planned.size() && planned[runEnd].segment == head.segment)
+                ++runEnd;
+            qint64 liveBytes = 0;
+            qint64 deadBytes = 0;
+            for (int j = i; j < runEnd; ++j) {
+                (planned[j].flags & Deleted ? deadBytes : liveBytes) += planned[j].length;
+            }
+            // 当前可写段继续追加，压缩块只在整块都删除后回收
+            if (head.segment < log->activeSegment && !(head.flags & Compressed) && deadBytes > liveBytes) {
+                const QString source = recordPath(log, head);
+                const QString target = head.flags & Compacted ? segmentPath(log, head.segment)
+                                                              : compactedPath(log, head.segment);
+                // 同名的旧文件还没删掉（仍被映射）时，新文件提交不上去，等它删除后再整理这一段
+                if (!m_pendingRemovals.contains(target))
+                    rewrites.push_back({ head.segment, source, target, i, runEnd, {}, {} });
+            }
+            i = runEnd;
+        }
+    }
+
+    // 第二步（不持锁）：已封存的段不会再被写，只有本函数和 compressCold 会替换它们，已由 m_maintenanceMutex 排除
+    for (Rewrite& rewrite : rewrites) {
+        QFile source(rewrite.source);
+        if (!source.open(QIODevice::ReadOnly)) {
+            qWarning() << "MessageStore: failed to open segment for compaction" << rewrite.source;
+            return -1;
+        }
+        const QByteArray raw = source.readAll();
+        rewrite.sourceBytes = raw.size();
+        rewrite.offsets.resize(rewrite.last - rewrite.first);
+        for (int j = rewrite.first; j < rewrite.last; ++j) {
+            const IndexEntry& entry = planned[j];
+            if (entry.flags & Deleted || qint64(entry.offset) + entry.length > raw.size()) {
+                rewrite.offsets[j - rewrite.first] = UINT32_MAX;
+                continue;
+            }
+            rewrite.offsets[j - rewrite.first] = quint32(rewrite.data.size());
+            rewrite.data.append(raw.constData() + entry.offset, entry.length);
+        }
+        if (rewrite.data.isEmpty())
+            continue;
+        QSaveFile target(rewrite.target);
+        if (!target.open(QIODevice::WriteOnly)
+                || target.write(rewrite.data) != rewrite.data.size() || !target.commit()) {
+            qWarning() << "MessageStore: failed to write compacted segment" << rewrite.target;
+            return -1;
+        }
+    }
+
+    // 第三步（持锁）：切换索引。计划之后只会有新的墓碑和追加，已有条目的位置不变
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return -1;
+    const QVector<IndexEntry> previous = log->index;
+    QSet<quint32> blocksBefore;
+    for (const IndexEntry& entry : std::as_const(log->index)) {
+        if (entry.flags & Compressed)
+            blocksBefore.insert(entry.segment);
+    }
+    for (const Rewrite& rewrite : std::as_const(rewrites)) {
+        for (int j = rewrite.first; j < rewrite.last; ++j) {
+            IndexEntry& entry = log->index[j];
+            const quint32 offset = rewrite.offsets[j - rewrite.first];
+            if (offset == UINT32_MAX) {
+                entry.flags |= Deleted;
+                continue;
+            }
+            entry.offset = offset;
+            entry.flags ^= Compacted;
+        }
+    }
+
+    QVector<IndexEntry> kept;
+    kept.reserve(log->index.size() - log->tombstones);
+    QSet<quint32> blocksAfter;
+    for (const IndexEntry& entry : std::as_const(log->index)) {
+        if (entry.flags & Deleted)
+            continue;
+        kept.push_back(entry);
+        if (entry.flags & Compressed)
+            blocksAfter.insert(entry.segment);
+    }
+    // 下一个序号由最后一个条目推出；最新的消息已被删除时留一个零长度的墓碑，
+    // 指向当前可写段的末尾，重启后序号不会回退、不会复用
+    if (log->index.last().flags & Deleted) {
+        IndexEntry marker{};
+        marker.seq = log->nextSeq - 1;
+        marker.timestamp = log->index.last().timestamp;
+        marker.segment = log->activeSegment;
+        marker.offset = quint32(log->segmentFile.size());
+        marker.flags = Deleted;
+        kept.push_back(marker);
+    }
+    log->index = std::move(kept);
+    if (!rewriteIndex(log)) {
+        // 索引未切换，仍指向旧文件，新写的文件下次整理时会被覆盖
+        log->index = previous;
+        rebuildLive(log);
+        return -1;
+    }
+    rebuildLive(log);
+
+    // 索引已指向新文件，旧文件与整块删除的压缩块可以删掉；删不掉的文件空间还没有回收，不计入
+    qint64 reclaimed = 0;
+    for (const Rewrite& rewrite : std::as_const(rewrites)) {
+        unmapSegment(log, rewrite.segment);
+        if (removeFile(rewrite.source))
+            reclaimed += rewrite.sourceBytes - rewrite.data.size();
+    }
+    for (quint32 segment : std::as_const(blocksBefore)) {
+        if (!blocksAfter.contains(segment)) {
+            const QString path = blockPath(log, segment);
+            const qint64 size = QFileInfo(path).size();
+            if (removeFile(path))
+                reclaimed += size;
+        }
+    }
+    return reclaimed;
+}
+
+int MessageStore::compressCold(const QString& conversationId, qint64 olderThanMs, int keepNewest)
+{
+    QMutexLocker maintenance(&m_maintenanceMutex);
+    retryRemovals();
+
+    struct Plan {
+        quint32 segment;
+        QString source;
+        QString target;
+        int first;                  // 该段条目在索引中的范围
+        int last;
+        QVector<IndexEntry> entries;
+        QByteArray blocks;
+    };
+    QVector<Plan> plans;
+
+    // 第一步（持锁）：挑出要压缩的段，复制条目
+    {
+        QMutexLocker locker(&m_mutex);
+        Log* log = openLog(conversationId);
+        if (!log)
+            return 0;
+
+        const int hotStart = qMax(0, int(log->index.size()) - keepNewest);
+        int i = 0;
+        while (i < log->index.size()) {
+            // 同一段的条目在索引中是连续的
+            const quint32 segmentNo = log->index[i].segment;
+            int runEnd = i + 1;
+            while (runEnd < log->index.size() && log->index[runEnd].segment == segmentNo)
+                ++runEnd;
+
+            // 只处理已封存且尚未压缩的段，段内每条消息都要满足冷数据条件
+            bool eligible = segmentNo < log->activeSegment;
+            for (int j = i; j < runEnd && eligible; ++j) {
+                const IndexEntry& entry = log->index[j];
+                eligible = !(entry.flags & Compressed)
+                        && (j < hotStart || entry.timestamp < olderThanMs);
+            }
+            // 同名的块文件还在待删列表中时先跳过
+            if (eligible && !m_pendingRemovals.contains(blockPath(log, segmentNo))) {
+                plans.push_back({ segmentNo, recordPath(log, log->index[i]), blockPath(log, segmentNo), i, runEnd,
+                                  QVector<IndexEntry>(log->index.cbegin() + i, log->index.cbegin() + runEnd), {} });
+            }
+            i = runEnd;
+        }
+    }
+
+    // 第二步（不持锁）：读段、压缩并写块文件。已封存的段不会再被写，整理已由 m_maintenanceMutex 排除
+    QVector<Plan> written;
+    for (Plan& plan : plans) {
+        if (!compressSegment(plan.source, plan.entries, plan.blocks))
+            continue;
+        QSaveFile file(plan.target);
+        if (!file.open(QIODevice::WriteOnly) || file.write(plan.blocks) != plan.blocks.size() || !file.commit()) {
+            qWarning() << "MessageStore: failed to write cold block" << file.fileName();
+            continue;
+        }
+        plan.blocks.clear();
+        written.push_back(std::move(plan));
+    }
+    if (written.isEmpty())
+        return 0;
+
+    // 第三步（持锁）：切换索引。计划之后只会有新的墓碑和追加，已有条目的位置不变
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return 0;
+    const QVector<IndexEntry> previous = log->index;
+    int compressedCount = 0;
+    for (const Plan& plan : std::as_const(written)) {
+        for (int j = plan.first; j < plan.last; ++j) {
+            IndexEntry& entry = log->index[j];
+            // 保留压缩期间新打的墓碑
+            const quint32 deleted = entry.flags & Deleted;
+            entry = plan.entries[j - plan.first];
+            entry.flags = (entry.flags & ~quint32(Deleted)) | deleted;
+        }
+        compressedCount += plan.last - plan.first;
+    }
+    if (!rewriteIndex(log)) {
+        // 索引仍指向原段，写好的块文件下次压缩时会被覆盖
+        log->index = previous;
+        return 0;
+    }
+    // 索引已指向块文件，原段可以删掉
+    for (const Plan& plan : std::as_const(written)) {
+        unmapSegment(log, plan.segment);
+        removeFile(plan.source);
+    }
+    return compressedCount;
+}
+
+MessageStore::TierStats MessageStore::tierStats(const QString& conversationId)
+{
+    TierStats stats;
+    QMutexLocker locker(&m_mutex);
+    Log* log = openLog(conversationId);
+    if (!log)
+        return stats;
+
+    qint64 lastBlock = -1;
+    for (const IndexEntry& entry : std::as_const(log->index)) {
+        if (entry.flags & Deleted)
+            continue;
+        if (entry.flags & Compressed) {
+            stats.coldMessages++;
+            // 同一块的条目相邻，块大小只计一次
+            const qint64 block = (qint64(entry.segment) << 32) | entry.offset;
+            if (block != lastBlock)
+                stats.coldBytes += entry.length;
+            lastBlock = block;
+        } else {
+            stats.hotMessages++;
+            stats.hotBytes += entry.length;
+        }
+    }
+    return stats;
+}
+
+QByteArray MessageStore::encode(const ChatMessage& message, qint64 seq)
+{
+    QByteArray payload;
+    if (message.getType() == MessageType::Text) {
+        const QString text = message.getContent();
+        payload = QByteArray(reinterpret_cast<const char*>(text.utf16()),
+                             text.size() * qint64(sizeof(QChar)));
+    } else if (message.getType() == MessageType::Image) {
+        QBuffer buffer(&payload);
+        buffer.open(QIODevice::WriteOnly);
+        static_cast<const ImageMessage&>(message).getImage().save(&buffer, "PNG");
+    }
+
+    const QString senderId = message.getSenderId();
+    const QString senderName = message.getSenderName();
+
+    RecordHeader header{};
+    header.magic = RECORD_MAGIC;
+    header.version = RECORD_VERSION;
+    header.type = static_cast<quint8>(message.getType());
+    header.flags = (message.isFromMe() ? FromMe : 0) | (message.isInGroupChat() ? GroupChat : 0);
+    header.role = static_cast<quint8>(message.getRole());
+    header.senderIdLength = static_cast<quint32>(senderId.size());
+    header.senderNameLength = static_cast<quint32>(senderName.size());
+    header.payloadLength = static_cast<quint32>(payload.size());
+    header.seq = seq;
+    header.timestamp = message.getTimestamp().toMSecsSinceEpoch();
+
+    const qint64 idBytes = senderId.size() * qint64(sizeof(QChar));
+    const qint64 nameBytes = senderName.size() * qint64(sizeof(QChar));
+    const quint64 messageId = message.getMessageId();
+    QByteArray record(alignedSize(sizeof(header) + sizeof(messageId) + idBytes + nameBytes + payload.size()), '\0');
+    char* out = record.data();
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, &messageId, sizeof(messageId));
+    out += sizeof(messageId);
+    std::memcpy(out, senderId.utf16(), idBytes);
+    out += idBytes;
+    std::memcpy(out, senderName.utf16(), nameBytes);
+    out += nameBytes;
+    std::memcpy(out, payload.constData(), payload.size());
+    return record;
+}
+
+QByteArray MessageStore::restamp(const QByteArray& record, qint64 seq, quint64 messageId)
+{
+    RecordHeader header;
+    if (record.size() < qsizetype(sizeof(header)) || record.size() != alignedSize(record.size()))
+        return {};
+    std::memcpy(&header, record.constData(), sizeof(header));
+    if (header.version < 2 || payloadOffset(header, record.size()) < 0)
+        return {};
+    QByteArray result = record;
+    header.seq = seq;
+    std::memcpy(result.data(), &header, sizeof(header));
+    std::memcpy(result.data() + sizeof(header), &messageId, sizeof(messageId));
+    return result;
+}
+
+QSharedPointer<ChatMessage> MessageStore::decode(const char* data, qint64 size)
+{
+    if (size < qint64(sizeof(RecordHeader)))
+        return {};
+
+    RecordHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (payloadOffset(header, size) < 0)
+        return {};
+    const qint64 idBytes = header.senderIdLength * qint64(sizeof(QChar));
+    const qint64 nameBytes = header.senderNameLength * qint64(sizeof(QChar));
+
+    quint64 messageId = 0;
+    if (header.version >= 2)
+        std::memcpy(&messageId, data + sizeof(header), sizeof(messageId));
+    const char* cursor = data + headerSize(header);
+    // 发送者 id/名字在大量消息中重复，取驻留表中的共享副本
+    auto& pool = StringPool::instance();
+    const QString senderId = pool.shared(QString(reinterpret_cast<const QChar*>(cursor), header.senderIdLength));
+    cursor += idBytes;
+    const QString senderName = pool.shared(QString(reinterpret_cast<const QChar*>(cursor), header.senderNameLength));
+    cursor += nameBytes;
+
+    const bool fromMe = header.flags & FromMe;
+    const bool groupChat = header.flags & GroupChat;
+    const auto role = static_cast<GroupRole>(header.role);
+
+    QSharedPointer<ChatMessage> message;
+    switch (static_cast<MessageType>(header.type)) {
+    case MessageType::Text: {
+        const QString text(reinterpret_cast<const QChar*>(cursor), header.payloadLength / sizeof(QChar));
+        message = QSharedPointer<TextMessage>::create(text, fromMe, senderId, groupChat, senderName, role);
+        break;
+    }
+    case MessageType::Image: {
+        // 只解码为 QImage：读取可能发生在工作线程，QPixmap 由界面线程显示时再转换
+        const QImage image = QImage::fromData(QByteArray::fromRawData(cursor, header.payloadLength));
+        message = QSharedPointer<ImageMessage>::create(image, fromMe, senderId, groupChat, senderName, role);
+        break;
+    }
+    default:
+        return {};
+    }
+    message->setTimestamp(QDateTime::fromMSecsSinceEpoch(header.timestamp));
+    message->setSeq(header.seq);
+    message->setMessageId(messageId);
+    return message;
+}
+
+quint64 MessageStore::recordId(const char* data, qint64 size)
+{
+    RecordHeader header;
+    if (size < qint64(sizeof(header) + sizeof(quint64)))
+        return 0;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != RECORD_MAGIC || header.version < 2)
+        return 0;
+    quint64 id = 0;
+    std::memcpy(&id, data + sizeof(header), sizeof(id));
+    return id;
+}
+
+qint64 MessageStore::headerSize(const RecordHeader& header)
+{
+    return qint64(sizeof(header)) + (header.version >= 2 ? qint64(sizeof(quint64)) : 0);
+}
+
+qint64 MessageStore::payloadOffset(const RecordHeader& header, qint64 size)
+{
+    if (header.magic != RECORD_MAGIC || header.version > RECORD_VERSION)
+        return -1;
+    const qint64 offset = headerSize(header) + (qint64(header.senderIdLength) + header.senderNameLength) * qint64(sizeof(QChar));
+    if (offset + header.payloadLength > size)
+        return -1;
+    return offset;
+}
+
+MessageStore::Log* MessageStore::openLog(const QString& conversationId, bool create)
+{
+    auto it = m_logs.constFind(conversationId);
+    if (it != m_logs.constEnd())
+        return it.value();
+
+    const QString dir = m_rootPath + "/" + QString::fromLatin1(conversationId.toUtf8().toPercentEncoding());
+    // 没有写过消息的会话（悬停预取、搜索、打开没有记录的好友）不建目录，也不常驻文件句柄
+    if (!create && !QFileInfo::exists(dir))
+        return nullptr;
+    auto* log = new Log;
+    log->dir = dir;
+    QDir().mkpath(log->dir);
+
+    // 加载索引，丢弃写了一半的尾部条目
+    log->indexFile.setFileName(log->dir + "/index.idx");
+    if (!log->indexFile.open(QIODevice::ReadWrite)) {
+        qWarning() << "MessageStore: failed to open index" << log->indexFile.fileName();
+        delete log;
+        return nullptr;
+    }
+    const qint64 entryCount = log->indexFile.size() / qint64(sizeof(IndexEntry));
+    log->index.resize(entryCount);
+    log->indexFile.read(reinterpret_cast<char*>(log->index.data()), entryCount * qint64(sizeof(IndexEntry)));
+    log->indexFile.resize(entryCount * qint64(sizeof(IndexEntry)));
+    log->indexFile.seek(log->indexFile.size());
+    rebuildLive(log);
+
+    qint64 segmentEnd = 0;
+    if (!log->index.isEmpty()) {
+        const IndexEntry& last = log->index.last();
+        log->nextSeq = last.seq + 1;
+        if (last.flags & (Compressed | Compacted)) {
+            // 最后一条所在的段已被压缩或整理过（其后的消息都被删除了），从新段开始写
+            log->activeSegment = last.segment + 1;
+        } else {
+            log->activeSegment = last.segment;
+            segmentEnd = qint64(last.offset) + last.length;
+        }
+    }
+    removeOrphans(log);
+    if (!openSegment(log, log->activeSegment)) {
+        delete log;
+        return nullptr;
+    }
+    // 截掉段尾未进入索引的记录
+    if (log->segmentFile.size() > segmentEnd) {
+        log->segmentFile.resize(segmentEnd);
+        log->segmentFile.seek(segmentEnd);
+    }
+
+    m_logs.insert(conversationId, log);
+    return log;
+}
+
+bool MessageStore::openSegment(Log* log, quint32 segment)
+{
+    // 封存的段在切换前落盘，此后 sync 只需处理当前段
+    if (log->segmentFile.isOpen())
+        syncToDisk(log->segmentFile);
+    log->segmentFile.close();
+    log->segmentFile.setFileName(segmentPath(log, segment));
+    if (!log->segmentFile.open(QIODevice::ReadWrite)) {
+        qWarning() << "MessageStore: failed to open segment" << log->segmentFile.fileName();
+        return false;
+    }
+    log->segmentFile.seek(log->segmentFile.size());
+    log->activeSegment = segment;
+    return true;
+}
+
+bool MessageStore::rewriteIndex(Log* log)
+{
+    const QString path = log->indexFile.fileName();
+    log->indexFile.close();
+
+    QSaveFile file(path);
+    const qint64 bytes = qint64(log->index.size()) * qint64(sizeof(IndexEntry));
+    bool ok = file.open(QIODevice::WriteOnly)
+            && file.write(reinterpret_cast<const char*>(log->index.constData()), bytes) == bytes
+            && file.commit();
+    if (!ok)
+        qWarning() << "MessageStore: failed to rewrite index" << path;
+
+    if (!log->indexFile.open(QIODevice::ReadWrite))
+        return false;
+    log->indexFile.seek(log->indexFile.size());
+    return ok;
+}
+
+void MessageStore::rebuildLive(Log* log)
+{
+    QVector<qint64> values(log->index.size());
+    QVector<qint64> incoming(log->index.size());
+    log->tombstones = 0;
+    for (int i = 0; i < log->index.size(); ++i) {
+        const bool dead = log->index[i].flags & Deleted;
+        values[i] = dead ? 0 : 1;
+        incoming[i] = dead || (log->index[i].flags & FromMe) ? 0 : 1;
+        log->tombstones += dead;
+    }
+    log->live.build(values);
+    log->incoming.build(incoming);
+}
+
+void MessageStore::removeOrphans(Log* log)
+{
+    // 上次运行中删不掉或整理中途退出留下的文件，索引已不再引用
+    QSet<QString> referenced{ segmentPath(log, log->activeSegment) };
+    for (const IndexEntry& entry : std::as_const(log->index)) {
+        referenced.insert(recordPath(log, entry));
+    }
+    const QStringList files = QDir(log->dir).entryList({ "seg-*" }, QDir::Files);
+    for (const QString& name : files) {
+        const QString path = log->dir + "/" + name;
+        if (!referenced.contains(path))
+            QFile::remove(path);
+    }
+}
+
+bool MessageStore::removeFile(const QString& path)
+{
+    if (!QFile::exists(path) || QFile::remove(path))
+        return true;
+    // Windows 上仍被映射的文件（界面持有的 CompactMessageList 行）删不掉，映射释放后再删
+    if (!m_pendingRemovals.contains(path))
+        m_pendingRemovals.append(path);
+    return false;
+}
+
+void MessageStore::retryRemovals()
+{
+    for (auto it = m_pendingRemovals.begin(); it != m_pendingRemovals.end();) {
+        if (!QFile::exists(*it) || QFile::remove(*it))
+            it = m_pendingRemovals.erase(it);
+        else
+            ++it;
+    }
+}
+
+int MessageStore::physicalIndex(const Log* log, int index) const
+{
+    return log->live.find(index);
+}
+
+bool MessageStore::compressSegment(const QString& sourcePath, QVector<IndexEntry>& entries, QByteArray& blocks)
+{
+    QFile source(sourcePath);
+    if (!source.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray raw = source.readAll();
+    source.close();
+
+    // 按条目顺序把记录打包成块：块头为记录数和 count + 1 个偏移，其后是原样的记录
+    int i = 0;
+    while (i < entries.size()) {
+        int blockEnd = i;
+        qint64 rawSize = 0;
+        while (blockEnd < entries.size() && blockEnd - i < BLOCK_MAX_RECORDS
+                && (blockEnd == i || rawSize + entries[blockEnd].length <= BLOCK_TARGET_SIZE)) {
+            rawSize += entries[blockEnd].length;
+            ++blockEnd;
+        }
+
+        const quint32 count = quint32(blockEnd - i);
+        QVector<quint32> table;
+        table.reserve(count + 2);
+        table.push_back(count);
+        QByteArray records;
+        records.reserve(rawSize);
+        const quint32 headerSize = quint32((count + 2) * sizeof(quint32));
+        for (int j = i; j < blockEnd; ++j) {
+            const IndexEntry& entry = entries[j];
+            if (qint64(entry.offset) + entry.length > raw.size())
+                return false;
+            table.push_back(headerSize + quint32(records.size()));
+            records.append(raw.constData() + entry.offset, entry.length);
+        }
+        table.push_back(headerSize + quint32(records.size()));
+
+        QByteArray block(reinterpret_cast<const char*>(table.constData()), headerSize);
+        block += records;
+        const QByteArray packed = qCompress(block);
+
+        const quint32 blockOffset = quint32(blocks.size());
+        for (int j = i; j < blockEnd; ++j) {
+            IndexEntry& entry = entries[j];
+            entry.offset = blockOffset;
+            entry.length = quint32(packed.size());
+            entry.flags = (entry.flags & (0xFF | Deleted)) | Compressed | (quint32(j - i) << 16);
+        }
+        blocks += packed;
+        i = blockEnd;
+    }
+
+    return true;
+}
+
+MappedSegmentPtr MessageStore::mapSegment(Log* log, const IndexEntry& entry)
+{
+    // 当前可写段还在增长，压缩块需要解压，都不映射
+    if (entry.flags & Compressed || (entry.segment >= log->activeSegment && !(entry.flags & Compacted)))
+        return {};
+    const quint64 key = (quint64(entry.segment) << 1) | (entry.flags & Compacted ? 1 : 0);
+    if (const MappedSegmentPtr mapping = log->maps.value(key))
+        return mapping;
+    auto mapping = QSharedPointer<MappedSegment>::create(recordPath(log, entry));
+    if (!mapping->isValid())
+        return {};
+    log->maps.insert(key, mapping);
+    return mapping;
+}
+
+void MessageStore::unmapSegment(Log* log, quint32 segment)
+{
+    log->maps.remove(quint64(segment) << 1);
+    log->maps.remove((quint64(segment) << 1) | 1);
+}
+
+QByteArray MessageStore::readBlock(const Log* log, const IndexEntry& entry)
+{
+    const QString key = QString("%1#%2#%3").arg(log->dir).arg(entry.segment).arg(entry.offset);
+    if (const QByteArray* cached = m_blockCache.object(key))
+        return *cached;
+
+    QFile file(blockPath(log, entry.segment));
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(entry.offset)) {
+        qWarning() << "MessageStore: failed to read cold block" << file.fileName();
+        return QByteArray();
+    }
+    const QByteArray block = qUncompress(file.read(entry.length));
+    m_blockCache.insert(key, new QByteArray(block), qMax<qint64>(1, block.size() / 1024));
+    return block;
+}
+
+QString MessageStore::segmentPath(const Log* log, quint32 segment) const
+{
+    return QString("%1/seg-%2.log").arg(log->dir).arg(segment, 8, 10, QChar('0'));
+}
+
+QString MessageStore::compactedPath(const Log* log, quint32 segment) const
+{
+    return QString("%1/seg-%2.c").arg(log->dir).arg(segment, 8, 10, QChar('0'));
+}
+
+QString MessageStore::blockPath(const Log* log, quint32 segment) const
+{
+    return QString("%1/seg-%2.z").arg(log->dir).arg(segment, 8, 10, QChar('0'));
+}
+
+QString MessageStore::recordPath(const Log* log, const IndexEntry& entry) const
+{
+    if (entry.flags & Compressed)
+        return blockPath(log, entry.segment);
+    if (entry.flags & Compacted)
+        return compactedPath(log, entry.segment);
+    return segmentPath(log, entry.segment);
+}
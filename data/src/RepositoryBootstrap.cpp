@@ -0,0 +1,54 @@
+#include "RepositoryBootstrap.h"
+#include "StringPool.h"
+#include "UserRepository.h"
+#include "GroupRepository.h"
+#include "MessageRepository.h"
+#include "SendJournal.h"
+#include <QPixmapCache>
+
+RepositoryBootstrap::RepositoryBootstrap(QObject* parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(2);
+    m_users.start();
+    m_groups.start();
+    m_messages.start();
+}
+
+RepositoryBootstrap::~RepositoryBootstrap()
+{
+    m_pool.waitForDone();
+}
+
+RepositoryBootstrap& RepositoryBootstrap::instance()
+{
+    static RepositoryBootstrap bootstrap;
+    return bootstrap;
+}
+
+void RepositoryBootstrap::start()
+{
+    if (m_started)
+        return;
+    m_started = true;
+    // QPixmapCache 只能在界面线程使用
+    QPixmapCache::setCacheLimit(20480);
+
+    m_pool.start([this] {
+        StringPool::instance();
+        UserRepository::instance();
+        m_users.finish();
+    });
+    m_pool.start([this] {
+        StringPool::instance();
+        GroupRepository::instance();
+        m_groups.finish();
+        // 用户与群都就绪后再构造消息仓库
+        m_users.future().waitForFinished();
+        MessageRepository::instance();
+        // 上次崩溃前已落盘、未入库的发送先重放，再开始接收新的发送
+        SendJournal::instance().recover();
+        SendJournal::instance().start();
+        m_messages.finish();
+    });
+}
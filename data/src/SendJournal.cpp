@@ -0,0 +1,287 @@
+#include "SendJournal.h"
+#include "MessageStore.h"
+#include "MessageRepository.h"
+#include "FileSync.h"
+#include "DataLocation.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDeadlineTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QSet>
+#include <QtEndian>
+#include <QDebug>
+#include <limits>
+
+namespace {
+    QString journalPath()
+    {
+        return dataLocation() + "/messages/send.wal";
+    }
+
+    // 按会话分组后写入仓库，与入库流水线的持久化、索引、通知三步相同
+    void persistEntries(const QVector<SendJournal::Entry>& entries)
+    {
+        // 直接写入日志条目里的记录，不再重新编码
+        EncodedBatches batches;
+        for (const SendJournal::Entry& entry : entries) {
+            batches[entry.conversationId].push_back({ entry.message, entry.record });
+        }
+        auto& repo = MessageRepository::instance();
+        const auto stored = repo.persist(batches);
+        if (stored.isEmpty())
+            return;
+        repo.indexMessages(stored);
+        repo.notifyChanged(QSet<QString>(stored.keyBegin(), stored.keyEnd()));
+    }
+
+    // 去重过滤器只记得每个会话最近的一批 id，也不含已删除的消息；重放时直接到存储中核对
+    QVector<SendJournal::Entry> unappliedEntries(const QVector<SendJournal::Entry>& entries)
+    {
+        struct Pending {
+            QSet<quint64> ids;
+            qint64 sinceMs = std::numeric_limits<qint64>::max();
+        };
+        QHash<QString, Pending> byConversation;
+        for (const SendJournal::Entry& entry : entries) {
+            Pending& pending = byConversation[entry.conversationId];
+            pending.ids.insert(entry.message->getMessageId());
+            pending.sinceMs = qMin(pending.sinceMs, entry.message->getTimestamp().toMSecsSinceEpoch());
+        }
+        auto& repo = MessageRepository::instance();
+        QHash<QString, QSet<quint64>> stored;
+        for (auto it = byConversation.cbegin(); it != byConversation.cend(); ++it) {
+            stored.insert(it.key(), repo.storedMessageIds(it.key(), it->ids, it->sinceMs));
+        }
+        QVector<SendJournal::Entry> result;
+        for (const SendJournal::Entry& entry : entries) {
+            if (!stored.value(entry.conversationId).contains(entry.message->getMessageId()))
+                result.push_back(entry);
+        }
+        return result;
+    }
+}
+
+SendJournal& SendJournal::instance()
+{
+    static SendJournal journal(journalPath(), persistEntries,
+                               [] { return MessageRepository::instance().syncStorage(); }, unappliedEntries);
+    return journal;
+}
+
+SendJournal::SendJournal(const QString& path, Sink sink, Checkpoint checkpoint, ReplayFilter replayFilter,
+                         QObject* parent)
+    : QObject(parent)
+    , m_path(path)
+    , m_sink(std::move(sink))
+    , m_checkpoint(std::move(checkpoint))
+    , m_replayFilter(std::move(replayFilter))
+    , m_file(path)
+{
+    m_pool.setMaxThreadCount(1);
+    m_pool.setExpiryTimeout(-1);
+    // 可能在启动线程上构造；退出前把剩余条目写完
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &SendJournal::shutdown);
+    }
+}
+
+SendJournal::~SendJournal()
+{
+    shutdown();
+}
+
+bool SendJournal::openFile()
+{
+    if (m_file.isOpen())
+        return true;
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "SendJournal: failed to open" << m_path << m_file.errorString();
+        return false;
+    }
+    m_file.seek(m_file.size());
+    return true;
+}
+
+int SendJournal::recover()
+{
+    if (!openFile())
+        return 0;
+    m_file.seek(0);
+    const QByteArray data = m_file.readAll();
+
+    QVector<Entry> entries;
+    qint64 pos = 0;
+    while (pos + FRAME_HEADER_SIZE <= data.size()) {
+        const char* frame = data.constData() + pos;
+        const quint32 magic = qFromLittleEndian<quint32>(frame);
+        const quint32 length = qFromLittleEndian<quint32>(frame + 4);
+        const quint16 checksum = qFromLittleEndian<quint16>(frame + 8);
+        if (magic != FRAME_MAGIC || length > quint64(data.size() - pos - FRAME_HEADER_SIZE))
+            break;
+        const QByteArray payload = QByteArray::fromRawData(frame + FRAME_HEADER_SIZE, int(length));
+        if (qChecksum(payload) != checksum)
+            break;
+
+        QDataStream in(payload);
+        in.setVersion(QDataStream::Qt_6_0);
+        QString conversationId;
+        QByteArray record;
+        in >> conversationId >> record;
+        const QSharedPointer<ChatMessage> message = MessageStore::decode(record.constData(), record.size());
+        if (in.status() != QDataStream::Ok || conversationId.isEmpty() || !message)
+            break;
+        entries.push_back({ conversationId, message, record });
+        pos += FRAME_HEADER_SIZE + length;
+    }
+    // 崩溃时写了一半的条目尚未 fsync 完成，从未报告过已落盘，直接截掉
+    if (pos < data.size()) {
+        qWarning() << "SendJournal: dropping" << data.size() - pos << "bytes of torn tail in" << m_path;
+        m_file.resize(pos);
+    }
+    m_file.seek(pos);
+
+    if (entries.isEmpty())
+        return 0;
+    const QVector<Entry> unapplied = m_replayFilter ? m_replayFilter(entries) : entries;
+    qInfo() << "SendJournal:" << entries.size() << "entries in journal, replaying" << unapplied.size();
+    if (m_sink && !unapplied.isEmpty())
+        m_sink(unapplied);
+    checkpoint();
+    return int(unapplied.size());
+}
+
+bool SendJournal::start()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_started || m_stopping)
+        return m_started;
+    if (!openFile())
+        return false;
+    m_started = true;
+    m_pool.start([this] { runWriter(); });
+    return true;
+}
+
+bool SendJournal::append(const QString& conversationId, QSharedPointer<ChatMessage> message, QByteArray record)
+{
+    // 在调用线程编码：图片消息的编码只应发生在持有它的线程，也不占用写线程和锁
+    if (record.isEmpty())
+        record = MessageStore::encode(*message, 0);
+    QMutexLocker locker(&m_mutex);
+    if (m_stopping)
+        return false;
+    m_pending.push_back({ conversationId, std::move(message), std::move(record) });
+    // 写线程只在队列由空变为非空、或攒满一批时需要唤醒
+    if (m_pending.size() == 1 || m_pending.size() >= GROUP_MAX_ENTRIES)
+        m_wake.wakeOne();
+    return true;
+}
+
+void SendJournal::shutdown()
+{
+    QVector<Entry> orphaned;
+    bool started = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_stopping)
+            return;
+        m_stopping = true;
+        started = m_started;
+        if (!m_started)
+            orphaned.swap(m_pending);
+        m_wake.wakeAll();
+    }
+    m_pool.waitForDone();
+    // 仓库尚未就绪就退出：只落盘，下次启动时由 recover 写入仓库
+    if (!orphaned.isEmpty() && openFile())
+        writeFrames(orphaned);
+    // 写线程已把全部条目交给 sink，检查点后下次启动不必重放；未启动时日志里可能还有未重放的条目，不能清空
+    if (started && m_file.size() > 0)
+        checkpoint();
+}
+
+void SendJournal::runWriter()
+{
+    while (true) {
+        QVector<Entry> batch;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pending.isEmpty() && !m_stopping)
+                m_wake.wait(&m_mutex);
+            if (m_pending.isEmpty())
+                return;
+            // 成组提交：第一条到达后再等一个短窗口，同一时段内的发送合并为一次 fsync
+            QDeadlineTimer window(GROUP_COMMIT_MS);
+            while (m_pending.size() < GROUP_MAX_ENTRIES && !m_stopping) {
+                if (!m_wake.wait(&m_mutex, window))
+                    break;
+            }
+            batch.swap(m_pending);
+        }
+        commit(batch);
+    }
+}
+
+bool SendJournal::writeFrames(const QVector<Entry>& batch)
+{
+    QByteArray frames;
+    for (const Entry& entry : batch) {
+        frames += encodeFrame(entry);
+    }
+    const qint64 before = m_file.pos();
+    if (m_file.write(frames) == frames.size() && syncToDisk(m_file))
+        return true;
+    qWarning() << "SendJournal: failed to write" << m_path << m_file.errorString();
+    // 截掉可能只写了一半的条目，之后的提交仍能被完整重放
+    m_file.resize(before);
+    m_file.seek(before);
+    return false;
+}
+
+void SendJournal::commit(const QVector<Entry>& batch)
+{
+    const bool durable = writeFrames(batch);
+    m_commits++;
+    m_entries += batch.size();
+    if (durable) {
+        QVector<quint64> ids;
+        ids.reserve(batch.size());
+        for (const Entry& entry : batch) {
+            ids.push_back(entry.message->getMessageId());
+        }
+        emit committed(ids);
+    }
+    // 日志写失败时消息照常入库，只是失去崩溃保护
+    if (m_sink)
+        m_sink(batch);
+    if (m_file.size() >= CHECKPOINT_BYTES)
+        checkpoint();
+}
+
+void SendJournal::checkpoint()
+{
+    // 日志中的条目都已交给 sink，仓库落盘后即可清空
+    if (!m_checkpoint || !m_checkpoint())
+        return;
+    if (!m_file.resize(0))
+        qWarning() << "SendJournal: failed to truncate" << m_path << m_file.errorString();
+    m_file.seek(m_file.size());
+}
+
+QByteArray SendJournal::encodeFrame(const Entry& entry)
+{
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << entry.conversationId << entry.record;
+    }
+    QByteArray frame(FRAME_HEADER_SIZE, Qt::Uninitialized);
+    qToLittleEndian<quint32>(FRAME_MAGIC, frame.data());
+    qToLittleEndian<quint32>(quint32(payload.size()), frame.data() + 4);
+    qToLittleEndian<quint16>(qChecksum(payload), frame.data() + 8);
+    return frame + payload;
+}
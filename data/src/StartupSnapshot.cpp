@@ -0,0 +1,146 @@
+#include "StartupSnapshot.h"
+#include "DataLocation.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+namespace {
+    constexpr int MAX_AVATAR_SIDE = 256;   // 载入时的尺寸上限，防止损坏的文件触发超大分配
+
+    void writeAvatar(QDataStream& out, const QImage& avatar)
+    {
+        if (avatar.isNull()) {
+            out << qint32(0) << qint32(0);
+            return;
+        }
+        const QImage image = avatar.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        out << qint32(image.width()) << qint32(image.height());
+        // 逐行写出，跳过行尾的对齐填充
+        const int lineBytes = image.width() * 4;
+        for (int y = 0; y < image.height(); ++y) {
+            out.writeRawData(reinterpret_cast<const char*>(image.constScanLine(y)), lineBytes);
+        }
+    }
+
+    QImage readAvatar(QDataStream& in)
+    {
+        qint32 width = 0;
+        qint32 height = 0;
+        in >> width >> height;
+        if (width <= 0 || height <= 0 || width > MAX_AVATAR_SIDE || height > MAX_AVATAR_SIDE) {
+            if (width != 0 || height != 0)
+                in.setStatus(QDataStream::ReadCorruptData);
+            return QImage();
+        }
+        QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+        const int lineBytes = width * 4;
+        for (int y = 0; y < height; ++y) {
+            if (in.readRawData(reinterpret_cast<char*>(image.scanLine(y)), lineBytes) != lineBytes) {
+                in.setStatus(QDataStream::ReadPastEnd);
+                return QImage();
+            }
+        }
+        return image;
+    }
+}
+
+QString StartupSnapshot::defaultPath()
+{
+    return dataLocation() + "/startup.snap";
+}
+
+const StartupSnapshot& StartupSnapshot::atLaunch()
+{
+    static const StartupSnapshot snapshot = [] {
+        StartupSnapshot loaded;
+        // 开发调试：NETHERLINK_NO_SNAPSHOT 时忽略快照，按首次启动的路径从各仓库建列表
+        if (!qEnvironmentVariableIsSet("NETHERLINK_NO_SNAPSHOT"))
+            loaded.load(defaultPath());
+        return loaded;
+    }();
+    return snapshot;
+}
+
+bool StartupSnapshot::load(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    // 快照只有几百 KB，一次读入后在内存中解析
+    QDataStream in(file.readAll());
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (magic != FILE_MAGIC || version != FILE_VERSION)
+        return false;
+
+    QVector<ConversationRow> loadedConversations;
+    quint32 conversationCount = 0;
+    in >> conversationCount;
+    loadedConversations.reserve(qMin<quint32>(conversationCount, 4096));
+    for (quint32 i = 0; i < conversationCount && in.status() == QDataStream::Ok; ++i) {
+        ConversationRow row;
+        in >> row.id >> row.name >> row.preview >> row.lastTimestamp >> row.unreadCount
+           >> row.doNotDisturb >> row.isGroup >> row.avatarPath;
+        row.avatar = readAvatar(in);
+        loadedConversations.push_back(std::move(row));
+    }
+
+    QVector<FriendRow> loadedFriends;
+    quint32 friendCount = 0;
+    in >> friendCount;
+    loadedFriends.reserve(qMin<quint32>(friendCount, 4096));
+    for (quint32 i = 0; i < friendCount && in.status() == QDataStream::Ok; ++i) {
+        FriendRow row;
+        qint32 status = 0;
+        in >> row.user.id >> row.user.nick >> row.user.remark >> row.user.avatarPath
+           >> status >> row.user.signature >> row.user.isDnd;
+        row.user.status = static_cast<UserStatus>(status);
+        row.avatar = readAvatar(in);
+        loadedFriends.push_back(std::move(row));
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "StartupSnapshot: corrupted snapshot" << path;
+        return false;
+    }
+
+    conversations = std::move(loadedConversations);
+    friends = std::move(loadedFriends);
+    return true;
+}
+
+bool StartupSnapshot::save(const QString& path) const
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream out(&buffer);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << FILE_MAGIC << FILE_VERSION;
+
+    out << quint32(conversations.size());
+    for (const ConversationRow& row : conversations) {
+        out << row.id << row.name << row.preview << row.lastTimestamp << row.unreadCount
+            << row.doNotDisturb << row.isGroup << row.avatarPath;
+        writeAvatar(out, row.avatar);
+    }
+    out << quint32(friends.size());
+    for (const FriendRow& row : friends) {
+        out << row.user.id << row.user.nick << row.user.remark << row.user.avatarPath
+            << qint32(row.user.status) << row.user.signature << row.user.isDnd;
+        writeAvatar(out, row.avatar);
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    const bool ok = file.open(QIODevice::WriteOnly)
+            && file.write(buffer.data()) == buffer.size()
+            && file.commit();
+    if (!ok)
+        qWarning() << "StartupSnapshot: failed to save" << path;
+    return ok;
+}
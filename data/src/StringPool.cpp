@@ -0,0 +1,58 @@
+#include "StringPool.h"
+
+StringPool::StringPool()
+{
+    // 句柄 0 固定对应空串
+    m_strings.push_back(QString());
+    m_index.insert(QString(), 0);
+}
+
+StringPool& StringPool::instance()
+{
+    static StringPool pool;
+    return pool;
+}
+
+StringHandle StringPool::intern(const QString& text)
+{
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_index.constFind(text);
+        if (it != m_index.constEnd())
+            return it.value();
+    }
+    QWriteLocker locker(&m_lock);
+    // 取写锁期间可能已被其他线程插入
+    auto it = m_index.constFind(text);
+    if (it != m_index.constEnd())
+        return it.value();
+    const StringHandle handle = StringHandle(m_strings.size());
+    m_strings.push_back(text);
+    m_index.insert(text, handle);
+    return handle;
+}
+
+StringHandle StringPool::find(const QString& text) const
+{
+    QReadLocker locker(&m_lock);
+    return m_index.value(text, 0);
+}
+
+QString StringPool::string(StringHandle handle) const
+{
+    QReadLocker locker(&m_lock);
+    if (handle >= StringHandle(m_strings.size()))
+        return QString();
+    return m_strings[handle];
+}
+
+QString StringPool::shared(const QString& text)
+{
+    return string(intern(text));
+}
+
+int StringPool::size() const
+{
+    QReadLocker locker(&m_lock);
+    return int(m_strings.size());
+}
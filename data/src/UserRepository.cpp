@@ -1,11 +1,12 @@
 #include "UserRepository.h"
 #include <QPainter>
+#include <QCoreApplication>
 #include <QPainterPath>
+#include <algorithm>
 
 UserRepository::UserRepository(QObject* parent)
     : QObject(parent)
 {
-    QPixmapCache::setCacheLimit(20480);
     QVector<User> users = {
             {"u001", "momo",   "", ":/resources/avatar/1.jpg",   Online,  "我是好momo"},
             {"u002", "blazer",     "", ":/resources/avatar/0.jpg",     Mining, "不掉烈焰棒"},
@@ -19,9 +20,15 @@ UserRepository::UserRepository(QObject* parent)
             {"u010", "BombardinoCrocodilo",   "", ":/resources/avatar/9.jpg",   Flying,  "已塌房"},
     };
 
-    for (const User& user : users) {
-        userMap.insert(user.id, user);
+    auto& pool = StringPool::instance();
+    for (User user : users) {
+        const StringHandle handle = pool.intern(user.id);
+        user.id = pool.string(handle);
+        userMap.insert(handle, user);
     }
+    // 可能在启动线程上构造，归属界面线程
+    if (QCoreApplication::instance())
+        moveToThread(QCoreApplication::instance()->thread());
 }
 
 UserRepository& UserRepository::instance() {
@@ -30,49 +37,74 @@ UserRepository& UserRepository::instance() {
 }
 
 User UserRepository::getUser(const QString& userID) {
+    return getUser(StringPool::instance().find(userID));
+}
+
+User UserRepository::getUser(StringHandle userID) {
     QMutexLocker locker(&mutex);
     return userMap.value(userID, User());
 }
 
 QVector<User> UserRepository::getAllUser() {
     QMutexLocker locker(&mutex);
-    return QVector<User>::fromList(userMap.values());
+    QVector<User> users = QVector<User>::fromList(userMap.values());
+    // 哈希表无序，按 id 排序保持原先的顺序
+    std::sort(users.begin(), users.end(), [](const User& a, const User& b) { return a.id < b.id; });
+    return users;
 }
 
 void UserRepository::insertUser(const User& user) {
+    auto& pool = StringPool::instance();
+    const StringHandle handle = pool.intern(user.id);
+    User stored = user;
+    stored.id = pool.string(handle);
     QMutexLocker locker(&mutex);
-    userMap[user.id] = user;
-    cacheAvatar(user.id);
+    userMap[handle] = stored;
 }
 
 void UserRepository::removeUser(const QString& userID) {
+    const StringHandle handle = StringPool::instance().find(userID);
     QMutexLocker locker(&mutex);
-    userMap.remove(userID);
+    userMap.remove(handle);
+}
+
+QString UserRepository::getName(const QString& userID) {
+    return getName(StringPool::instance().find(userID));
 }
 
-QString UserRepository::getName(QString userID) {
+QString UserRepository::getName(StringHandle userID) {
+    QMutexLocker locker(&mutex);
     return userMap.value(userID, User()).nick;
 }
 
-QPixmap UserRepository::getAvatar(const QString &userID) {
-    const QString key = QString("avatar_%1").arg(userID);
-    QPixmap pixmap;
-    if (QPixmapCache::find(key, &pixmap)) {
-        return pixmap;
+QPixmap UserRepository::getAvatar(const QString& userID) {
+    return getAvatar(StringPool::instance().find(userID));
+}
+
+QPixmap UserRepository::getAvatar(StringHandle userID) {
+    User user;
+    {
+        QMutexLocker locker(&mutex);
+        auto it = userMap.constFind(userID);
+        if (it == userMap.constEnd())
+            return QPixmap();
+        user = it.value();
     }
-    // 未缓存则生成并缓存一次
-    QMutexLocker locker(&mutex);
-    if (userMap.contains(userID)) {
-        cacheAvatar(userID);
-        QPixmapCache::find(key, &pixmap);
+    // 键中带上头像路径，用户更换头像后自然生成新的缓存项
+    const QString key = QString("avatar_%1_%2").arg(user.id, user.avatarPath);
+    QPixmap pixmap;
+    if (!QPixmapCache::find(key, &pixmap)) {
+        // 未缓存则生成并缓存一次
+        pixmap = renderAvatar(user.avatarPath);
+        if (!pixmap.isNull())
+            QPixmapCache::insert(key, pixmap);
     }
     return pixmap;
 }
 
-void UserRepository::cacheAvatar(const QString &userID) {
-    const QString key = QString("avatar_%1").arg(userID);
-    QPixmap original(userMap[userID].avatarPath);
-    if (original.isNull()) return;
+QPixmap UserRepository::renderAvatar(const QString& avatarPath) const {
+    QPixmap original(avatarPath);
+    if (original.isNull()) return QPixmap();
 
     QPixmap rounded(avatarSize, avatarSize);
     rounded.fill(Qt::transparent);
@@ -85,8 +117,7 @@ void UserRepository::cacheAvatar(const QString &userID) {
     painter.drawPixmap(0, 0, original.scaled(avatarSize, avatarSize,
                                              Qt::KeepAspectRatioByExpanding,
                                              Qt::SmoothTransformation));
-
-    QPixmapCache::insert(key, rounded);
+    return rounded;
 }
 
 QString statusText(UserStatus userStatus) {
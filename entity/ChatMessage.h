@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QDateTime>
+#include <QImage>
 #include <QPixmap>
 #include <memory>
 
@@ -19,6 +20,13 @@ enum class GroupRole {
     Member      // 普通成员
 };
 
+// 本人发出的消息的投递状态，收到的和从存储读出的消息都视为 Acked
+enum class DeliveryState : quint8 {
+    Pending,    // 已显示，尚未写入发送日志
+    Durable,    // 发送日志已落盘
+    Acked       // 服务器已确认收到；没有连接服务器时落盘即为最终状态
+};
+
 class ChatMessage {
 public:
     ChatMessage(bool isFromMe, const QString& senderId, bool isGroupChat = false, 
@@ -38,6 +46,18 @@ public:
     bool getIsSelected() const { return isSelected; }
     void setSelected(bool selected) { isSelected = selected; }
 
+    // 会话内序号，由 MessageRepository 入库时分配，未入库为 -1
+    qint64 getSeq() const { return seq; }
+    void setSeq(qint64 newSeq) { seq = newSeq; }
+
+    // 全局唯一的消息 id，由发送方生成（见 MessageId），重发与重放时保持不变；0 表示尚未分配
+    quint64 getMessageId() const { return messageId; }
+    void setMessageId(quint64 id) { messageId = id; }
+
+    // 投递状态，只在内存中维护，不写入存储
+    DeliveryState getDeliveryState() const { return deliveryState; }
+    void setDeliveryState(DeliveryState state) { deliveryState = state; }
+
     // 群聊相关
     bool isInGroupChat() const { return isGroupChat; }
     QString getSenderName() const { return senderName; }
@@ -48,7 +68,10 @@ protected:
     QString senderId;
     QDateTime timestamp;
     bool isSelected;
-    
+    qint64 seq = -1;
+    quint64 messageId = 0;
+    DeliveryState deliveryState = DeliveryState::Acked;
+
     // 群聊相关属性
     bool isGroupChat;
     QString senderName;
@@ -70,19 +93,20 @@ private:
     QString text;
 };
 
+// 图片以 QImage 保存，可以在任意线程解码与编码；需要 QPixmap 时由界面线程转换
 class ImageMessage : public ChatMessage {
 public:
-    ImageMessage(const QPixmap& image, bool isFromMe, const QString& senderId,
+    ImageMessage(const QImage& image, bool isFromMe, const QString& senderId,
                 bool isGroupChat = false, const QString& senderName = QString(),
                 GroupRole role = GroupRole::Member)
         : ChatMessage(isFromMe, senderId, isGroupChat, senderName, role), image(image) {}
     
     QString getContent() const override { return "[图片]"; }
     MessageType getType() const override { return MessageType::Image; }
-    QPixmap getImage() const { return image; }
+    QImage getImage() const { return image; }
 
 private:
-    QPixmap image;
+    QImage image;
 };
 
 #endif // CHATMESSAGE_H 
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <QString>
 #include <QVector>
+#include "StringHandle.h"
 
 struct Group {
     QString groupId;
@@ -10,7 +11,7 @@ struct Group {
     QString ownerId;
     QString groupAvatarPath;
     bool isDnd = false;
-    QVector<QString> adminsID;
+    QVector<StringHandle> adminsID;    // 驻留后的用户 id
     QString remark;
-    QVector<QString> membersID;
+    QVector<StringHandle> membersID;   // 驻留后的用户 id
 };
\ No newline at end of file
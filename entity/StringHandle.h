@@ -0,0 +1,6 @@
+#pragma once
+
+#include <QtGlobal>
+
+// 驻留字符串的句柄，0 保留给空串；由 data 层的 StringPool 分配与解析
+using StringHandle = quint32;
@@ -1,10 +1,20 @@
 #include <QApplication>
 #include "MainWindow.h"
+#include "NetworkService.h"
+#include "RepositoryBootstrap.h"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // 仓库在后台按依赖顺序构造，首帧不等待
+    RepositoryBootstrap::instance().start();
     MainWindow w;
+    // 退出时按当时的会话列表与好友列表保存启动快照
+    QObject::connect(&a, &QCoreApplication::aboutToQuit, &w, [&w] { w.saveStartupSnapshot(); });
     w.show();
+    // 收到的消息要写入消息仓库，等它就绪后再连接
+    RepositoryBootstrap::instance().messagesReady().then(&a, [] {
+        NetworkService::instance().startFromEnvironment();
+    });
     return a.exec();
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QTimer>
+#include "ChatMessage.h"
+#include "SyncEngine.h"
+
+class QLocalServer;
+class QTcpServer;
+
+// 本地模拟服务器，运行在独立线程，用于端到端地压测收消息链路
+// 按设定速率向每个已连接客户端推送随机会话的文本消息，每个节拍的消息合成一批；
+// 收到客户端发出的消息时以会话对方的身份回一条。
+class MockServer : public QObject {
+    Q_OBJECT
+public:
+    struct Member {
+        QString id;
+        QString name;
+        GroupRole role = GroupRole::Member;
+    };
+    // 会话与可用的发送者；单聊只有对方一个成员
+    struct Conversation {
+        QString id;
+        bool group = false;
+        QVector<Member> members;
+    };
+
+    static constexpr int TICK_MS = 10;
+    static constexpr int MAX_PENDING_BATCHES = 64;  // 客户端积压超过此数时暂停推送
+
+    // address 格式同 SocketTransport；conversations 须在界面线程从仓库取好再传入
+    MockServer(const QString& address, const QVector<Conversation>& conversations,
+               int messagesPerSecond, QObject* parent = nullptr);
+
+public slots:
+    void start();
+    void stop();
+    void setRate(int messagesPerSecond);
+
+private:
+    struct Client {
+        Transport* transport;
+        ReliableChannel* channel;
+    };
+
+    void addClient(Transport* transport);
+    void tick();
+    void onClientPayload(Client* client, const QByteArray& payload);
+    SyncEngine::WireMessage makeMessage(const Conversation& conversation, const QString& text) const;
+
+    QString m_address;
+    QVector<Conversation> m_conversations;
+    int m_rate;
+    double m_carry = 0;     // 不足一条的速率余量
+    QLocalServer* m_localServer = nullptr;
+    QTcpServer* m_tcpServer = nullptr;
+    QTimer* m_tickTimer = nullptr;
+    QVector<Client*> m_clients;
+};
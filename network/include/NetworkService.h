@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include "SyncEngine.h"
+#include "MockServer.h"
+
+// 网络模块的入口，界面线程使用
+// 同步引擎与模拟服务器各自运行在独立线程，界面只经排队信号与它们交互。
+// 环境变量（开发调试用）：
+//   NETHERLINK_SERVER     要连接的地址，如 "local:netherlink" 或 "tcp:127.0.0.1:5270"
+//   NETHERLINK_MOCK_RATE  不为空时在本进程内启动模拟服务器，值为每秒推送的消息数
+class NetworkService : public QObject {
+    Q_OBJECT
+public:
+    static constexpr const char* MOCK_ADDRESS = "local:netherlink-mock";
+
+    static NetworkService& instance();
+
+    // 按环境变量启动，未配置时什么也不做
+    void startFromEnvironment();
+    // 连接到 address 并开始同步
+    void connectTo(const QString& address);
+    // 在本进程内启动模拟服务器，会话取自用户与群仓库
+    void startMockServer(const QString& address, int messagesPerSecond);
+    // 停止所有网络线程，程序退出前调用
+    void shutdown();
+
+    bool isConnected() const { return m_connected; }
+    // 是否已启动同步；只有启动后本地发出的消息才会收到服务器确认
+    bool hasTransport() const { return m_engine != nullptr; }
+
+public slots:
+    // 把本地发出的消息推给服务器，record 为 MessageStore::encode 格式的记录
+    void sendRecord(const QString& conversationId, const QByteArray& record, quint64 messageId);
+
+signals:
+    void connectionChanged(bool connected);
+    // 本地发出的消息已被服务器确认
+    void messagesAcked(const QVector<quint64>& messageIds);
+
+private:
+    explicit NetworkService(QObject* parent = nullptr);
+    ~NetworkService() override;
+    Q_DISABLE_COPY(NetworkService)
+
+    QThread m_syncThread;
+    QThread m_serverThread;
+    SyncEngine* m_engine = nullptr;   // 属于 m_syncThread
+    MockServer* m_server = nullptr;   // 属于 m_serverThread
+    bool m_connected = false;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QQueue>
+#include <QTimer>
+#include "Transport.h"
+
+// 在 Transport 之上提供有序、可靠的消息投递（回退 N 帧）
+// 数据帧：类型 + 64 位序号 + 负载；确认帧：类型 + 已按序收到的最大序号（累计确认）。
+// 发送端最多有 WINDOW_SIZE 帧未确认，超时后从最早未确认的一帧起全部重发；
+// 接收端只接受下一个期望的序号，重复或越序的帧丢弃，同一轮读到的帧合并成一次确认。
+// 连接重建后双方序号归零，未确认的帧重新排队，投递语义为至少一次。
+class ReliableChannel : public QObject {
+    Q_OBJECT
+public:
+    enum FrameType : quint8 {
+        Data = 1,
+        Ack  = 2
+    };
+
+    static constexpr int WINDOW_SIZE = 32;          // 未确认帧上限
+    static constexpr int RESEND_TIMEOUT_MS = 500;   // 重发超时
+
+    // transport 由调用方持有
+    explicit ReliableChannel(Transport* transport, QObject* parent = nullptr);
+
+    // 排队发送一份负载
+    void send(const QByteArray& payload);
+
+    int pendingCount() const { return int(m_queue.size() + m_unacked.size()); }
+
+signals:
+    // 按发送顺序交付，每份负载只交付一次
+    void received(const QByteArray& payload);
+    // 对端确认了最早发出的 count 份负载（按 send 的顺序，重连重发不改变顺序）
+    void delivered(int count);
+
+private:
+    struct Outgoing {
+        quint64 seq;
+        QByteArray payload;
+    };
+
+    void onFrame(const QByteArray& frame);
+    void onConnected();
+    void pump();
+    void resend();
+    void sendAck();
+    void transmit(const Outgoing& outgoing);
+
+    Transport* m_transport;
+    QQueue<QByteArray> m_queue;     // 等待进入窗口
+    QQueue<Outgoing> m_unacked;     // 已发出未确认，按序号升序
+    quint64 m_nextSeq = 1;
+    quint64 m_expectedSeq = 1;
+    bool m_ackPending = false;
+    QTimer m_resendTimer;
+};
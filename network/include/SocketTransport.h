@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Transport.h"
+
+class QLocalSocket;
+class QTcpSocket;
+
+// 基于本机套接字的传输：QLocalSocket（命名管道 / Unix 域套接字）或回环 TCP
+// 地址格式："local:<名字>" 或 "tcp:<主机>:<端口>"
+class SocketTransport : public Transport {
+    Q_OBJECT
+public:
+    // 客户端：open() 时按地址发起连接
+    explicit SocketTransport(const QString& address, QObject* parent = nullptr);
+    // 服务端：接管已经建立的连接
+    explicit SocketTransport(QLocalSocket* socket, QObject* parent = nullptr);
+    explicit SocketTransport(QTcpSocket* socket, QObject* parent = nullptr);
+
+    void open() override;
+    void close() override;
+    bool isOpen() const override;
+    bool sendFrame(const QByteArray& payload) override;
+
+private:
+    void attach(QLocalSocket* socket);
+    void attach(QTcpSocket* socket);
+
+    QString m_address;
+    QLocalSocket* m_local = nullptr;
+    QTcpSocket* m_tcp = nullptr;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QTimer>
+#include <QQueue>
+#include "Transport.h"
+#include "ReliableChannel.h"
+
+// 消息同步引擎，运行在网络线程
+// 收：对端推来的消息批次交给 IngestPipeline 解码、去重并写入仓库，界面经 conversationsChanged 刷新。
+// 发：本地发出的消息先进发件箱，攒够一批或等待 BATCH_DELAY_MS 后作为一份负载交给 ReliableChannel。
+// 断线后每隔 RECONNECT_DELAY_MS 重连，未确认的批次在重连后重发；批次被确认后发 messagesAcked。
+class SyncEngine : public QObject {
+    Q_OBJECT
+public:
+    // 线路上的一条消息：会话 id + MessageStore::encode 格式的记录
+    struct WireMessage {
+        QString conversationId;
+        QByteArray record;
+    };
+
+    static constexpr int BATCH_MAX_MESSAGES = 256;
+    static constexpr int BATCH_DELAY_MS = 10;
+    static constexpr int RECONNECT_DELAY_MS = 1000;
+
+    explicit SyncEngine(const QString& address, QObject* parent = nullptr);
+
+    // 批次负载：quint32 条数，其后每条为会话 id 与记录
+    static QByteArray encodeBatch(const QVector<WireMessage>& messages);
+    static QVector<WireMessage> decodeBatch(const QByteArray& payload);
+
+public slots:
+    // 以下槽须在网络线程调用（跨线程时用排队连接）
+    void start();
+    void stop();
+    void send(const QString& conversationId, const QByteArray& record, quint64 messageId);
+
+signals:
+    void connectionChanged(bool connected);
+    void messagesReceived(int count);
+    // 这些本地消息已被对端确认
+    void messagesAcked(const QVector<quint64>& messageIds);
+
+private:
+    void flushOutbox();
+    void onPayload(const QByteArray& payload);
+    void onDelivered(int count);
+
+    QString m_address;
+    Transport* m_transport = nullptr;
+    ReliableChannel* m_channel = nullptr;
+    QTimer* m_batchTimer = nullptr;
+    QTimer* m_reconnectTimer = nullptr;
+    QVector<WireMessage> m_outbox;
+    QVector<quint64> m_outboxIds;           // 与 m_outbox 对应的消息 id
+    QQueue<QVector<quint64>> m_inFlight;    // 已交给通道、等待确认的各批次的消息 id，按发送顺序
+    bool m_running = false;
+};
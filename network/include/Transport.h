@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+// 可替换的传输层：只负责连接与整帧收发，可靠性由上层的 ReliableChannel 负责
+// 帧格式：4 字节小端长度 + 负载
+class Transport : public QObject {
+    Q_OBJECT
+public:
+    static constexpr qint64 MAX_FRAME_SIZE = 16 * 1024 * 1024;  // 超过视为协议错误
+
+    explicit Transport(QObject* parent = nullptr) : QObject(parent) {}
+    ~Transport() override = default;
+
+    virtual void open() = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+    // 发送一帧，未连接时丢弃并返回 false
+    virtual bool sendFrame(const QByteArray& payload) = 0;
+
+signals:
+    void connected();
+    void disconnected();
+    void frameReceived(const QByteArray& payload);
+    void errorOccurred(const QString& message);
+
+protected:
+    // 从设备读出所有完整的帧并逐个发 frameReceived，不完整的尾部留在缓冲区
+    void readFrames(QIODevice* device);
+    static QByteArray encodeFrame(const QByteArray& payload);
+
+    QByteArray m_readBuffer;
+};
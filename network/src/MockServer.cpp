@@ -0,0 +1,156 @@
+#include "MockServer.h"
+#include "SocketTransport.h"
+#include "MessageStore.h"
+#include "MessageId.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QRandomGenerator>
+#include <QDebug>
+#include <utility>
+
+namespace {
+    const QStringList SAMPLE_TEXTS = {
+        "在吗？", "收到", "好的，晚点联系", "今天的会议改到下午三点了",
+        "这个问题我看一下", "哈哈哈哈", "明天见！", "文件已经发你邮箱了",
+        "OK", "周末一起吃饭吗", "辛苦了", "我到了，在门口等你"
+    };
+}
+
+MockServer::MockServer(const QString& address, const QVector<Conversation>& conversations,
+                       int messagesPerSecond, QObject* parent)
+    : QObject(parent)
+    , m_address(address)
+    , m_conversations(conversations)
+    , m_rate(messagesPerSecond)
+{
+}
+
+void MockServer::start()
+{
+    if (m_tickTimer)
+        return;
+
+    if (m_address.startsWith("tcp:")) {
+        const QString target = m_address.mid(4);
+        const quint16 port = quint16(target.mid(target.lastIndexOf(':') + 1).toUInt());
+        m_tcpServer = new QTcpServer(this);
+        connect(m_tcpServer, &QTcpServer::newConnection, this, [this] {
+            while (QTcpSocket* socket = m_tcpServer->nextPendingConnection())
+                addClient(new SocketTransport(socket, this));
+        });
+        // 只监听回环地址
+        if (!m_tcpServer->listen(QHostAddress::LocalHost, port))
+            qWarning() << "MockServer: failed to listen on" << m_address << m_tcpServer->errorString();
+    } else {
+        const QString name = m_address.startsWith("local:") ? m_address.mid(6) : m_address;
+        m_localServer = new QLocalServer(this);
+        connect(m_localServer, &QLocalServer::newConnection, this, [this] {
+            while (QLocalSocket* socket = m_localServer->nextPendingConnection())
+                addClient(new SocketTransport(socket, this));
+        });
+        // 上次异常退出可能残留同名套接字文件
+        QLocalServer::removeServer(name);
+        if (!m_localServer->listen(name))
+            qWarning() << "MockServer: failed to listen on" << m_address << m_localServer->errorString();
+    }
+
+    m_tickTimer = new QTimer(this);
+    m_tickTimer->setInterval(TICK_MS);
+    connect(m_tickTimer, &QTimer::timeout, this, &MockServer::tick);
+    m_tickTimer->start();
+}
+
+void MockServer::stop()
+{
+    if (m_tickTimer)
+        m_tickTimer->stop();
+    // 先断开信号，close() 同步触发的 disconnected 不再回到 m_clients
+    const QVector<Client*> clients = std::exchange(m_clients, {});
+    for (Client* client : clients) {
+        client->transport->disconnect(this);
+        client->transport->close();
+        client->transport->deleteLater();
+        delete client;
+    }
+    if (m_localServer)
+        m_localServer->close();
+    if (m_tcpServer)
+        m_tcpServer->close();
+}
+
+void MockServer::setRate(int messagesPerSecond)
+{
+    m_rate = qMax(0, messagesPerSecond);
+}
+
+void MockServer::addClient(Transport* transport)
+{
+    auto* client = new Client{ transport, new ReliableChannel(transport, transport) };
+    m_clients.push_back(client);
+    connect(client->channel, &ReliableChannel::received, this, [this, client](const QByteArray& payload) {
+        onClientPayload(client, payload);
+    });
+    connect(transport, &Transport::disconnected, this, [this, client] {
+        m_clients.removeOne(client);
+        client->transport->deleteLater();
+        delete client;
+    });
+}
+
+void MockServer::tick()
+{
+    if (m_conversations.isEmpty() || m_clients.isEmpty())
+        return;
+
+    m_carry += m_rate * (TICK_MS / 1000.0);
+    const int count = int(m_carry);
+    m_carry -= count;
+    if (count == 0)
+        return;
+
+    auto* random = QRandomGenerator::global();
+    for (Client* client : std::as_const(m_clients)) {
+        // 简单的流控：客户端处理不过来时不再堆积
+        if (client->channel->pendingCount() > MAX_PENDING_BATCHES)
+            continue;
+        QVector<SyncEngine::WireMessage> batch;
+        for (int i = 0; i < count; ++i) {
+            if (batch.size() == SyncEngine::BATCH_MAX_MESSAGES) {
+                client->channel->send(SyncEngine::encodeBatch(batch));
+                batch.clear();
+            }
+            const Conversation& conversation = m_conversations[random->bounded(int(m_conversations.size()))];
+            batch.push_back(makeMessage(conversation, SAMPLE_TEXTS[random->bounded(int(SAMPLE_TEXTS.size()))]));
+        }
+        client->channel->send(SyncEngine::encodeBatch(batch));
+    }
+}
+
+void MockServer::onClientPayload(Client* client, const QByteArray& payload)
+{
+    // 每条来信在同一会话中回一条
+    QVector<SyncEngine::WireMessage> replies;
+    const QVector<SyncEngine::WireMessage> messages = SyncEngine::decodeBatch(payload);
+    for (const SyncEngine::WireMessage& wire : messages) {
+        for (const Conversation& conversation : std::as_const(m_conversations)) {
+            if (conversation.id == wire.conversationId) {
+                replies.push_back(makeMessage(conversation, "收到"));
+                break;
+            }
+        }
+    }
+    if (!replies.isEmpty())
+        client->channel->send(SyncEngine::encodeBatch(replies));
+}
+
+SyncEngine::WireMessage MockServer::makeMessage(const Conversation& conversation, const QString& text) const
+{
+    const Member& sender = conversation.members.isEmpty()
+            ? Member{ conversation.id, conversation.id, GroupRole::Member }
+            : conversation.members[QRandomGenerator::global()->bounded(int(conversation.members.size()))];
+    TextMessage message(text, false, sender.id, conversation.group, sender.name, sender.role);
+    message.setMessageId(MessageId::next());
+    return { conversation.id, MessageStore::encode(message, 0) };
+}
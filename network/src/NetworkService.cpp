@@ -0,0 +1,109 @@
+#include "NetworkService.h"
+#include "UserRepository.h"
+#include "GroupRepository.h"
+#include "IngestPipeline.h"
+#include <QCoreApplication>
+#include <QDebug>
+
+NetworkService::NetworkService(QObject* parent)
+        : QObject(parent)
+{
+    m_syncThread.setObjectName("NetworkSync");
+    m_serverThread.setObjectName("MockServer");
+    if (QCoreApplication::instance())
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &NetworkService::shutdown);
+}
+
+NetworkService::~NetworkService()
+{
+    shutdown();
+}
+
+NetworkService& NetworkService::instance()
+{
+    static NetworkService service;
+    return service;
+}
+
+void NetworkService::startFromEnvironment()
+{
+    const QString rate = qEnvironmentVariable("NETHERLINK_MOCK_RATE");
+    if (!rate.isEmpty()) {
+        startMockServer(MOCK_ADDRESS, rate.toInt());
+        connectTo(MOCK_ADDRESS);
+        return;
+    }
+    const QString address = qEnvironmentVariable("NETHERLINK_SERVER");
+    if (!address.isEmpty())
+        connectTo(address);
+}
+
+void NetworkService::connectTo(const QString& address)
+{
+    if (m_engine)
+        return;
+    // 流水线须在界面线程创建
+    IngestPipeline::instance();
+    m_engine = new SyncEngine(address);
+    m_engine->moveToThread(&m_syncThread);
+    connect(&m_syncThread, &QThread::finished, m_engine, &QObject::deleteLater);
+    connect(m_engine, &SyncEngine::connectionChanged, this, [this](bool connected) {
+        m_connected = connected;
+        emit connectionChanged(connected);
+    });
+    connect(m_engine, &SyncEngine::messagesAcked, this, &NetworkService::messagesAcked);
+    m_syncThread.start();
+    QMetaObject::invokeMethod(m_engine, &SyncEngine::start, Qt::QueuedConnection);
+}
+
+void NetworkService::startMockServer(const QString& address, int messagesPerSecond)
+{
+    if (m_server)
+        return;
+
+    // 仓库只在界面线程访问，先整理出会话和发送者再交给服务器线程
+    QVector<MockServer::Conversation> conversations;
+    QVector<MockServer::Member> everyone;
+    for (const User& user : UserRepository::instance().getAllUser()) {
+        everyone.push_back({ user.id, user.nick, GroupRole::Member });
+        conversations.push_back({ user.id, false, { { user.id, user.nick, GroupRole::Member } } });
+    }
+    for (const Group& group : GroupRepository::instance().getAllGroup()) {
+        MockServer::Conversation conversation{ group.groupId, true, everyone };
+        conversation.members.push_back({ group.ownerId, UserRepository::instance().getName(group.ownerId),
+                                         GroupRole::Owner });
+        conversations.push_back(conversation);
+    }
+
+    m_server = new MockServer(address, conversations, messagesPerSecond);
+    m_server->moveToThread(&m_serverThread);
+    connect(&m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+    m_serverThread.start();
+    QMetaObject::invokeMethod(m_server, &MockServer::start, Qt::QueuedConnection);
+}
+
+void NetworkService::shutdown()
+{
+    // 先停客户端再停服务器，各自在所属线程内关闭套接字
+    if (m_engine) {
+        QMetaObject::invokeMethod(m_engine, &SyncEngine::stop, Qt::BlockingQueuedConnection);
+        m_engine = nullptr;
+        m_syncThread.quit();
+        m_syncThread.wait();
+    }
+    if (m_server) {
+        QMetaObject::invokeMethod(m_server, &MockServer::stop, Qt::BlockingQueuedConnection);
+        m_server = nullptr;
+        m_serverThread.quit();
+        m_serverThread.wait();
+    }
+}
+
+void NetworkService::sendRecord(const QString& conversationId, const QByteArray& record, quint64 messageId)
+{
+    if (!m_engine)
+        return;
+    QMetaObject::invokeMethod(m_engine, [engine = m_engine, conversationId, record, messageId] {
+        engine->send(conversationId, record, messageId);
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,113 @@
+#include "ReliableChannel.h"
+#include <QtEndian>
+#include <QDebug>
+
+namespace {
+    constexpr int HEADER_SIZE = 1 + sizeof(quint64);
+}
+
+ReliableChannel::ReliableChannel(Transport* transport, QObject* parent)
+    : QObject(parent)
+    , m_transport(transport)
+{
+    m_resendTimer.setSingleShot(true);
+    m_resendTimer.setInterval(RESEND_TIMEOUT_MS);
+    connect(&m_resendTimer, &QTimer::timeout, this, &ReliableChannel::resend);
+    connect(transport, &Transport::frameReceived, this, &ReliableChannel::onFrame);
+    connect(transport, &Transport::connected, this, &ReliableChannel::onConnected);
+}
+
+void ReliableChannel::send(const QByteArray& payload)
+{
+    m_queue.enqueue(payload);
+    pump();
+}
+
+void ReliableChannel::onConnected()
+{
+    // 新连接上对端从序号 1 开始，未确认的帧按原顺序放回队首重新编号
+    for (int i = m_unacked.size() - 1; i >= 0; --i) {
+        m_queue.prepend(m_unacked[i].payload);
+    }
+    m_unacked.clear();
+    m_nextSeq = 1;
+    m_expectedSeq = 1;
+    m_resendTimer.stop();
+    pump();
+}
+
+void ReliableChannel::pump()
+{
+    if (!m_transport->isOpen())
+        return;
+    while (!m_queue.isEmpty() && m_unacked.size() < WINDOW_SIZE) {
+        m_unacked.enqueue({ m_nextSeq++, m_queue.dequeue() });
+        transmit(m_unacked.last());
+    }
+    if (!m_unacked.isEmpty() && !m_resendTimer.isActive())
+        m_resendTimer.start();
+}
+
+void ReliableChannel::resend()
+{
+    if (m_unacked.isEmpty() || !m_transport->isOpen())
+        return;
+    for (const Outgoing& outgoing : std::as_const(m_unacked)) {
+        transmit(outgoing);
+    }
+    m_resendTimer.start();
+}
+
+void ReliableChannel::transmit(const Outgoing& outgoing)
+{
+    QByteArray frame(HEADER_SIZE, Qt::Uninitialized);
+    frame[0] = char(Data);
+    qToLittleEndian<quint64>(outgoing.seq, frame.data() + 1);
+    frame += outgoing.payload;
+    m_transport->sendFrame(frame);
+}
+
+void ReliableChannel::onFrame(const QByteArray& frame)
+{
+    if (frame.size() < HEADER_SIZE) {
+        qWarning() << "ReliableChannel: short frame" << frame.size();
+        return;
+    }
+    const auto type = FrameType(quint8(frame[0]));
+    const quint64 seq = qFromLittleEndian<quint64>(frame.constData() + 1);
+
+    if (type == Ack) {
+        int acknowledged = 0;
+        while (!m_unacked.isEmpty() && m_unacked.head().seq <= seq) {
+            m_unacked.dequeue();
+            acknowledged++;
+        }
+        if (acknowledged > 0) {
+            m_resendTimer.stop();
+            emit delivered(acknowledged);
+            pump();
+        }
+        return;
+    }
+
+    if (type == Data) {
+        if (seq == m_expectedSeq) {
+            m_expectedSeq++;
+            emit received(frame.mid(HEADER_SIZE));
+        }
+        // 重复帧也要回确认，否则对端会一直重发；越序帧丢弃，等对端超时重发
+        if (!m_ackPending) {
+            m_ackPending = true;
+            QMetaObject::invokeMethod(this, &ReliableChannel::sendAck, Qt::QueuedConnection);
+        }
+    }
+}
+
+void ReliableChannel::sendAck()
+{
+    m_ackPending = false;
+    QByteArray frame(HEADER_SIZE, Qt::Uninitialized);
+    frame[0] = char(Ack);
+    qToLittleEndian<quint64>(m_expectedSeq - 1, frame.data() + 1);
+    m_transport->sendFrame(frame);
+}
@@ -0,0 +1,95 @@
+#include "SocketTransport.h"
+#include <QLocalSocket>
+#include <QTcpSocket>
+
+SocketTransport::SocketTransport(const QString& address, QObject* parent)
+    : Transport(parent)
+    , m_address(address)
+{
+    if (address.startsWith("tcp:"))
+        attach(new QTcpSocket(this));
+    else
+        attach(new QLocalSocket(this));
+}
+
+SocketTransport::SocketTransport(QLocalSocket* socket, QObject* parent)
+    : Transport(parent)
+{
+    socket->setParent(this);
+    attach(socket);
+}
+
+SocketTransport::SocketTransport(QTcpSocket* socket, QObject* parent)
+    : Transport(parent)
+{
+    socket->setParent(this);
+    attach(socket);
+}
+
+void SocketTransport::attach(QLocalSocket* socket)
+{
+    m_local = socket;
+    connect(socket, &QLocalSocket::connected, this, &Transport::connected);
+    connect(socket, &QLocalSocket::disconnected, this, [this] {
+        m_readBuffer.clear();
+        emit disconnected();
+    });
+    connect(socket, &QLocalSocket::readyRead, this, [this] { readFrames(m_local); });
+    connect(socket, &QLocalSocket::errorOccurred, this, [this] {
+        emit errorOccurred(m_local->errorString());
+    });
+}
+
+void SocketTransport::attach(QTcpSocket* socket)
+{
+    m_tcp = socket;
+    // 消息帧都很小，关掉 Nagle 避免攒包延迟
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(socket, &QTcpSocket::connected, this, &Transport::connected);
+    connect(socket, &QTcpSocket::disconnected, this, [this] {
+        m_readBuffer.clear();
+        emit disconnected();
+    });
+    connect(socket, &QTcpSocket::readyRead, this, [this] { readFrames(m_tcp); });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this] {
+        emit errorOccurred(m_tcp->errorString());
+    });
+}
+
+void SocketTransport::open()
+{
+    if (isOpen() || m_address.isEmpty())
+        return;
+    if (m_tcp) {
+        // "tcp:host:port"
+        const QString target = m_address.mid(4);
+        const int colon = target.lastIndexOf(':');
+        m_tcp->connectToHost(target.left(colon), quint16(target.mid(colon + 1).toUInt()));
+    } else {
+        m_local->connectToServer(m_address.startsWith("local:") ? m_address.mid(6) : m_address);
+    }
+}
+
+void SocketTransport::close()
+{
+    if (m_tcp)
+        m_tcp->disconnectFromHost();
+    else
+        m_local->disconnectFromServer();
+}
+
+bool SocketTransport::isOpen() const
+{
+    if (m_tcp)
+        return m_tcp->state() == QAbstractSocket::ConnectedState;
+    return m_local->state() == QLocalSocket::ConnectedState;
+}
+
+bool SocketTransport::sendFrame(const QByteArray& payload)
+{
+    if (!isOpen())
+        return false;
+    const QByteArray frame = encodeFrame(payload);
+    QIODevice* device = m_tcp ? static_cast<QIODevice*>(m_tcp) : static_cast<QIODevice*>(m_local);
+    return device->write(frame) == frame.size();
+}
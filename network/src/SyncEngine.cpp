@@ -0,0 +1,141 @@
+#include "SyncEngine.h"
+#include "SocketTransport.h"
+#include "IngestPipeline.h"
+#include <QDataStream>
+#include <QDebug>
+
+SyncEngine::SyncEngine(const QString& address, QObject* parent)
+    : QObject(parent)
+    , m_address(address)
+{
+}
+
+QByteArray SyncEngine::encodeBatch(const QVector<WireMessage>& messages)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint32(messages.size());
+    for (const WireMessage& message : messages) {
+        out << message.conversationId << message.record;
+    }
+    return payload;
+}
+
+QVector<SyncEngine::WireMessage> SyncEngine::decodeBatch(const QByteArray& payload)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 count = 0;
+    in >> count;
+    QVector<WireMessage> messages;
+    // 条数来自对端，预留时设上限
+    messages.reserve(qMin<quint32>(count, BATCH_MAX_MESSAGES));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        WireMessage message;
+        in >> message.conversationId >> message.record;
+        messages.push_back(message);
+    }
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "SyncEngine: malformed batch";
+        return {};
+    }
+    return messages;
+}
+
+void SyncEngine::start()
+{
+    if (m_running)
+        return;
+    m_running = true;
+
+    // 在网络线程中创建，保证所有套接字和定时器都属于该线程
+    if (!m_transport) {
+        m_transport = new SocketTransport(m_address, this);
+        m_channel = new ReliableChannel(m_transport, this);
+        m_batchTimer = new QTimer(this);
+        m_batchTimer->setSingleShot(true);
+        m_batchTimer->setInterval(BATCH_DELAY_MS);
+        m_reconnectTimer = new QTimer(this);
+        m_reconnectTimer->setSingleShot(true);
+        m_reconnectTimer->setInterval(RECONNECT_DELAY_MS);
+
+        connect(m_batchTimer, &QTimer::timeout, this, &SyncEngine::flushOutbox);
+        connect(m_reconnectTimer, &QTimer::timeout, m_transport, &Transport::open);
+        connect(m_channel, &ReliableChannel::received, this, &SyncEngine::onPayload);
+        connect(m_channel, &ReliableChannel::delivered, this, &SyncEngine::onDelivered);
+        connect(m_transport, &Transport::connected, this, [this] { emit connectionChanged(true); });
+        connect(m_transport, &Transport::disconnected, this, [this] {
+            emit connectionChanged(false);
+            if (m_running)
+                m_reconnectTimer->start();
+        });
+        connect(m_transport, &Transport::errorOccurred, this, [this](const QString& message) {
+            qWarning() << "SyncEngine:" << message;
+            // 连接失败不会触发 disconnected，同样安排重连
+            if (m_running && !m_transport->isOpen() && !m_reconnectTimer->isActive())
+                m_reconnectTimer->start();
+        });
+    }
+    m_transport->open();
+}
+
+void SyncEngine::stop()
+{
+    if (!m_running)
+        return;
+    m_running = false;
+    flushOutbox();
+    m_reconnectTimer->stop();
+    m_transport->close();
+}
+
+void SyncEngine::send(const QString& conversationId, const QByteArray& record, quint64 messageId)
+{
+    m_outbox.push_back({ conversationId, record });
+    m_outboxIds.push_back(messageId);
+    if (m_outbox.size() >= BATCH_MAX_MESSAGES)
+        flushOutbox();
+    else if (m_batchTimer && !m_batchTimer->isActive())
+        m_batchTimer->start();
+}
+
+void SyncEngine::flushOutbox()
+{
+    if (m_outbox.isEmpty() || !m_channel)
+        return;
+    if (m_batchTimer)
+        m_batchTimer->stop();
+    m_channel->send(encodeBatch(m_outbox));
+    m_inFlight.enqueue(std::move(m_outboxIds));
+    m_outbox.clear();
+    m_outboxIds.clear();
+}
+
+void SyncEngine::onDelivered(int count)
+{
+    QVector<quint64> acked;
+    for (int i = 0; i < count && !m_inFlight.isEmpty(); ++i) {
+        acked += m_inFlight.dequeue();
+    }
+    if (!acked.isEmpty())
+        emit messagesAcked(acked);
+}
+
+void SyncEngine::onPayload(const QByteArray& payload)
+{
+    const QVector<WireMessage> messages = decodeBatch(payload);
+    if (messages.isEmpty())
+        return;
+
+    // 解码、去重和写入都在入库流水线中进行；流水线积压时这里阻塞，套接字随之停止读取
+    IngestBatch batch;
+    batch.reserve(messages.size());
+    for (const WireMessage& wire : messages) {
+        if (!wire.conversationId.isEmpty())
+            batch.push_back({ wire.conversationId, wire.record, {} });
+    }
+    const int count = batch.size();
+    if (IngestPipeline::instance().submit(std::move(batch)))
+        emit messagesReceived(count);
+}
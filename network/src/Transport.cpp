@@ -0,0 +1,32 @@
+#include "Transport.h"
+#include <QIODevice>
+#include <QtEndian>
+
+void Transport::readFrames(QIODevice* device)
+{
+    m_readBuffer += device->readAll();
+    qsizetype pos = 0;
+    while (m_readBuffer.size() - pos >= qsizetype(sizeof(quint32))) {
+        const quint32 length = qFromLittleEndian<quint32>(m_readBuffer.constData() + pos);
+        if (length > MAX_FRAME_SIZE) {
+            emit errorOccurred(QString("frame too large: %1").arg(length));
+            m_readBuffer.clear();
+            close();
+            return;
+        }
+        if (m_readBuffer.size() - pos - qsizetype(sizeof(quint32)) < qsizetype(length))
+            break;
+        pos += sizeof(quint32);
+        emit frameReceived(m_readBuffer.mid(pos, length));
+        pos += length;
+    }
+    m_readBuffer.remove(0, pos);
+}
+
+QByteArray Transport::encodeFrame(const QByteArray& payload)
+{
+    QByteArray frame(sizeof(quint32), Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(payload.size()), frame.data());
+    frame += payload;
+    return frame;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+#include <QQueue>
+#include <QSize>
+#include <QSharedPointer>
+#include <QTextLayout>
+
+// 文本气泡的排版缓存：按（消息行号, 气泡最大宽度）保存折好行的 QTextLayout 与气泡尺寸
+// 行高、气泡位置、点击检测和绘制共用同一份排版，滚动经过已排过的行不再折行。
+// 行号取 CompactMessageList 的行号：分配后不再变化，旧版本记录没有消息 id 也能缓存。
+// 只保留最近用到的 MAX_WIDTHS 种宽度，窗口缩放后旧宽度的排版随之清除；字体代数变化时整体作废。
+// 折好行的排版最多保留 MAX_LAYOUTS 行，超出时最早排好的只留尺寸，排版对象收回重用，
+// 长会话滚动再久，排版占用的内存也有上限。
+// 线程：只在界面线程使用。
+class BubbleLayoutCache {
+public:
+    static constexpr int MAX_WIDTHS = 2;  // 行高与绘制拿到的行宽可能不同，两种宽度并存时不互相挤掉
+    static constexpr int MAX_LAYOUTS = 512;       // 保留排版对象的行数，约为几屏可见行
+    static constexpr int MAX_SPARE_LAYOUTS = 64;  // 收回待重用的排版对象
+
+    struct Entry {
+        QSize bubble;                        // 气泡尺寸（含内边距）
+        QSharedPointer<QTextLayout> layout;  // 已折行的排版；预取时只算了尺寸则为空，绘制时补上
+        bool estimated = false;              // 尺寸是按字数估的，后台排版完成或绘制时替换
+    };
+
+    // 使用前调用：字体代数变化时清空，宽度是新出现的时淘汰最久没用的宽度
+    void validate(int maxBubbleWidth, int fontGeneration);
+    // 第 row 行在 maxBubbleWidth 下的排版，没有时返回空；返回的指针在下一次修改缓存前有效
+    const Entry* find(int row, int maxBubbleWidth) const;
+    // 插入带排版的条目时可能收回最早的排版对象，之前拿到的条目应立即使用，不要长期持有
+    void insert(int row, int maxBubbleWidth, const Entry& entry);
+    // 取一个收回的排版对象重用（文本与字体由调用方重新设置），没有时新建
+    QSharedPointer<QTextLayout> takeLayout();
+    // 按（maxBubbleWidth, fontGeneration）排出的结果是否仍可写入：字体没变且宽度还在保留之列
+    bool accepts(int maxBubbleWidth, int fontGeneration) const;
+    // 丢掉按字数估计的条目：它们排入的后台任务已作废，下次测量时重新估计、重新排入
+    void dropEstimated();
+    void clear();
+    // 估算占用的内存（字节）
+    qint64 memoryUsage() const;
+
+private:
+    static quint64 key(int row, int maxBubbleWidth) { return quint64(quint32(row)) << 32 | quint32(maxBubbleWidth); }
+
+    void evictLayouts();
+
+    QHash<quint64, Entry> m_entries;
+    QQueue<quint64> m_layoutOrder;                   // 带排版的条目，最早排好的在前
+    QVector<QSharedPointer<QTextLayout>> m_spareLayouts;
+    QVector<int> m_widths;       // 最近用到的宽度，最近的在后
+    int m_fontGeneration = -1;
+};
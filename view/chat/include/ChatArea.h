@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QSharedPointer>
+#include <QCache>
 #include <QDateTime>
 #include "ChatListView.h"
 #include "ChatListModel.h"
@@ -17,8 +18,23 @@ class ChatArea : public QWidget
     Q_OBJECT
     using ChatMessagePtr = QSharedPointer<ChatMessage>;
 public:
+    static constexpr int MESSAGE_PAGE_SIZE = 50;  // 每次从仓库加载的消息条数
+    static constexpr int MODEL_CACHE_MB = 32;     // 最近打开过的会话模型的内存预算
+
     explicit ChatArea(QWidget *parent = nullptr);
-    void initMessage(QVector<ChatMessagePtr>&);
+    void initMessage(const QVector<ChatMessagePtr>&);
+    // 换上预先建好的模型（取得所有权），代替 clearAll + initMessage
+    void adoptModel(ChatListModel* model);
+    // 气泡排版所用的行宽，预取按同样的宽度排版
+    int layoutWidth() const;
+    // 离开当前会话前调用：模型连同滚动位置放进缓存，换上空模型
+    void stashConversation();
+    // 从缓存换回会话 id 的模型并恢复滚动位置，补上离开期间的新消息；不在缓存中时返回 false
+    // 需在 setMessageId(id) 之后调用
+    bool restoreConversation(const QString& id);
+    bool isConversationCached(const QString& id) const { return conversationCache.contains(id); }
+    // 当前会话的最新序号，没有消息时为 -1
+    qint64 lastSeq() const { return chatModel->lastSeq(); }
     void addMessage(ChatMessagePtr message);
     void addImageMessage(QSharedPointer<ImageMessage> message,
                          const QDateTime& timestamp = QDateTime::currentDateTime());
@@ -30,9 +46,10 @@ public:
 protected:
     void resizeEvent(QResizeEvent *event) override;
 signals:
+    // record 为 MessageStore::encode 格式的消息记录
     void sendMessage(const QString& chatId,
-                     const QString& text,
-                     const QDateTime& timestamp);
+                     const QByteArray& record,
+                     quint64 messageId);
 private slots:
     void onScrollValueChanged(int value);
     void onNewMessageNotifierClicked();
@@ -40,6 +57,17 @@ private slots:
     void onSendText(const QString &text);
 
 private:
+    // 缓存中的会话：模型连同离开时的滚动状态
+    struct CachedConversation {
+        CachedConversation() = default;
+        ~CachedConversation() { delete model; }
+        Q_DISABLE_COPY(CachedConversation)
+        ChatListModel* model = nullptr;
+        int scrollValue = 0;
+        bool atBottom = true;
+        bool hasOlderMessages = false;
+    };
+
     ChatListView* chatView;
     ChatListModel* chatModel;
     ChatItemDelegate* chatDelegate;
@@ -52,6 +80,11 @@ private:
     bool isAtBottom;
     bool isGroupMode;
     QString messageId;
+    bool hasOlderMessages = false;
+    bool loadingOlderMessages = false;
+    int lastScrollValue = 0;
+    QMetaObject::Connection repositoryConnection;
+    QCache<QString, CachedConversation> conversationCache;  // 最近打开过的会话，代价按 KB 计
     
     void updateNewMessageNotifier();
     void updateNewMessageNotifierPosition();
@@ -60,6 +93,15 @@ private:
     bool isNearBottom() const;
     void adjustBottomSpace();
     void updateInputBarPosition();
+    void loadOlderMessages();
+    // 把仓库中比当前最新一条更新的消息追加到视图
+    void syncNewMessages();
+    void ensureViewportFilled();
+    // 换上 model，返回换下的旧模型（所有权交给调用方）
+    ChatListModel* replaceModel(ChatListModel* model);
+    // 缓存中的模型仍有待确认的本地消息时，自己接收投递状态更新；恢复为当前模型后断开
+    static void followDeliveryState(ChatListModel* model);
+    static void unfollowDeliveryState(ChatListModel* model);
 };
 
 #endif // CHATAREA_H 
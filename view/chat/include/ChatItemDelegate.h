@@ -4,9 +4,15 @@
 #include <QStyledItemDelegate>
 #include <QCache>
 #include <QPixmap>
-#include "ChatMessage.h"
+#include <QFontMetrics>
+#include "CompactMessageList.h"
+#include "BubbleLayoutCache.h"
+#include "TextShaper.h"
+#include "RowPixmapCache.h"
 #include "TransparentMenu.h"
 
+struct TimeHeader;
+
 class ChatItemDelegate : public QStyledItemDelegate
 {
     Q_OBJECT
@@ -20,6 +26,39 @@ public:
                     const QStyleOptionViewItem& option,
                     const QModelIndex& index) override;
 
+    // 行高的计算方式
+    enum class Measure {
+        Budgeted,   // 本轮排版预算内当场折行，超出后先估计、交给后台（sizeHint 的方式）
+        Deferred,   // 没有排过的行一律先估计、交给后台，不占用界面线程
+        Estimated,  // 没有排过的行只按字数估计，不交给后台，用于离视口较远的行
+        Exact       // 当场折行，用于可见行
+    };
+    QSize rowSize(const QStyleOptionViewItem& option, const QModelIndex& index, Measure measure) const;
+    // 宽度或字体变化、重新计算全部行高前调用：model 已排入后台的请求作废，估计的行高从缓存中去掉
+    void cancelShaping(ChatListModel* model);
+
+    // 消息正文的字体（只在界面线程调用）
+    static QFont messageFont();
+    // 行宽为 rowWidth 时气泡的最大宽度（行宽的 70%）
+    static int maxBubbleWidth(int rowWidth) { return rowWidth * 0.7; }
+    // 文本气泡的尺寸（含内边距），只用到字体与文本排版，可以在工作线程调用
+    static QSize measureTextBubble(const QString& text, const QFont& font, int maxBubbleWidth);
+    // 只按字数估算文本气泡的尺寸，不做字形排版，等后台排版完成前使用
+    static QSize estimateTextBubble(const QString& text, const QFontMetrics& metrics, int maxBubbleWidth);
+    // 消息正文字体的代数，应用字体变化时加一，排版缓存据此作废（只在界面线程使用）
+    static int fontGeneration();
+    static void invalidateFonts();
+    // 最近一次计算行高时的行宽，尚未计算过时为 0
+    int layoutWidth() const { return m_layoutWidth; }
+    // 整行位图缓存，默认开启；关闭时每帧直接绘制
+    void setRowCacheEnabled(bool enabled);
+    bool isRowCacheEnabled() const { return m_rowCacheEnabled; }
+    qint64 rowCacheMemoryUsage() const { return m_rowPixmaps.memoryUsage(); }
+
+signals:
+    // 用户从右键菜单删除了一条消息，已从模型移除；messageId 为其消息 id，入库前后不变
+    void messageDeleted(quint64 messageId);
+
 private:
     static constexpr int AVATAR_SIZE = 40;
     static constexpr int BUBBLE_MARGIN = 10;
@@ -38,24 +77,39 @@ private:
     static constexpr int TIME_HEADER_RADIUS = 11;  // 时间标识圆角半径
     static constexpr int TIME_HEADER_MIN_WIDTH = 60;  // 时间标识最小宽度
     static constexpr int TIME_HEADER_FONT_SIZE = 11;  // 时间标识字体大小
+    static constexpr int DELIVERY_MARK_SIZE = 10;     // 气泡旁投递状态标记的直径
     
+    // 直接绘制一行，不经过位图缓存
+    void paintRow(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index,
+                  const MessageView& message, const TimeHeader* timeHeader) const;
     void drawBubble(QPainter* painter, const QRect& rect,
-                    bool isFromMe, const ChatMessage* message, bool isSelected) const;
+                    bool isFromMe, const MessageView& message, bool isSelected,
+                    const QTextLayout* layout) const;
     void drawTextMessage(QPainter* painter, const QRect& rect,
-                        const QString& text, bool isFromMe, bool isSelected) const;
+                        const QTextLayout& layout, bool isFromMe, bool isSelected) const;
     void drawImageMessage(QPainter* painter, const QRect& rect,
                          const QPixmap& image, bool isFromMe) const;
     void drawAvatar(QPainter* painter, const QRect& rect,
-                    const QString& avatarPath) const;
+                    StringHandle userID) const;
     void drawGroupInfo(QPainter* painter, const QRect& rect,
-                      const ChatMessage* message) const;
+                      const MessageView& message) const;
     void drawGroupInfoForMe(QPainter* painter, const QRect& rect,
-                          const ChatMessage* message) const;
+                          const MessageView& message) const;
     void drawTimeHeader(QPainter* painter, const QRect& rect,
                        const QString& text) const;
+    // 本人消息气泡左侧的投递状态：空心圈为发送中，实心点为已保存、等待服务器确认，确认后不再显示
+    void drawDeliveryState(QPainter* painter, const QRect& bubbleRect,
+                           DeliveryState state) const;
 
+    // 文本气泡的排版：先查所在模型的排版缓存，没有时按 measure 当场折行或先估计，结果放回缓存。
+    // Exact 总是拿到折好行的排版；其余方式下预取与估算的条目也直接使用
+    BubbleLayoutCache::Entry textLayout(const QAbstractItemModel* model, const MessageView& message,
+                                        int maxWidth, Measure measure) const;
+    // 按气泡最大宽度折行，返回气泡尺寸
+    static QSize layoutLines(QTextLayout& layout, int maxBubbleWidth);
     QRect calculateBubbleRect(const QRect& contentRect,
-                             const ChatMessage* message,
+                             const QAbstractItemModel* model,
+                             const MessageView& message,
                              int maxWidth, bool isFromMe) const;
     QRect calculateAvatarRect(const QRect& contentRect,
                              bool isFromMe) const;
@@ -63,6 +117,11 @@ private:
                                 const QString& text) const;
                              
     void showContextMenu(const QPoint& pos, const QModelIndex& index,
-                        const ChatMessage* message) const;
+                        const MessageView& message) const;
+
+    mutable int m_layoutWidth = 0;
+    TextShaper* m_shaper;
+    mutable RowPixmapCache m_rowPixmaps;
+    bool m_rowCacheEnabled = true;
 };
 #endif // CHATITEMDELEGATE_H 
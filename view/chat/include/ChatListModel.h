@@ -3,9 +3,13 @@
 
 #include <QAbstractListModel>
 #include <QVector>
+#include <QHash>
 #include <QSharedPointer>
 #include <QDateTime>
 #include "ChatMessage.h"
+#include "CompactMessageList.h"
+#include "MessageStore.h"
+#include "BubbleLayoutCache.h"
 
 // 时间标识类型
 enum class TimeHeaderType {
@@ -48,8 +52,38 @@ public:
     bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
     Qt::ItemFlags flags(const QModelIndex& index) const override;
     
-    void addMessage(QSharedPointer<ChatMessage> message);
-    const ChatMessage* messageAt(int index) const;
+    // 追加一条消息；是先行显示过的本地消息时只补上序号，返回是否新增了一行
+    bool addMessage(QSharedPointer<ChatMessage> message);
+    // 本地发出、尚未入库的消息先行显示，此后按消息 id 更新投递状态
+    bool addLocalMessage(QSharedPointer<ChatMessage> message);
+    // 更新本地消息的投递状态，不在列表中的 id 忽略
+    void setDeliveryState(const QVector<quint64>& messageIds, DeliveryState state);
+    // 在顶部插入一批更早的消息（按时间升序），返回插入的行数
+    int prependMessages(const QVector<QSharedPointer<ChatMessage>>& messages);
+    // 同上，映射中的记录不解码，直接引用到消息列表里
+    int prependRecords(const QVector<MessageStore::MappedRecord>& records);
+    // 当前最早一条消息的序号，没有消息时返回 -1
+    qint64 firstSeq() const;
+    // 列表中已入库消息的最大序号，没有时返回 -1
+    qint64 lastSeq() const;
+    // 列表中的消息条数（不含时间标识与底部空白）
+    int messageCount() const { return messages.size(); }
+    // 是否还有等待入库或确认的本地消息
+    bool hasLocalMessages() const { return !localRows.isEmpty(); }
+    // 是否还有尚未写入发送日志的本地消息
+    bool hasPendingMessages() const;
+    // 估算占用的内存（字节），含消息、行、时间标识、气泡排版与已解码的图片
+    qint64 memoryUsage() const;
+    // 第 index 行的消息视图，非消息行返回无效视图
+    MessageView messageAt(int index) const;
+    // messages 中第 messageRow 条消息所在的行，已删除时返回 -1；追加时顺带更新，其余变动后首次调用时重建
+    int rowOfMessage(int messageRow) const;
+    // 文本气泡的排版缓存，随模型一起保留（会话缓存、预取的模型都带着它）
+    BubbleLayoutCache& layoutCache() const { return layouts; }
+    // 行内容的代数：模型创建与清空时取一个全局唯一的新值，按（代数, 行号）缓存的绘制结果不会认错行
+    quint64 renderId() const { return renderSerial; }
+    // 缓存中的气泡尺寸被替换（估计值换成实际值），视图只需重新布局这些消息所在的行
+    void notifyBubbleSizesChanged(const QVector<int>& messageRows) { emit bubbleSizesChanged(messageRows); }
     void clearSelection();
     bool removeMessage(int index);
 
@@ -62,17 +96,29 @@ public:
 
     void clear();
 
+signals:
+    // 参数为 messages 中的行号，用 rowOfMessage 换算成视图行
+    void bubbleSizesChanged(const QVector<int>& messageRows);
+
 private:
     struct ListItem {
-        QSharedPointer<ChatMessage> message;
+        int message = -1;  // 在 messages 中的行号，非消息行为 -1
         QSharedPointer<TimeHeader> timeHeader;
         bool isHeader = false;
         bool isBottomSpace = false;
         int bottomSpaceHeight = BottomSpace::DEFAULT_HEIGHT;  // 使用默认高度
     };
     QVector<ListItem> items;
+    CompactMessageList messages;  // 消息本体，items 只保存行号
+    QHash<quint64, int> localRows;  // 先行显示的本地消息：消息 id -> messages 中的行号，入库且确认后移除
+    mutable QVector<int> messageItems;  // messages 中的行号 -> items 下标，-1 为已删除
+    mutable bool messageItemsValid = true;
+    qint64 newestSeq = -1;
+    mutable BubbleLayoutCache layouts;
+    quint64 renderSerial;
     int selectedMessageIndex = -1;
 
+    ListItem makeTimeHeader(const QDateTime& timestamp) const;
     QString formatTimeHeader(const QDateTime& timestamp) const;
     TimeHeaderType getTimeHeaderType(const QDateTime& timestamp) const;
     bool shouldAddTimeHeader(const QDateTime& prevTime, const QDateTime& currTime) const;
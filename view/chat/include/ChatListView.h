@@ -6,16 +6,40 @@
 #include <QMouseEvent>
 #include <QPropertyAnimation>
 #include "ChatListModel.h"
+#include "ChatItemDelegate.h"
+#include "RowHeightIndex.h"
 #include "SmoothScrollBar.h"
 
+// 聊天消息列表
+// 不使用 QListView 的整体布局（它要对每一行调用 sizeHint 才能算出滚动范围），
+// 行的位置来自行高索引：行插入时只记估计值，进入视口的行才按实际排版测量。
+// 宽度或字体变化后重建行高时全部只按字数估计，只有视口上下 SHAPE_SCREENS 屏内的行交给后台排版，
+// 之前排入后台、尚未完成的请求作废。
+// 行数达到 VIRTUAL_ROWS 时进入虚拟化模式：不再逐行估计，全部行先用取样得到的统一行高，
+// 只有视口上下各一屏的窗口内的行按实际排版测量，窗口外的行不读取、不排版。
 class ChatListView : public QListView
 {
     Q_OBJECT
     Q_PROPERTY(int smoothScrollValue READ smoothScrollValue WRITE setSmoothScrollValue)
 public:
+    static constexpr int VIRTUAL_ROWS = 20000;  // 进入虚拟化模式的行数
+    static constexpr int SAMPLE_ROWS = 64;      // 估计统一行高时从底部取样的行数
+    static constexpr int SHAPE_SCREENS = 1;     // 非虚拟化模式下，视口外交给后台排版的范围（屏数）
+
     explicit ChatListView(QWidget *parent = nullptr);
     void setModel(QAbstractItemModel *model) override;
     void scrollToBottom();
+    // 顶部插入行后调用，保持原先可见的内容停留在原位置
+    void keepScrollAnchor(int previousMaximum, int previousValue);
+    bool isVirtualized() const { return m_virtualized; }
+    // 行高索引占用的内存（字节）
+    qint64 rowIndexMemoryUsage() const { return m_rowHeights.memoryUsage(); }
+
+    QRect visualRect(const QModelIndex &index) const override;
+    QModelIndex indexAt(const QPoint &point) const override;
+    void scrollTo(const QModelIndex &index, ScrollHint hint = EnsureVisible) override;
+    void doItemsLayout() override;
+    void reset() override;
 
 protected:
     void mousePressEvent(QMouseEvent* event) override;
@@ -24,11 +48,30 @@ protected:
     void enterEvent(QEnterEvent *event) override;
     void leaveEvent(QEvent *event) override;
     bool viewportEvent(QEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void updateGeometries() override;
+
+    int verticalOffset() const override;
+    int horizontalOffset() const override;
+    bool isIndexHidden(const QModelIndex &index) const override;
+    QModelIndex moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers modifiers) override;
+    void setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command) override;
+    QRegion visualRegionForSelection(const QItemSelection &selection) const override;
+
+protected slots:
+    void rowsInserted(const QModelIndex &parent, int start, int end) override;
+    void rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end) override;
+    void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                     const QList<int> &roles = QList<int>()) override;
 
 private slots:
     void onCustomScrollValueChanged(int value);
     void onAnimationFinished();
     void onModelRowsChanged();
+    // 后台排好的行高替换了估计值，重新布局并保持可见内容不动
+    void onBubbleSizesChanged(const QVector<int>& messageRows);
     void checkScrollBarVisibility();
 
 private:
@@ -36,11 +79,42 @@ private:
     QPropertyAnimation *scrollAnimation;
     int m_smoothScrollValue;
     bool hovered = false;
+    RowHeightIndex m_rowHeights;   // 每行高度（含行间距），已测量或估计
+    int m_layoutWidth = -1;        // 行高索引对应的行宽
+    bool m_measuring = false;
+    bool m_virtualized = false;
+    int m_sampledHeight = 0;       // 取样得到的统一行高
+    qint64 m_exactHeightSum = 0;   // 已测量各行的高度之和，用于估计新插入的行
+    int m_exactRows = 0;
     
     int smoothScrollValue() const { return m_smoothScrollValue; }
     void setSmoothScrollValue(int value);
     void updateCustomScrollBar();
     void startScrollAnimation(int targetValue);
+
+    // 行宽：视口宽度减去两侧间距
+    int rowWidth() const;
+    // 第 row 行在视口中的位置
+    QRect rowRect(int row) const;
+    qint64 contentHeight() const;
+    // 测量第 row 行，返回含行间距的高度
+    int measureRow(QStyleOptionViewItem &option, int row, ChatItemDelegate::Measure measure) const;
+    // 按当前行宽重建行高索引，全部为估计值；keepAnchor 时视口顶部的内容保持不动
+    void rebuildRowHeights(bool keepAnchor);
+    // 虚拟化模式下的统一行高：有已测量的行时取其平均，否则取底部 SAMPLE_ROWS 行的估计平均
+    int uniformRowHeight() const;
+    void sampleRowHeight(QStyleOptionViewItem &option);
+    // 需要实际测量的范围在视口外扩展的高度：虚拟化模式下为一屏
+    int windowMargin() const;
+    // 窗口内还是估计值的行按实际排版测量，返回视口内是否有行高变化（需要整体重画）
+    bool measureVisibleRows();
+    // 非虚拟化模式下，视口上下 SHAPE_SCREENS 屏内只估计过的行交给后台排版
+    void shapeNearbyRows(QStyleOptionViewItem &option);
+    // 作废当前模型排入后台的排版请求
+    void cancelShaping();
+    void updateScrollRange();
+    // 行高变化后调整滚动位置：原先在底部时留在底部，否则按视口上方行的高度变化平移，可见内容不动
+    void followHeightChange(int previousMaximum, bool atBottom, int deltaAbove);
 };
 
 #endif // CHATLISTVIEW_H 
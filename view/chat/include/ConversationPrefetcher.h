@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QSize>
+#include "ChatListModel.h"
+
+// 会话预取：鼠标悬停或键盘焦点落在会话行上时，在工作线程读出最新一页、排好文本气泡，图片只解码为 QImage；
+// 回到界面线程后建好模型（图片在此转为 QPixmap）、备好头像。点击时仓库中的会话没有变化，就直接换上这个模型，不再读取和排版。
+class ConversationPrefetcher : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int MAX_READY = 3;  // 最多保留的已备好会话，超出时淘汰最早备好的
+
+    explicit ConversationPrefetcher(QObject* parent = nullptr);
+    ~ConversationPrefetcher() override;
+
+    // 按行宽 layoutWidth 预取会话的最新一页；已备好且仍然有效时忽略
+    void prefetch(const QString& conversationId, int layoutWidth);
+    // 取走已备好的模型，所有权交给调用方；没有备好、行宽不同或会话已有变化时返回空
+    ChatListModel* take(const QString& conversationId, int layoutWidth);
+
+private:
+    // 工作线程读出并排好的一页
+    struct Page {
+        QString conversationId;
+        QVector<QSharedPointer<ChatMessage>> messages;
+        QHash<qint64, QSize> bubbleSizes;  // 文本消息的气泡尺寸，键为序号
+        int layoutWidth = 0;
+        int fontGeneration = 0;
+        int totalCount = 0;
+        qint64 lastSeq = -1;
+    };
+    struct Prepared {
+        ChatListModel* model = nullptr;
+        int layoutWidth = 0;
+        int totalCount = 0;
+        qint64 lastSeq = -1;
+    };
+
+    // 工作线程调用：把图片转成绘制用的像素格式，界面线程的 QPixmap::fromImage 只需包装、不再逐像素转换
+    static QSharedPointer<ChatMessage> displayReady(const ImageMessage& message);
+    void onPageReady(const Page& page);
+    // 仓库中的会话仍是准备时的样子
+    static bool isCurrent(const QString& conversationId, int totalCount, qint64 lastSeq);
+    void discard(const QString& conversationId);
+
+    QThreadPool m_pool;                 // 单线程，新的请求到来时丢弃还没开始的旧请求
+    QHash<QString, Prepared> m_ready;
+    QStringList m_readyOrder;           // 备好的先后顺序，最早的在前
+    QString m_requested;                // 最近一次请求的会话，完成前重复的悬停不再排队
+    int m_requestedWidth = 0;
+};
@@ -6,21 +6,28 @@
 #include "MessageListWidget.h"
 #include "DefaultPage.h"
 #include "ChatArea.h"
+#include "ConversationPrefetcher.h"
 
 class MessageApplication : public QWidget {
     Q_OBJECT
 public:
     explicit MessageApplication(QWidget* parent = nullptr);
+    MessageListWidget* messageList() const { return m_msgList; }
 protected:
     void resizeEvent(QResizeEvent* event) override;
     void paintEvent(QPaintEvent* event) override;
 private slots:
     void onMessageClicked(MessageListItem* item);
+    void onPrefetchRequested(const QString& chatId);
+    void onSearchTextChanged(const QString& text);
 private:
+    static constexpr int SEARCH_HIT_LIMIT = 500;  // 参与筛选会话的搜索结果上限
+
     QSplitter*          m_splitter;
     TopSearchWidget*    m_topSearch;
     MessageListWidget*  m_msgList;
     QStackedWidget*     m_rightStack;
     DefaultPage*        m_defaultPage;
     ChatArea*           m_chatArea;
+    ConversationPrefetcher* m_prefetcher;
 };
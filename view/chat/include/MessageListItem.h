@@ -15,6 +15,7 @@ struct MessageItemContent {
     QString avatarPath;
     QString id;
     bool isGroup = false;
+    QPixmap avatar;     // 启动快照中的头像，为空时从仓库取
 };
 
 class MessageListItem : public QWidget {
@@ -29,8 +30,20 @@ public:
         resizeEvent(nullptr); }
     QDateTime getLastTime() const { return lastTime; }
     QString getChatID() const { return id; }
+    QString getName() const { return fullName; }
+    void setName(const QString& name) { fullName = name; update(); }
+    QString getLastText() const { return fullText; }
     void setLastText(QString text) { fullText = text; update();
         resizeEvent(nullptr); }
+    int getUnreadCount() const { return unreadCount; }
+    void setUnreadCount(int count) { unreadCount = count; badge->setCount(count);
+        resizeEvent(nullptr); }
+    bool isGroupChat() const { return isGroup; }
+    bool isDoNotDisturb() const { return doNotDisturb; }
+    void setDoNotDisturb(bool dnd) { doNotDisturb = dnd; badge->setDoNotDisturb(dnd); }
+    QString getAvatarPath() const { return avatarPath; }
+    QPixmap getAvatar() const { return avatarLabel->pixmap(); }
+    void setAvatar(const QPixmap& avatar, const QString& path) { avatarPath = path; avatarLabel->setPixmap(avatar); }
 
 protected:
     void resizeEvent(QResizeEvent* ev) Q_DECL_OVERRIDE;
@@ -38,11 +51,16 @@ protected:
     void enterEvent(QEnterEvent*) Q_DECL_OVERRIDE;
     void leaveEvent(QEvent*) Q_DECL_OVERRIDE;
     void mousePressEvent(QMouseEvent*) Q_DECL_OVERRIDE;
+    void focusInEvent(QFocusEvent*) Q_DECL_OVERRIDE;
+    void keyPressEvent(QKeyEvent*) Q_DECL_OVERRIDE;
 signals:
     void itemClicked(MessageListItem* item);
+    // 鼠标悬停或获得键盘焦点，很可能马上被点开
+    void prefetchRequested(MessageListItem* item);
 
 private:
     void setupUI(const MessageItemContent& data);
+    void activate();
     QLabel*   avatarLabel;
     QString   fullName;
     QString   fullText;
@@ -51,6 +69,10 @@ private:
     NotificationBadge* badge;
     QDateTime lastTime;
     QString id;
+    QString avatarPath;
+    int unreadCount = 0;
+    bool isGroup = false;
+    bool doNotDisturb = false;
 
     QRect avatarRect;
     QRect nameRect;
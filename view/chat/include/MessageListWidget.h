@@ -2,7 +2,10 @@
 #pragma once
 #include "CustomScrollArea.h"
 #include "MessageListItem.h"
+#include "StartupSnapshot.h"
 #include <QVector>
+#include <QHash>
+#include <QSet>
 
 class MessageListWidget : public CustomScrollArea {
     Q_OBJECT
@@ -12,16 +15,32 @@ public:
     void addMessage(const MessageItemContent& data);
     void clearMessages();
     MessageListItem* getSelectedItem() const { return selectItem; }
+    // 当前的会话行数（含被搜索过滤隐藏的）
+    int count() const { return int(m_items.size()); }
+    // 只显示名字包含 keyword 或在 matchedIds 中的会话；keyword 为空时恢复全部
+    void setFilter(const QString& keyword, const QSet<QString>& matchedIds);
+    // 当前显示的各行，供保存启动快照
+    QVector<StartupSnapshot::ConversationRow> snapshotRows() const;
 signals:
     void itemClicked(MessageListItem* item);
+    // 未打开的会话被悬停或获得焦点，可以开始预取
+    void itemPrefetchRequested(const QString& chatId);
 protected:
     void layoutContent() override;
 private slots:
     void onItemClicked(MessageListItem*);
 public slots:
-    void onLastMessageUpdated(const QString& chatId, const QString& text, const QDateTime& timestamp);
+    // 仓库合并后的变更通知：逐个刷新条目，最后只排序、布局一次
+    void onConversationsChanged(const QSet<QString>& chatIds);
+    // 未读数变化只更新对应条目的角标，不重新读取摘要
+    void onUnreadChanged(const QString& chatId, int unreadCount);
+    // 用仓库中的真实数据校正列表：从启动快照建出的行就地更新，多余的删除，缺少的补上。
+    // 首次调用后开始接收会话变更通知
+    void reconcile();
 private:
     MessageListItem* findItemById(const QString& id);
     QVector<MessageListItem*> m_items;
+    QHash<QString, MessageListItem*> m_itemById;
     MessageListItem* selectItem = nullptr;
+    bool m_reconciled = false;
 };
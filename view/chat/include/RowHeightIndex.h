@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QVector>
+#include <QBitArray>
+#include "FenwickTree.h"
+
+// 行高索引：每行的高度（已测量的实际值或估计值）存进树状数组，
+// 行的纵坐标、内容总高度与按纵坐标找行都是 O(log n)，不需要先测量所有行。
+// 末尾逐行追加与截断为 O(log n)，成批插入、中间插入或删除时整体重建（O(n)，只做加法，不测量）。
+class RowHeightIndex {
+public:
+    int size() const { return int(m_heights.size()); }
+    void clear();
+
+    // 在 row 处插入 heights.size() 行，估计值
+    void insert(int row, const QVector<int>& heights);
+    // 删除 [row, row + count)
+    void remove(int row, int count);
+
+    int height(int row) const { return m_heights.at(row); }
+    bool isExact(int row) const { return m_exact.testBit(row); }
+    // 更新行高；exact 为 true 表示已按实际排版测量
+    void setHeight(int row, int height, bool exact);
+
+    // 第 row 行的顶端（之前各行高度之和）
+    qint64 top(int row) const { return m_tree.prefixSum(row); }
+    qint64 total() const { return m_tree.total(); }
+    // 纵坐标 y 所在的行，超出内容时返回 size()
+    int rowAt(qint64 y) const { return y < 0 ? 0 : m_tree.find(y); }
+    // 估算占用的内存（字节）
+    qint64 memoryUsage() const;
+
+private:
+    void rebuild();
+
+    FenwickTree m_tree;
+    QVector<int> m_heights;
+    QBitArray m_exact;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QCache>
+#include <QHashFunctions>
+#include <QPixmap>
+#include <QString>
+#include <QSize>
+
+// 整行绘制结果的位图缓存
+// 静态的行（文本消息、时间标识）画一次后存成与屏幕像素比一致的位图，平滑滚动时每帧只是贴图。
+// 键包含行的身份、尺寸、像素比、选中与悬停、投递状态、调色板（主题）、头像与字体代数，
+// 其中任何一项变化都会画出新的位图；旧的按最久未用淘汰，总大小不超过 BUDGET_MB。
+// 线程：只在界面线程使用。
+class RowPixmapCache {
+public:
+    static constexpr int BUDGET_MB = 32;
+
+    struct Key {
+        quint64 renderId = 0;        // 所在模型的 ChatListModel::renderId()，时间标识为 0
+        int row = -1;                // 消息在 CompactMessageList 中的行号，时间标识为 -1
+        QString header;              // 时间标识的文字
+        QSize size;                  // 行的尺寸（逻辑像素）
+        qreal devicePixelRatio = 1;
+        int state = 0;               // 选中、悬停与投递状态
+        qint64 palette = 0;          // 调色板的 cacheKey
+        qint64 avatar = 0;           // 头像位图的 cacheKey，头像换了或刚加载出来时不同
+        int fontGeneration = 0;
+
+        bool operator==(const Key& other) const;
+        friend size_t qHash(const Key& key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.renderId, key.row, key.header, key.size.width(), key.size.height(),
+                              key.devicePixelRatio, key.state, key.palette, key.avatar, key.fontGeneration);
+        }
+    };
+
+    RowPixmapCache();
+
+    // 返回的指针在下一次插入前有效
+    const QPixmap* find(const Key& key);
+    void insert(const Key& key, const QPixmap& pixmap);
+    void clear();
+    // 占用的内存（字节）
+    qint64 memoryUsage() const;
+
+private:
+    QCache<Key, QPixmap> m_pixmaps;  // 开销以 KB 计
+};
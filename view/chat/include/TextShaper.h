@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QPair>
+#include <QSize>
+#include <QHash>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+
+class ChatListModel;
+
+// 文本气泡的后台排版
+// 一次要排很多行时（打开长会话、缩放窗口），每轮事件循环只有前 SYNC_BUDGET 行当场折行，
+// 其余的行先按字数估出高度写进排版缓存，真正的折行交给线程池；结果按批写回各模型的排版缓存，
+// 高度有变化时通知视图重新布局。后台只用 QFont 与 QTextLayout 计算尺寸，排版对象本身不跨线程。
+// 每个模型有一个排版代数，宽度或字体变化时由 cancel 加一；批次带着排入时的代数，
+// 工作线程开始排版前和逐行排版时核对，代数已变的批次直接放弃，不再占用线程池。
+// 线程：公开接口只在界面线程调用。
+class TextShaper : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int SYNC_BUDGET = 32;   // 每轮事件循环内当场排版的行数
+    static constexpr int BATCH_SIZE = 128;   // 每个后台任务排版的行数
+
+    explicit TextShaper(QObject* parent = nullptr);
+    ~TextShaper() override;
+
+    // 本轮还能当场排版时扣减预算并返回 true
+    bool takeSyncBudget();
+    // 把第 row 行排入后台；结果在本轮末尾成批提交，完成后写回 model 的排版缓存
+    void request(ChatListModel* model, int row, const QString& text, int maxBubbleWidth);
+    // 后台结果替换了 rows（消息行号）估计的行高，合并到本轮末尾通知视图
+    void markChanged(ChatListModel* model, const QVector<int>& rows);
+    // 作废 model 已排入的请求：还没提交的直接丢弃，已提交的批次在工作线程中跳过
+    void cancel(ChatListModel* model);
+
+private:
+    struct Pending {
+        QPointer<ChatListModel> model;
+        int maxBubbleWidth = 0;
+        QVector<QPair<int, QString>> rows;  // 行号与文本
+    };
+    struct Changed {
+        QPointer<ChatListModel> model;
+        QVector<int> rows;                  // 高度有变化的消息行号
+    };
+
+    using Generation = std::shared_ptr<std::atomic<int>>;
+
+    // model 的排版代数，工作线程持有同一个计数读取
+    Generation generation(ChatListModel* model);
+    void scheduleFlush();
+    void flush();
+    void apply(const QPointer<ChatListModel>& model, int maxBubbleWidth, int fontGeneration, int stamp,
+               const QVector<QPair<int, QSize>>& sizes);
+
+    QThreadPool m_pool;
+    QHash<const ChatListModel*, Generation> m_generations;
+    QVector<Pending> m_pending;
+    QVector<Changed> m_changed;
+    int m_syncBudget = SYNC_BUDGET;
+    bool m_flushScheduled = false;
+};
@@ -0,0 +1,105 @@
+#include "BubbleLayoutCache.h"
+
+namespace {
+    // 每个字符的字形、属性与折行数据的粗略开销
+    constexpr qint64 LAYOUT_BYTES_PER_CHAR = 32;
+}
+
+void BubbleLayoutCache::validate(int maxBubbleWidth, int fontGeneration)
+{
+    if (fontGeneration != m_fontGeneration) {
+        clear();
+        m_fontGeneration = fontGeneration;
+    }
+    if (!m_widths.isEmpty() && m_widths.last() == maxBubbleWidth)
+        return;
+    if (m_widths.removeOne(maxBubbleWidth)) {
+        m_widths.append(maxBubbleWidth);
+        return;
+    }
+    m_widths.append(maxBubbleWidth);
+    if (m_widths.size() <= MAX_WIDTHS)
+        return;
+    const quint32 stale = quint32(m_widths.takeFirst());
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (quint32(it.key()) == stale)
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+const BubbleLayoutCache::Entry* BubbleLayoutCache::find(int row, int maxBubbleWidth) const
+{
+    const auto it = m_entries.constFind(key(row, maxBubbleWidth));
+    return it == m_entries.constEnd() ? nullptr : &it.value();
+}
+
+void BubbleLayoutCache::insert(int row, int maxBubbleWidth, const Entry& entry)
+{
+    const quint64 entryKey = key(row, maxBubbleWidth);
+    Entry& slot = m_entries[entryKey];
+    const bool hadLayout = !slot.layout.isNull();
+    slot = entry;
+    if (entry.layout && !hadLayout) {
+        m_layoutOrder.enqueue(entryKey);
+        evictLayouts();
+    }
+}
+
+QSharedPointer<QTextLayout> BubbleLayoutCache::takeLayout()
+{
+    if (m_spareLayouts.isEmpty())
+        return QSharedPointer<QTextLayout>::create();
+    return m_spareLayouts.takeLast();
+}
+
+void BubbleLayoutCache::evictLayouts()
+{
+    while (m_layoutOrder.size() > MAX_LAYOUTS) {
+        const auto it = m_entries.find(m_layoutOrder.dequeue());
+        // 条目可能已随旧宽度清除，或被只有尺寸的条目替换
+        if (it == m_entries.end() || !it->layout)
+            continue;
+        if (m_spareLayouts.size() < MAX_SPARE_LAYOUTS)
+            m_spareLayouts.append(it->layout);
+        it->layout.reset();
+    }
+}
+
+bool BubbleLayoutCache::accepts(int maxBubbleWidth, int fontGeneration) const
+{
+    return fontGeneration == m_fontGeneration && m_widths.contains(maxBubbleWidth);
+}
+
+void BubbleLayoutCache::dropEstimated()
+{
+    // 估计的条目没有排版对象，不在 m_layoutOrder 中
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->estimated)
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void BubbleLayoutCache::clear()
+{
+    m_entries.clear();
+    m_layoutOrder.clear();
+    m_widths.clear();
+}
+
+qint64 BubbleLayoutCache::memoryUsage() const
+{
+    qint64 bytes = m_entries.size() * qint64(sizeof(quint64) + sizeof(Entry));
+    for (const Entry& entry : m_entries) {
+        if (entry.layout)
+            bytes += sizeof(QTextLayout) + entry.layout->text().size() * LAYOUT_BYTES_PER_CHAR;
+    }
+    for (const auto& layout : m_spareLayouts) {
+        bytes += sizeof(QTextLayout) + layout->text().size() * LAYOUT_BYTES_PER_CHAR;
+    }
+    bytes += m_layoutOrder.size() * qint64(sizeof(quint64));
+    return bytes;
+}
@@ -3,12 +3,26 @@
 #include "GroupRepository.h"
 #include "UserRepository.h"
 #include "MessageRepository.h"
+#include "MessageStore.h"
+#include "SendJournal.h"
+#include "NetworkService.h"
+#include "MessageId.h"
 #include "CurrentUser.h"
 #include <QVBoxLayout>
 #include <QScrollBar>
+#include <QItemSelectionModel>
 #include <QTimer>
 #include <QResizeEvent>
 #include <QDateTime>
+#include <utility>
+
+namespace {
+    // 没有连接服务器时不会有确认，发送日志落盘即为最终状态
+    DeliveryState committedState()
+    {
+        return NetworkService::instance().hasTransport() ? DeliveryState::Durable : DeliveryState::Acked;
+    }
+}
 
 ChatArea::ChatArea(QWidget *parent)
         : QWidget(parent)
@@ -28,6 +42,7 @@ ChatArea::ChatArea(QWidget *parent)
     // 创建模型和代理
     chatModel = new ChatListModel(this);
     chatDelegate = new ChatItemDelegate(this);
+    conversationCache.setMaxCost(MODEL_CACHE_MB * 1024);
     
     // 设置模型和代理
     chatView->setModel(chatModel);
@@ -87,6 +102,18 @@ ChatArea::ChatArea(QWidget *parent)
             this, &ChatArea::onSendImage);
     connect(inputBar, &FloatingInputBar::sendText,
             this, &ChatArea::onSendText);
+    // 先行显示的消息：发送日志落盘后、服务器确认后分别更新状态
+    connect(&SendJournal::instance(), &SendJournal::committed, this, [this](const QVector<quint64>& ids) {
+        chatModel->setDeliveryState(ids, committedState());
+    });
+    connect(&NetworkService::instance(), &NetworkService::messagesAcked, this, [this](const QVector<quint64>& ids) {
+        chatModel->setDeliveryState(ids, DeliveryState::Acked);
+    });
+    // 右键删除：视图中已移除，再按消息 id 从仓库删除（尚未入库的消息入库时即被删除）
+    connect(chatDelegate, &ChatItemDelegate::messageDeleted, this, [this](quint64 id) {
+        if (!messageId.isEmpty())
+            MessageRepository::instance().removeMessageById(messageId, id);
+    });
 
     // 设置样式
     chatView->setStyleSheet(
@@ -99,28 +126,20 @@ ChatArea::ChatArea(QWidget *parent)
 
 void ChatArea::addMessage(QSharedPointer<ChatMessage> message)
 {
-    bool shouldScroll = message->isFromMe() || isNearBottom();
-    // 添加消息
-    chatModel->addMessage(message);
-    MessageRepository::instance().addMessage(messageId, message);
-    emit sendMessage(messageId, message->getContent(), message->getTimestamp());
-
-    // 调整底部空白
-    adjustBottomSpace();
-    
-    // 根据情况处理滚动和未读计数
-    if (!message->isFromMe() && !shouldScroll) {
-        unreadMessageCount++;
-        updateNewMessageNotifier();
-    }
-    
-    // 如果需要滚动到底部，使用延时确保布局更新完成
-    if (shouldScroll) {
-        QTimer::singleShot(0, this, &ChatArea::scrollToBottom);
-    }
+    // 在发送端分配 id，本地入库与发给服务器的是同一个 id，服务器回放时据此去重
+    if (message->getMessageId() == 0)
+        message->setMessageId(MessageId::next());
+    // 先行显示，不等落盘；入库后 syncNewMessages 按 id 认出这一行，只补上序号
+    message->setDeliveryState(DeliveryState::Pending);
+    chatModel->addLocalMessage(message);
+    QTimer::singleShot(0, this, &ChatArea::scrollToBottom);
+    // 只编码一次：发给服务器的、写入发送日志的与入库的是同一份记录（含群聊、发送者名字与身份，图片带像素）
+    const QByteArray record = MessageStore::encode(*message, 0);
+    emit sendMessage(messageId, record, message->getMessageId());
+    // 交出后消息对象归写线程所有（入库时会写入序号），界面不再访问
+    SendJournal::instance().append(messageId, std::move(message), record);
 }
 
-
 void ChatArea::addImageMessage(QSharedPointer<ImageMessage> message,
                                const QDateTime& timestamp)
 {
@@ -143,9 +162,17 @@ void ChatArea::addImageMessage(QSharedPointer<ImageMessage> message,
     }
 }
 
-void ChatArea::onScrollValueChanged(int)
+void ChatArea::onScrollValueChanged(int value)
 {
     isAtBottom = isScrollAtBottom();
+
+    // 用户向上滚动到接近顶部时加载更早的消息
+    const int LOAD_MORE_THRESHOLD = 120;
+    if (value < lastScrollValue && value <= LOAD_MORE_THRESHOLD
+            && hasOlderMessages && !loadingOlderMessages) {
+        QTimer::singleShot(0, this, &ChatArea::loadOlderMessages);
+    }
+    lastScrollValue = value;
     
     if (isAtBottom) {
         unreadMessageCount = 0;
@@ -271,7 +298,7 @@ void ChatArea::updateInputBarPosition() {
 
 void ChatArea::onSendImage(const QString &path)
 {
-    QPixmap image(path);
+    QImage image(path);
     if (!image.isNull()) {
         auto ptr =
                 QSharedPointer<ImageMessage>::create(image,
@@ -304,6 +331,14 @@ void ChatArea::clearAll() {
 
 void ChatArea::setMessageId(QString id) {
     messageId = id;
+    // 网络线程写入的新消息经仓库的变更通知到达；首次打开会话时才接入，启动时不构造仓库
+    if (!repositoryConnection) {
+        repositoryConnection = connect(&MessageRepository::instance(), &MessageRepository::conversationsChanged,
+                                       this, [this](const QSet<QString>& ids) {
+            if (!messageId.isEmpty() && ids.contains(messageId))
+                syncNewMessages();
+        });
+    }
     if (isGroupMode) {
         auto group = GroupRepository::instance().getGroup(id);
         statusIcon->hide();
@@ -319,11 +354,173 @@ void ChatArea::setMessageId(QString id) {
     }
 }
 
-void ChatArea::initMessage(QVector<ChatArea::ChatMessagePtr>& messages) {
+void ChatArea::initMessage(const QVector<ChatArea::ChatMessagePtr>& messages) {
+    hasOlderMessages = false;
     clearAll();
     for (auto message : messages) {
         chatModel->addMessage(message);
     }
     adjustBottomSpace();
+    lastScrollValue = chatView->verticalScrollBar()->value();
+    // 首屏只有最新一页，凑满一页说明更早的消息可能还有
+    hasOlderMessages = messages.size() >= MESSAGE_PAGE_SIZE;
+    QTimer::singleShot(0, this, &ChatArea::ensureViewportFilled);
+    QTimer::singleShot(0, this, &ChatArea::scrollToBottom);
+}
+
+ChatListModel* ChatArea::replaceModel(ChatListModel* model)
+{
+    ChatListModel* previous = chatModel;
+    QItemSelectionModel* previousSelection = chatView->selectionModel();
+    model->setParent(this);
+    chatModel = model;
+    chatView->setModel(chatModel);
+    // 视图换模型时不会回收旧的选择模型
+    delete previousSelection;
+    return previous;
+}
+
+void ChatArea::adoptModel(ChatListModel* model)
+{
+    delete replaceModel(model);
+
+    adjustBottomSpace();
+    lastScrollValue = chatView->verticalScrollBar()->value();
+    // 与 initMessage 相同：预取的也是最新一页，凑满一页说明更早的消息可能还有
+    hasOlderMessages = chatModel->messageCount() >= MESSAGE_PAGE_SIZE;
+    QTimer::singleShot(0, this, &ChatArea::ensureViewportFilled);
+    QTimer::singleShot(0, this, &ChatArea::scrollToBottom);
+}
+
+void ChatArea::stashConversation()
+{
+    // 还有尚未落盘的本地消息时不缓存（只需几毫秒）；等待确认的消息由缓存的模型自己接收状态更新
+    if (messageId.isEmpty() || chatModel->messageCount() == 0 || chatModel->hasPendingMessages())
+        return;
+    auto* cached = new CachedConversation;
+    cached->scrollValue = chatView->verticalScrollBar()->value();
+    cached->atBottom = isScrollAtBottom();
+    cached->hasOlderMessages = hasOlderMessages;
+    cached->model = replaceModel(new ChatListModel(this));
+    cached->model->setParent(nullptr);
+    cached->model->clearSelection();
+    if (cached->model->hasLocalMessages())
+        followDeliveryState(cached->model);
+    // 代价按 KB 计，超出预算时淘汰最久没有打开的会话
+    const int cost = int(qMax<qint64>(1, cached->model->memoryUsage() / 1024));
+    conversationCache.insert(messageId, cached, cost);
+}
+
+bool ChatArea::restoreConversation(const QString& id)
+{
+    CachedConversation* cached = conversationCache.take(id);
+    if (!cached)
+        return false;
+    // 离开期间新到的消息超过一页时，缓存与最新一页之间可能有缺口，放弃缓存重新读取
+    const auto latest = MessageRepository::instance().fetchLatest(id, MESSAGE_PAGE_SIZE);
+    if (latest.size() >= MESSAGE_PAGE_SIZE && latest.first()->getSeq() > cached->model->lastSeq()) {
+        delete cached;
+        return false;
+    }
+
+    unfollowDeliveryState(cached->model);
+    delete replaceModel(cached->model);
+    cached->model = nullptr;
+    hasOlderMessages = cached->hasOlderMessages;
+    unreadMessageCount = 0;
+    updateNewMessageNotifier();
+    // 回到离开时的位置，原本停在底部的仍然停在底部
+    chatView->doItemsLayout();
+    if (cached->atBottom)
+        scrollToBottom();
+    else
+        chatView->verticalScrollBar()->setValue(cached->scrollValue);
+    isAtBottom = isScrollAtBottom();
+    lastScrollValue = chatView->verticalScrollBar()->value();
+    delete cached;
+    // 补上离开期间新到的消息
+    syncNewMessages();
+    return true;
+}
+
+void ChatArea::followDeliveryState(ChatListModel* model)
+{
+    connect(&SendJournal::instance(), &SendJournal::committed, model, [model](const QVector<quint64>& ids) {
+        model->setDeliveryState(ids, committedState());
+    });
+    connect(&NetworkService::instance(), &NetworkService::messagesAcked, model, [model](const QVector<quint64>& ids) {
+        model->setDeliveryState(ids, DeliveryState::Acked);
+    });
+}
+
+void ChatArea::unfollowDeliveryState(ChatListModel* model)
+{
+    // 成为当前模型后由 ChatArea 的连接更新
+    SendJournal::instance().disconnect(model);
+    NetworkService::instance().disconnect(model);
+}
+
+int ChatArea::layoutWidth() const
+{
+    // 还没排过版时按视口宽度估计，与实际行宽不符的预取在点击时会被放弃
+    const int width = chatDelegate->layoutWidth();
+    return width > 0 ? width : chatView->viewport()->width();
+}
+
+void ChatArea::syncNewMessages()
+{
+    const qint64 lastSeq = chatModel->lastSeq();
+    const auto latest = MessageRepository::instance().fetchLatest(messageId, MESSAGE_PAGE_SIZE);
+    const bool shouldScroll = isNearBottom();
+    int added = 0;
+    for (const auto& message : latest) {
+        if (message->getSeq() > lastSeq && chatModel->addMessage(message))
+            ++added;
+    }
+    if (added == 0)
+        return;
+
+    // 会话正在打开，新到的消息视为已读
+    MessageRepository::instance().markRead(messageId, chatModel->lastSeq());
+    adjustBottomSpace();
+    if (shouldScroll) {
+        QTimer::singleShot(0, this, &ChatArea::scrollToBottom);
+    } else {
+        unreadMessageCount += added;
+        updateNewMessageNotifier();
+    }
+}
+
+void ChatArea::loadOlderMessages()
+{
+    if (!hasOlderMessages || loadingOlderMessages)
+        return;
+    loadingOlderMessages = true;
+
+    // 历史消息只引用映射中的记录，滚动经过的行在绘制时才解析
+    auto older = MessageRepository::instance().mapRange(messageId, chatModel->firstSeq(),
+                                                        MESSAGE_PAGE_SIZE);
+    hasOlderMessages = older.size() >= MESSAGE_PAGE_SIZE;
+    if (!older.isEmpty()) {
+        QScrollBar* scrollBar = chatView->verticalScrollBar();
+        const int previousMaximum = scrollBar->maximum();
+        const int previousValue = scrollBar->value();
+        chatModel->prependRecords(older);
+        chatView->keepScrollAnchor(previousMaximum, previousValue);
+        lastScrollValue = scrollBar->value();
+    }
+
+    loadingOlderMessages = false;
+    ensureViewportFilled();
+}
+
+void ChatArea::ensureViewportFilled()
+{
+    // 内容不足一屏时无法通过滚动触发加载，直接补齐
+    chatView->doItemsLayout();
+    if (hasOlderMessages && !loadingOlderMessages
+            && chatView->verticalScrollBar()->maximum() <= 0) {
+        loadOlderMessages();
+    }
 }
 
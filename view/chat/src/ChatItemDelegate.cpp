@@ -14,8 +14,13 @@
 #include <QPainterPath>
 #include <QMenu>
 
+namespace {
+    int g_fontGeneration = 0;  // 见 ChatItemDelegate::fontGeneration
+}
+
 ChatItemDelegate::ChatItemDelegate(QObject* parent)
     : QStyledItemDelegate(parent)
+    , m_shaper(new TextShaper(this))
 {
 }
 
@@ -23,15 +28,62 @@ void ChatItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& opti
                            const QModelIndex& index) const
 {
     QVariant data = index.data(Qt::UserRole);
-    const ChatMessage* message = nullptr;
+    MessageView message;
     const TimeHeader* timeHeader = nullptr;
 
     if (data.canConvert<TimeHeader*>()) {
         timeHeader = data.value<TimeHeader*>();
-    } else if (data.canConvert<ChatMessage*>()) {
-        message = data.value<ChatMessage*>();
+    } else if (data.canConvert<MessageView>()) {
+        message = data.value<MessageView>();
+    }
+
+    // 文本消息与时间标识整行画进位图缓存，之后的帧直接贴图；图片消息本身就是贴图，不缓存
+    const bool cacheable = timeHeader || (message.isValid() && message.getType() == MessageType::Text);
+    if (!m_rowCacheEnabled || !cacheable || option.rect.isEmpty()) {
+        paintRow(painter, option, index, message, timeHeader);
+        return;
+    }
+
+    RowPixmapCache::Key key;
+    key.size = option.rect.size();
+    key.devicePixelRatio = painter->device() ? painter->device()->devicePixelRatioF() : qreal(1);
+    key.state = int(option.state & (QStyle::State_Selected | QStyle::State_MouseOver));
+    key.palette = option.palette.cacheKey();
+    key.fontGeneration = fontGeneration();
+    if (timeHeader) {
+        key.header = timeHeader->text;
+    } else {
+        const auto* chatModel = qobject_cast<const ChatListModel*>(index.model());
+        if (!chatModel) {
+            paintRow(painter, option, index, message, timeHeader);
+            return;
+        }
+        key.renderId = chatModel->renderId();
+        key.row = message.row();
+        key.state |= (message.getIsSelected() ? 1 : 0) << 16
+                | int(message.getDeliveryState()) << 17;
+        key.avatar = UserRepository::instance().getAvatar(message.senderHandle()).cacheKey();
     }
 
+    if (const QPixmap* cached = m_rowPixmaps.find(key)) {
+        painter->drawPixmap(option.rect.topLeft(), *cached);
+        return;
+    }
+    // 位图的原点对准行的左上角，行内按原来的坐标绘制
+    QPixmap pixmap(option.rect.size() * key.devicePixelRatio);
+    pixmap.setDevicePixelRatio(key.devicePixelRatio);
+    pixmap.fill(Qt::transparent);
+    QPainter rowPainter(&pixmap);
+    rowPainter.translate(-option.rect.topLeft());
+    paintRow(&rowPainter, option, index, message, timeHeader);
+    rowPainter.end();
+    m_rowPixmaps.insert(key, pixmap);
+    painter->drawPixmap(option.rect.topLeft(), pixmap);
+}
+
+void ChatItemDelegate::paintRow(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index,
+                                const MessageView& message, const TimeHeader* timeHeader) const
+{
     painter->save();
     painter->setRenderHint(QPainter::Antialiasing);
 
@@ -44,20 +96,23 @@ void ChatItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& opti
             TIME_HEADER_HEIGHT          // height
         );
         drawTimeHeader(painter, timeHeaderRect, timeHeader->text);
-    } else if (message) {
+    } else if (message.isValid()) {
         // 计算气泡最大宽度（窗口宽度的70%）
-        int maxBubbleWidth = option.rect.width() * 0.7;
-        bool isFromMe = message->isFromMe();
+        int maxBubbleWidth = ChatItemDelegate::maxBubbleWidth(option.rect.width());
+        bool isFromMe = message.isFromMe();
 
         // 绘制头像
         QRect avatarRect = calculateAvatarRect(option.rect, isFromMe);
-        drawAvatar(painter, avatarRect, message->getSenderId());
+        drawAvatar(painter, avatarRect, message.senderHandle());
 
-        // 计算气泡位置
-        QRect bubbleRect = calculateBubbleRect(option.rect, message, maxBubbleWidth, isFromMe);
+        // 计算气泡位置；文本消息先取出排版，定位与绘制共用
+        BubbleLayoutCache::Entry text;
+        if (message.getType() == MessageType::Text)
+            text = textLayout(index.model(), message, maxBubbleWidth, Measure::Exact);
+        QRect bubbleRect = calculateBubbleRect(option.rect, index.model(), message, maxBubbleWidth, isFromMe);
 
         // 如果是群聊消息，绘制群成员信息
-        if (message->isInGroupChat()) {
+        if (message.isInGroupChat()) {
             QRect groupInfoRect = bubbleRect;
             groupInfoRect.setHeight(NAME_HEIGHT);
 
@@ -70,7 +125,9 @@ void ChatItemDelegate::paint(QPainter* painter, const QStyleOptionViewItem& opti
             bubbleRect.moveTop(bubbleRect.top() + NAME_HEIGHT + 5);
         }
         // 绘制气泡
-        drawBubble(painter, bubbleRect, isFromMe, message, message->getIsSelected());
+        drawBubble(painter, bubbleRect, isFromMe, message, message.getIsSelected(), text.layout.data());
+        if (isFromMe && message.getDeliveryState() != DeliveryState::Acked)
+            drawDeliveryState(painter, bubbleRect, message.getDeliveryState());
     }
     painter->restore();
 }
@@ -90,15 +147,15 @@ bool ChatItemDelegate::editorEvent(QEvent* event, QAbstractItemModel* model,
             }
         }
 
-        const ChatMessage* message = index.data(Qt::UserRole).value<ChatMessage*>();
-        if (!message) return false;
+        const MessageView message = index.data(Qt::UserRole).value<MessageView>();
+        if (!message.isValid()) return false;
 
         // 计算气泡区域
-        int maxBubbleWidth = option.rect.width() * 0.7;
-        QRect bubbleRect = calculateBubbleRect(option.rect, message, maxBubbleWidth, message->isFromMe());
+        int maxBubbleWidth = ChatItemDelegate::maxBubbleWidth(option.rect.width());
+        QRect bubbleRect = calculateBubbleRect(option.rect, model, message, maxBubbleWidth, message.isFromMe());
 
         // 如果是群聊消息，需要考虑名字区域的偏移
-        if (message->isInGroupChat()) {
+        if (message.isInGroupChat()) {
             bubbleRect.moveTop(bubbleRect.top() + NAME_HEIGHT + 5);
         }
 
@@ -122,10 +179,9 @@ bool ChatItemDelegate::editorEvent(QEvent* event, QAbstractItemModel* model,
     } else if (event->type() == QEvent::KeyPress) {
         QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
         if (keyEvent->matches(QKeySequence::Copy)) {
-            const ChatMessage* message = index.data(Qt::UserRole).value<ChatMessage*>();
-            if (message && message->getType() == MessageType::Text && message->getIsSelected()) {
-                const TextMessage* textMessage = static_cast<const TextMessage*>(message);
-                QApplication::clipboard()->setText(textMessage->getText());
+            const MessageView message = index.data(Qt::UserRole).value<MessageView>();
+            if (message.isValid() && message.getType() == MessageType::Text && message.getIsSelected()) {
+                QApplication::clipboard()->setText(message.getText());
                 return true;
             }
         }
@@ -134,7 +190,8 @@ bool ChatItemDelegate::editorEvent(QEvent* event, QAbstractItemModel* model,
 }
 
 void ChatItemDelegate::drawBubble(QPainter* painter, const QRect& rect,
-                                 bool isFromMe, const ChatMessage* message, bool isSelected) const
+                                 bool isFromMe, const MessageView& message, bool isSelected,
+                                 const QTextLayout* layout) const
 {
     // 设置气泡颜色
     QColor bubbleColor;
@@ -154,31 +211,44 @@ void ChatItemDelegate::drawBubble(QPainter* painter, const QRect& rect,
     painter->drawPath(path);
 
     // 根据消息类型绘制内容
-    if (message->getType() == MessageType::Text) {
-        drawTextMessage(painter, rect, message->getContent(), isFromMe, isSelected);
-    } else if (message->getType() == MessageType::Image) {
-        const ImageMessage* imgMsg = static_cast<const ImageMessage*>(message);
-        drawImageMessage(painter, rect, imgMsg->getImage(), isFromMe);
+    if (message.getType() == MessageType::Text && layout) {
+        drawTextMessage(painter, rect, *layout, isFromMe, isSelected);
+    } else if (message.getType() == MessageType::Image) {
+        drawImageMessage(painter, rect, message.getImage(), isFromMe);
     }
 }
 
 
+void ChatItemDelegate::drawDeliveryState(QPainter* painter, const QRect& bubbleRect,
+                                         DeliveryState state) const
+{
+    const QRect mark(bubbleRect.left() - DELIVERY_MARK_SIZE - 6,
+                     bubbleRect.bottom() - DELIVERY_MARK_SIZE - 4,
+                     DELIVERY_MARK_SIZE, DELIVERY_MARK_SIZE);
+    const QColor color(0xb0b0b0);
+    if (state == DeliveryState::Pending) {
+        painter->setPen(QPen(color, 1.5));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawEllipse(mark.adjusted(1, 1, -1, -1));
+    } else {
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(color);
+        painter->drawEllipse(mark.adjusted(2, 2, -2, -2));
+    }
+}
+
 void ChatItemDelegate::drawAvatar(QPainter* painter, const QRect& rect,
-                                  const QString& userID) const
+                                  StringHandle userID) const
 {
     painter->drawPixmap(rect, UserRepository::instance().getAvatar(userID));
 }
 
 void ChatItemDelegate::drawTextMessage(QPainter* painter, const QRect& rect,
-                                     const QString& text, bool isFromMe, bool isSelected) const
+                                     const QTextLayout& layout, bool isFromMe, bool isSelected) const
 {
     QRect textRect = rect.adjusted(BUBBLE_PADDING, BUBBLE_PADDING,
                                  -BUBBLE_PADDING, -BUBBLE_PADDING);
 
-    QTextOption option;
-    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
-    option.setAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-
     QColor textColor;
     if (isFromMe) {
         textColor = isSelected ? Qt::white : Qt::white;
@@ -187,32 +257,10 @@ void ChatItemDelegate::drawTextMessage(QPainter* painter, const QRect& rect,
     }
     painter->setPen(textColor);
 
-    // 设置更大的字体
-    QFont messageFont = QApplication::font();
-    messageFont.setPixelSize(14);  // 设置字体大小为14像素
-    painter->setFont(messageFont);
-
-    QTextLayout textLayout(text, messageFont);
-    textLayout.setTextOption(option);
-
-    // 计算文本布局
-    qreal height = 0;
-    textLayout.beginLayout();
-    forever {
-        QTextLine line = textLayout.createLine();
-        if (!line.isValid())
-            break;
-
-        line.setLineWidth(textRect.width());
-        line.setPosition(QPointF(0, height));
-        height += line.height();
-    }
-    textLayout.endLayout();
-
-    // 绘制文本
+    // 排版已在缓存中折好行，这里只绘制
     painter->save();
     painter->translate(textRect.left(), textRect.top());
-    textLayout.draw(painter, QPointF(0, 0));
+    layout.draw(painter, QPointF(0, 0));
     painter->restore();
 }
 
@@ -233,7 +281,7 @@ void ChatItemDelegate::drawImageMessage(QPainter* painter, const QRect& rect,
 }
 
 void ChatItemDelegate::drawGroupInfo(QPainter* painter, const QRect& rect,
-                                   const ChatMessage* message) const
+                                   const MessageView& message) const
 {
     painter->save();
 
@@ -243,9 +291,9 @@ void ChatItemDelegate::drawGroupInfo(QPainter* painter, const QRect& rect,
     painter->setFont(nameFont);
 
     // 获取成员名字
-    QString name = message->getSenderName();
+    QString name = message.getSenderName();
     if (name.isEmpty()) {
-        name = message->getSenderId();
+        name = message.getSenderId();
     }
 
     // 限制名字长度
@@ -259,7 +307,7 @@ void ChatItemDelegate::drawGroupInfo(QPainter* painter, const QRect& rect,
     painter->drawText(nameRect, Qt::AlignLeft | Qt::AlignVCenter, elidedName);
 
     // 如果有特殊身份（群主或管理员），绘制身份标签
-    GroupRole role = message->getRole();
+    GroupRole role = message.getRole();
     if (role != GroupRole::Member) {
         QString roleText = (role == GroupRole::Owner) ? "群主" : "管理员";
         QColor bgColor = (role == GroupRole::Owner) ? QColor(0xF5DDCB) : QColor(0xC2E1F5);
@@ -286,7 +334,7 @@ void ChatItemDelegate::drawGroupInfo(QPainter* painter, const QRect& rect,
 }
 
 void ChatItemDelegate::drawGroupInfoForMe(QPainter* painter, const QRect& rect,
-                                        const ChatMessage* message) const
+                                        const MessageView& message) const
 {
     painter->save();
 
@@ -297,9 +345,9 @@ void ChatItemDelegate::drawGroupInfoForMe(QPainter* painter, const QRect& rect,
     QFontMetrics fm(nameFont);
 
     // 获取成员名字
-    QString name = message->getSenderName();
+    QString name = message.getSenderName();
     if (name.isEmpty()) {
-        name = message->getSenderId();
+        name = message.getSenderId();
     }
     QString elidedName = fm.elidedText(name, Qt::ElideRight, NAME_MAX_WIDTH);
     // 计算总宽度，确保右对齐到头像位置
@@ -308,7 +356,7 @@ void ChatItemDelegate::drawGroupInfoForMe(QPainter* painter, const QRect& rect,
     int roleWidth = 0;
 
     // 如果有特殊身份，计算身份标签宽度
-    GroupRole role = message->getRole();
+    GroupRole role = message.getRole();
     if (role != GroupRole::Member) {
         roleText = (role == GroupRole::Owner) ? "群主" : "管理员";
         roleWidth = fm.horizontalAdvance(roleText) + 2 * ROLE_PADDING;
@@ -353,15 +401,21 @@ void ChatItemDelegate::drawGroupInfoForMe(QPainter* painter, const QRect& rect,
 
 QSize ChatItemDelegate::sizeHint(const QStyleOptionViewItem& option,
                                 const QModelIndex& index) const
+{
+    return rowSize(option, index, Measure::Budgeted);
+}
+
+QSize ChatItemDelegate::rowSize(const QStyleOptionViewItem& option, const QModelIndex& index,
+                                Measure measure) const
 {
     QVariant data = index.data(Qt::UserRole);
-    const ChatMessage* message = nullptr;
+    MessageView message;
     const TimeHeader* timeHeader = nullptr;
 
     if (data.canConvert<TimeHeader*>()) {
         timeHeader = data.value<TimeHeader*>();
-    } else if (data.canConvert<ChatMessage*>()) {
-        message = data.value<ChatMessage*>();
+    } else if (data.canConvert<MessageView>()) {
+        message = data.value<MessageView>();
     } else if (data.canConvert<int>()) {
         // 处理底部空白项
         int height = data.toInt();
@@ -371,56 +425,31 @@ QSize ChatItemDelegate::sizeHint(const QStyleOptionViewItem& option,
     if (timeHeader) {
         // 时间标识的高度（包括上下间距）
         return QSize(option.rect.width(), TIME_HEADER_HEIGHT + 12);  // 12是上下各6像素的间距
-    } else if (message) {
-        int maxBubbleWidth = option.rect.width() * 0.7;
-
-        // 使用更大的字体
-        QFont messageFont = QApplication::font();
-        messageFont.setPixelSize(14);
-        QFontMetrics fm(messageFont);
+    } else if (message.isValid()) {
+        m_layoutWidth = option.rect.width();
+        int maxBubbleWidth = ChatItemDelegate::maxBubbleWidth(option.rect.width());
 
         int height = AVATAR_SIZE + 2 * BUBBLE_MARGIN;
         int bubbleHeight = 0;
 
         // 如果是群聊消息，需要额外的空间显示群成员信息
-        if (message->isInGroupChat()) {
+        if (message.isInGroupChat()) {
             height += NAME_HEIGHT;  // 名字高度 + 5像素间距
         }
 
-        if (message->getType() == MessageType::Text) {
-            QString text = message->getContent();
-
-            QTextLayout textLayout(text, messageFont);
-            QTextOption textOption;
-            textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
-            textLayout.setTextOption(textOption);
-
-            qreal textHeight = 0;
-            textLayout.beginLayout();
-            forever {
-                QTextLine line = textLayout.createLine();
-                if (!line.isValid())
-                    break;
-
-                line.setLineWidth(maxBubbleWidth - 2 * BUBBLE_PADDING);
-                line.setPosition(QPointF(0, textHeight));
-                textHeight += line.height();
-            }
-            textLayout.endLayout();
-
-            bubbleHeight = qCeil(textHeight) + 2 * BUBBLE_PADDING;
-            if (message->isInGroupChat()) {
+        if (message.getType() == MessageType::Text) {
+            bubbleHeight = textLayout(index.model(), message, maxBubbleWidth, measure).bubble.height();
+            if (message.isInGroupChat()) {
                 bubbleHeight += NAME_HEIGHT;
             }
-        } else if (message->getType() == MessageType::Image) {
-            const ImageMessage* imgMsg = static_cast<const ImageMessage*>(message);
-            QPixmap image = imgMsg->getImage();
+        } else if (message.getType() == MessageType::Image) {
+            QPixmap image = message.getImage();
             if (!image.isNull()) {
                 QSize scaledSize = image.size().scaled(maxBubbleWidth - 2 * BUBBLE_PADDING,
                                                      200, Qt::KeepAspectRatio);
                 bubbleHeight = scaledSize.height() + 2 * BUBBLE_PADDING;
             }
-            if (message->isInGroupChat()) {
+            if (message.isInGroupChat()) {
                 bubbleHeight += 20; // 群图片消息空隙补偿
             }
         }
@@ -432,46 +461,150 @@ QSize ChatItemDelegate::sizeHint(const QStyleOptionViewItem& option,
     return QSize(0, 0);
 }
 
-QRect ChatItemDelegate::calculateBubbleRect(const QRect& contentRect,
-                                          const ChatMessage* message,
-                                          int maxWidth, bool isFromMe) const
+QFont ChatItemDelegate::messageFont()
 {
     // 使用更大的字体
-    QFont messageFont = QApplication::font();
-    messageFont.setPixelSize(14);
-    QFontMetrics fm(messageFont);
+    QFont font = QApplication::font();
+    font.setPixelSize(14);
+    return font;
+}
 
-    int bubbleWidth = 0;
-    int bubbleHeight = 0;
+QSize ChatItemDelegate::measureTextBubble(const QString& text, const QFont& font, int maxBubbleWidth)
+{
+    QTextLayout textLayout(text, font);
+    return layoutLines(textLayout, maxBubbleWidth);
+}
+
+QSize ChatItemDelegate::layoutLines(QTextLayout& textLayout, int maxBubbleWidth)
+{
+    // 使用QTextLayout计算实际文本高度
+    QTextOption textOption;
+    textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    textLayout.setTextOption(textOption);
+
+    qreal textHeight = 0;
+    qreal textWidth = 0;
+    textLayout.beginLayout();
+    forever {
+        QTextLine line = textLayout.createLine();
+        if (!line.isValid())
+            break;
+
+        line.setLineWidth(maxBubbleWidth - 2 * BUBBLE_PADDING);
+        line.setPosition(QPointF(0, textHeight));
+        textHeight += line.height();
+        textWidth = qMax(textWidth, line.naturalTextWidth());
+    }
+    textLayout.endLayout();
+
+    return QSize(qCeil(textWidth) + 2 * BUBBLE_PADDING, qCeil(textHeight) + 2 * BUBBLE_PADDING);
+}
+
+void ChatItemDelegate::setRowCacheEnabled(bool enabled)
+{
+    m_rowCacheEnabled = enabled;
+    if (!enabled)
+        m_rowPixmaps.clear();
+}
+
+int ChatItemDelegate::fontGeneration()
+{
+    return g_fontGeneration;
+}
 
-    if (message->getType() == MessageType::Text) {
-        // 使用QTextLayout计算实际文本高度
-        QString text = message->getContent();
-        QTextLayout textLayout(text, messageFont);
-        QTextOption textOption;
-        textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
-        textLayout.setTextOption(textOption);
-
-        qreal textHeight = 0;
-        qreal textWidth = 0;
-        textLayout.beginLayout();
-        forever {
-            QTextLine line = textLayout.createLine();
-            if (!line.isValid())
-                break;
-
-            line.setLineWidth(maxWidth - 2 * BUBBLE_PADDING);
-            line.setPosition(QPointF(0, textHeight));
-            textHeight += line.height();
-            textWidth = qMax(textWidth, line.naturalTextWidth());
+void ChatItemDelegate::invalidateFonts()
+{
+    ++g_fontGeneration;
+}
+
+void ChatItemDelegate::cancelShaping(ChatListModel* model)
+{
+    m_shaper->cancel(model);
+    model->layoutCache().dropEstimated();
+}
+
+BubbleLayoutCache::Entry ChatItemDelegate::textLayout(const QAbstractItemModel* model, const MessageView& message,
+                                                      int maxWidth, Measure measure) const
+{
+    auto* chatModel = const_cast<ChatListModel*>(qobject_cast<const ChatListModel*>(model));
+    BubbleLayoutCache* cache = chatModel ? &chatModel->layoutCache() : nullptr;
+    if (cache) {
+        cache->validate(maxWidth, fontGeneration());
+        if (const BubbleLayoutCache::Entry* cached = cache->find(message.row(), maxWidth)) {
+            if (cached->layout || measure != Measure::Exact)
+                return *cached;
+        } else if (measure == Measure::Estimated) {
+            // 只估计，不写入缓存，进入视口附近时再按 Deferred 排入后台
+            BubbleLayoutCache::Entry entry;
+            entry.bubble = estimateTextBubble(message.getContent(), QFontMetrics(messageFont()), maxWidth);
+            entry.estimated = true;
+            return entry;
+        } else if (measure == Measure::Deferred
+                   || (measure == Measure::Budgeted && !m_shaper->takeSyncBudget())) {
+            // 先按字数估计，折行交给后台
+            BubbleLayoutCache::Entry entry;
+            const QString text = message.getContent();
+            entry.bubble = estimateTextBubble(text, QFontMetrics(messageFont()), maxWidth);
+            entry.estimated = true;
+            cache->insert(message.row(), maxWidth, entry);
+            m_shaper->request(chatModel, message.row(), text, maxWidth);
+            return entry;
+        }
+    }
+
+    // 排版对象优先用缓存收回的，滚动长会话时不反复分配
+    BubbleLayoutCache::Entry entry;
+    entry.layout = cache ? cache->takeLayout() : QSharedPointer<QTextLayout>::create();
+    entry.layout->setText(message.getContent());
+    entry.layout->setFont(messageFont());
+    entry.bubble = layoutLines(*entry.layout, maxWidth);
+    if (cache)
+        cache->insert(message.row(), maxWidth, entry);
+    return entry;
+}
+
+QSize ChatItemDelegate::estimateTextBubble(const QString& text, const QFontMetrics& metrics, int maxBubbleWidth)
+{
+    // 宽字符（中日韩等）按一个汉字的宽度，其余按平均字宽，逐字累加模拟折行
+    const qreal lineWidth = qMax(1, maxBubbleWidth - 2 * BUBBLE_PADDING);
+    const qreal wideAdvance = metrics.horizontalAdvance(QChar(0x4E00));
+    const qreal narrowAdvance = metrics.averageCharWidth();
+    qreal advance = 0;
+    qreal widest = 0;
+    int lines = 1;
+    for (const QChar ch : text) {
+        if (ch == QLatin1Char('\n')) {
+            widest = qMax(widest, advance);
+            advance = 0;
+            ++lines;
+            continue;
+        }
+        const qreal charAdvance = ch.unicode() >= 0x2E80 ? wideAdvance : narrowAdvance;
+        if (advance + charAdvance > lineWidth) {
+            widest = lineWidth;
+            advance = 0;
+            ++lines;
         }
-        textLayout.endLayout();
+        advance += charAdvance;
+    }
+    widest = qMax(widest, advance);
+    return QSize(qCeil(widest) + 2 * BUBBLE_PADDING, lines * metrics.height() + 2 * BUBBLE_PADDING);
+}
+
+QRect ChatItemDelegate::calculateBubbleRect(const QRect& contentRect,
+                                          const QAbstractItemModel* model,
+                                          const MessageView& message,
+                                          int maxWidth, bool isFromMe) const
+{
+    int bubbleWidth = 0;
+    int bubbleHeight = 0;
 
-        bubbleWidth = qCeil(textWidth) + 2 * BUBBLE_PADDING;
-        bubbleHeight = qCeil(textHeight) + 2 * BUBBLE_PADDING;
-    } else if (message->getType() == MessageType::Image) {
-        const ImageMessage* imgMsg = static_cast<const ImageMessage*>(message);
-        QPixmap image = imgMsg->getImage();
+    if (message.getType() == MessageType::Text) {
+        const QSize bubble = textLayout(model, message, maxWidth, Measure::Budgeted).bubble;
+        bubbleWidth = bubble.width();
+        bubbleHeight = bubble.height();
+    } else if (message.getType() == MessageType::Image) {
+        QPixmap image = message.getImage();
         if (!image.isNull()) {
             QSize scaledSize = image.size().scaled(maxWidth - 2 * BUBBLE_PADDING,
                                                  200, Qt::KeepAspectRatio);
@@ -496,16 +629,16 @@ QRect ChatItemDelegate::calculateAvatarRect(const QRect& contentRect,
 }
 
 void ChatItemDelegate::showContextMenu(const QPoint& pos, const QModelIndex& index,
-                                     const ChatMessage* message) const
+                                     const MessageView& message) const
 {
     TransparentMenu* menu = new TransparentMenu(qobject_cast<QWidget*>(parent()));
 
     // 添加复制选项
-    if (message->getType() == MessageType::Text) {
+    if (message.getType() == MessageType::Text) {
         QAction* copyAction = menu->addAction("复制");
-        connect(copyAction, &QAction::triggered, [message, index, model = const_cast<QAbstractItemModel*>(index.model())]() {
-            const TextMessage* textMessage = static_cast<const TextMessage*>(message);
-            QApplication::clipboard()->setText(textMessage->getText());
+        // 视图只在模型存活期间有效，菜单弹出时先取出文本
+        connect(copyAction, &QAction::triggered, [text = message.getText(), index, model = const_cast<QAbstractItemModel*>(index.model())]() {
+            QApplication::clipboard()->setText(text);
             // 取消选中状态
             NotificationManager::instance()
                     .showMessage("复制成功！", NotificationManager::Success, CurrentUser::instance().getMainWindow());
@@ -516,9 +649,11 @@ void ChatItemDelegate::showContextMenu(const QPoint& pos, const QModelIndex& ind
 
     // 添加删除选项
     QAction* deleteAction = menu->addAction("删除");
-    connect(deleteAction, &QAction::triggered, [index, model = index.model()]() {
+    connect(deleteAction, &QAction::triggered, this, [this, index, messageId = message.getMessageId(), model = index.model()]() {
         if (ChatListModel* chatModel = qobject_cast<ChatListModel*>(const_cast<QAbstractItemModel*>(model))) {
             chatModel->removeMessage(index.row());
+            // 存储中的删除由持有会话 id 的一方完成
+            emit const_cast<ChatItemDelegate*>(this)->messageDeleted(messageId);
             NotificationManager::instance()
                     .showMessage("删除成功！", NotificationManager::Success, CurrentUser::instance().getMainWindow());
         }
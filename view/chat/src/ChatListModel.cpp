@@ -3,13 +3,21 @@
 #include <QDebug>
 
 Q_DECLARE_METATYPE(TimeHeader*)
-Q_DECLARE_METATYPE(ChatMessage*)
+
+namespace {
+    quint64 nextRenderId()
+    {
+        static quint64 renderId = 0;
+        return ++renderId;
+    }
+}
 
 ChatListModel::ChatListModel(QObject* parent)
     : QAbstractListModel(parent)
+    , renderSerial(nextRenderId())
 {
     qRegisterMetaType<TimeHeader*>();
-    qRegisterMetaType<ChatMessage*>();
+    qRegisterMetaType<MessageView>();
 }
 
 int ChatListModel::rowCount(const QModelIndex& parent) const
@@ -32,7 +40,7 @@ QVariant ChatListModel::data(const QModelIndex& index, int role) const
         } else if (item.isBottomSpace) {
             return QVariant::fromValue<int>(item.bottomSpaceHeight);
         } else {
-            return QVariant::fromValue<ChatMessage*>(item.message.get());
+            return QVariant::fromValue(messages.at(item.message));
         }
     } else if (role == Qt::SizeHintRole && item.isBottomSpace) {
         return QSize(0, item.bottomSpaceHeight);
@@ -51,17 +59,17 @@ bool ChatListModel::setData(const QModelIndex& index, const QVariant& value, int
         if (selected && selectedMessageIndex != index.row()) {
             // 清除之前选中的消息
             if (selectedMessageIndex >= 0) {
-                items[selectedMessageIndex].message->setSelected(false);
+                messages.setSelected(items[selectedMessageIndex].message, false);
                 QModelIndex prevIndex = this->index(selectedMessageIndex);
                 emit dataChanged(prevIndex, prevIndex);
             }
             // 设置新选中的消息
-            items[index.row()].message->setSelected(true);
+            messages.setSelected(items[index.row()].message, true);
             selectedMessageIndex = index.row();
         } else if (!selected) {
             // 清除选中状态
             if (selectedMessageIndex >= 0) {
-                items[selectedMessageIndex].message->setSelected(false);
+                messages.setSelected(items[selectedMessageIndex].message, false);
                 selectedMessageIndex = -1;
             }
         }
@@ -78,12 +86,22 @@ Qt::ItemFlags ChatListModel::flags(const QModelIndex& index) const
     return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
 }
 
-void ChatListModel::addMessage(QSharedPointer<ChatMessage> message)
+bool ChatListModel::addMessage(QSharedPointer<ChatMessage> message)
 {
     // 确保消息有有效的时间戳
     if (!message || !message->getTimestamp().isValid()) {
         qDebug() << "Warning: Attempting to add message with invalid timestamp";
-        return;
+        return false;
+    }
+    newestSeq = qMax(newestSeq, message->getSeq());
+
+    // 本地先行显示的消息入库后回到这里，只补上序号
+    auto local = localRows.find(message->getMessageId());
+    if (message->getMessageId() != 0 && local != localRows.end()) {
+        messages.setSeq(local.value(), message->getSeq());
+        if (messages.at(local.value()).getDeliveryState() == DeliveryState::Acked)
+            localRows.erase(local);
+        return false;
     }
 
     // 如果有底部空白，先移除它
@@ -99,8 +117,8 @@ void ChatListModel::addMessage(QSharedPointer<ChatMessage> message)
         // 获取最后一个消息的时间戳
         QDateTime lastTime;
         for (auto it = items.rbegin(); it != items.rend(); ++it) {
-            if (!it->isHeader && !it->isBottomSpace && it->message) {
-                lastTime = it->message->getTimestamp();
+            if (!it->isHeader && !it->isBottomSpace && it->message >= 0) {
+                lastTime = messages.at(it->message).getTimestamp();
                 if (lastTime.isValid()) {
                     needTimeHeader = shouldAddTimeHeader(lastTime, message->getTimestamp());
                     break;
@@ -112,13 +130,7 @@ void ChatListModel::addMessage(QSharedPointer<ChatMessage> message)
     // 如果是第一条消息或需要添加时间标识，添加时间标识
     if (items.empty() || needTimeHeader) {
         beginInsertRows(QModelIndex(), items.size(), items.size());
-        ListItem timeItem;
-        timeItem.isHeader = true;
-        timeItem.timeHeader = QSharedPointer<TimeHeader>::create();
-        timeItem.timeHeader->timestamp = message->getTimestamp();
-        timeItem.timeHeader->type = getTimeHeaderType(message->getTimestamp());
-        timeItem.timeHeader->text = formatTimeHeader(message->getTimestamp());
-        items.push_back(timeItem);
+        items.push_back(makeTimeHeader(message->getTimestamp()));
         endInsertRows();
     }
 
@@ -126,25 +138,174 @@ void ChatListModel::addMessage(QSharedPointer<ChatMessage> message)
     beginInsertRows(QModelIndex(), items.size(), items.size());
     ListItem messageItem;
     messageItem.isHeader = false;
-    messageItem.message = std::move(message);
+    messageItem.message = messages.append(*message);
     items.push_back(std::move(messageItem));
+    // 追加不改变已有消息所在的行
+    if (messageItemsValid) {
+        messageItems.resize(messages.size(), -1);
+        messageItems[items.back().message] = int(items.size()) - 1;
+    }
     endInsertRows();
 
     // 确保底部空白存在
     ensureBottomSpace();
+    return true;
 }
 
-const ChatMessage* ChatListModel::messageAt(int index) const
+bool ChatListModel::addLocalMessage(QSharedPointer<ChatMessage> message)
 {
-    if (index >= 0 && index < static_cast<int>(items.size()) && !items[index].isHeader)
-        return items[index].message.get();
-    return nullptr;
+    const int row = messages.size();
+    if (!addMessage(message))
+        return false;
+    if (message->getMessageId() != 0)
+        localRows.insert(message->getMessageId(), row);
+    return true;
+}
+
+bool ChatListModel::hasPendingMessages() const
+{
+    for (int row : localRows) {
+        if (messages.at(row).getDeliveryState() == DeliveryState::Pending)
+            return true;
+    }
+    return false;
+}
+
+void ChatListModel::setDeliveryState(const QVector<quint64>& messageIds, DeliveryState state)
+{
+    for (quint64 messageId : messageIds) {
+        auto local = localRows.find(messageId);
+        if (local == localRows.end())
+            continue;
+        const int row = local.value();
+        const MessageView message = messages.at(row);
+        // 状态只前进：确认可能先于落盘通知到达
+        if (int(message.getDeliveryState()) >= int(state))
+            continue;
+        messages.setDeliveryState(row, state);
+        if (state == DeliveryState::Acked && message.getSeq() >= 0)
+            localRows.erase(local);
+        const int index = rowOfMessage(row);
+        if (index >= 0) {
+            const QModelIndex changed = this->index(index);
+            emit dataChanged(changed, changed);
+        }
+    }
+}
+
+int ChatListModel::prependMessages(const QVector<QSharedPointer<ChatMessage>>& messages)
+{
+    QVector<MessageStore::MappedRecord> records;
+    records.reserve(messages.size());
+    for (const auto& message : messages) {
+        MessageStore::MappedRecord record;
+        record.message = message;
+        records.push_back(std::move(record));
+    }
+    return prependRecords(records);
+}
+
+int ChatListModel::prependRecords(const QVector<MessageStore::MappedRecord>& records)
+{
+    // 先在临时列表里排好消息和时间标识
+    QVector<ListItem> head;
+    QDateTime prevTime;
+    for (const auto& record : records) {
+        int row = -1;
+        if (record.message) {
+            if (record.message->getTimestamp().isValid())
+                row = messages.append(*record.message);
+        } else {
+            row = messages.appendRecord(record.segment, record.offset, record.length);
+        }
+        if (row < 0)
+            continue;
+        newestSeq = qMax(newestSeq, messages.at(row).getSeq());
+        const QDateTime timestamp = messages.at(row).getTimestamp();
+        if (!prevTime.isValid() || shouldAddTimeHeader(prevTime, timestamp))
+            head.push_back(makeTimeHeader(timestamp));
+        ListItem messageItem;
+        messageItem.message = row;
+        head.push_back(std::move(messageItem));
+        prevTime = timestamp;
+    }
+    if (head.isEmpty())
+        return 0;
+
+    // 原先的第一条消息与新插入的最后一条相隔很近时，它前面的时间标识就多余了
+    if (items.size() > 1 && items[0].isHeader && items[1].message >= 0
+            && !shouldAddTimeHeader(prevTime, messages.at(items[1].message).getTimestamp())) {
+        beginRemoveRows(QModelIndex(), 0, 0);
+        items.removeFirst();
+        messageItemsValid = false;
+        if (selectedMessageIndex > 0)
+            selectedMessageIndex--;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), 0, head.size() - 1);
+    items = head + items;
+    messageItemsValid = false;
+    if (selectedMessageIndex >= 0)
+        selectedMessageIndex += head.size();
+    endInsertRows();
+
+    ensureBottomSpace();
+    return head.size();
+}
+
+qint64 ChatListModel::firstSeq() const
+{
+    // 尚未入库的本地消息没有序号，跳过
+    for (const ListItem& item : items) {
+        if (!item.isHeader && !item.isBottomSpace && item.message >= 0 && messages.at(item.message).getSeq() >= 0)
+            return messages.at(item.message).getSeq();
+    }
+    return -1;
+}
+
+qint64 ChatListModel::lastSeq() const
+{
+    return newestSeq;
+}
+
+MessageView ChatListModel::messageAt(int index) const
+{
+    if (index >= 0 && index < static_cast<int>(items.size()) && items[index].message >= 0)
+        return messages.at(items[index].message);
+    return MessageView();
+}
+
+int ChatListModel::rowOfMessage(int messageRow) const
+{
+    if (!messageItemsValid) {
+        messageItems.fill(-1, messages.size());
+        for (int index = 0; index < items.size(); ++index) {
+            if (items[index].message >= 0)
+                messageItems[items[index].message] = index;
+        }
+        messageItemsValid = true;
+    }
+    return messageRow >= 0 && messageRow < messageItems.size() ? messageItems[messageRow] : -1;
+}
+
+qint64 ChatListModel::memoryUsage() const
+{
+    qint64 bytes = messages.memoryUsage() + messages.imageMemoryUsage()
+            + items.capacity() * qint64(sizeof(ListItem))
+            + messageItems.capacity() * qint64(sizeof(int))
+            + layouts.memoryUsage();
+    for (const ListItem& item : items) {
+        if (item.timeHeader)
+            bytes += sizeof(TimeHeader) + item.timeHeader->text.capacity() * qint64(sizeof(QChar));
+    }
+    return bytes;
 }
 
 void ChatListModel::clearSelection()
 {
     if (selectedMessageIndex >= 0) {
-        items[selectedMessageIndex].message->setSelected(false);
+        messages.setSelected(items[selectedMessageIndex].message, false);
         QModelIndex index = this->index(selectedMessageIndex);
         selectedMessageIndex = -1;
         emit dataChanged(index, index);
@@ -162,9 +323,11 @@ bool ChatListModel::removeMessage(int index)
         return false;
     }
 
-    // 删除消息
+    // 删除消息；被删的本地消息不再跟踪投递状态和序号
+    localRows.remove(messages.at(items[index].message).getMessageId());
     beginRemoveRows(QModelIndex(), index, index);
     items.erase(items.begin() + index);
+    messageItemsValid = false;
     if (selectedMessageIndex == index) {
         selectedMessageIndex = -1;
     } else if (selectedMessageIndex > index) {
@@ -205,6 +368,17 @@ bool ChatListModel::shouldAddTimeHeader(const QDateTime& prevTime, const QDateTi
     return interval >= TimeSettings::MESSAGE_TIME_INTERVAL;
 }
 
+ChatListModel::ListItem ChatListModel::makeTimeHeader(const QDateTime& timestamp) const
+{
+    ListItem timeItem;
+    timeItem.isHeader = true;
+    timeItem.timeHeader = QSharedPointer<TimeHeader>::create();
+    timeItem.timeHeader->timestamp = timestamp;
+    timeItem.timeHeader->type = getTimeHeaderType(timestamp);
+    timeItem.timeHeader->text = formatTimeHeader(timestamp);
+    return timeItem;
+}
+
 TimeHeaderType ChatListModel::getTimeHeaderType(const QDateTime& timestamp) const
 {
     QDateTime now = QDateTime::currentDateTime();
@@ -277,5 +451,13 @@ void ChatListModel::setBottomSpaceHeight(int height)
 void ChatListModel::clear() {
     beginResetModel();
     items.clear();
+    messages.clear();
+    localRows.clear();
+    messageItems.clear();
+    messageItemsValid = true;
+    newestSeq = -1;
+    layouts.clear();
+    renderSerial = nextRenderId();
+    selectedMessageIndex = -1;
     endResetModel();
 }
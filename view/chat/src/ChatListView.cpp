@@ -1,10 +1,14 @@
 #include "ChatListView.h"
+#include "ChatItemDelegate.h"
 #include <QWheelEvent>
 #include <QScrollBar>
 #include <QTimer>
 #include <QPainter>
 #include <QPropertyAnimation>
 #include <QStyleOption>
+#include <QItemSelectionModel>
+#include <algorithm>
+#include <climits>
 
 ChatListView::ChatListView(QWidget *parent)
     : QListView(parent)
@@ -44,9 +48,15 @@ void ChatListView::setModel(QAbstractItemModel *model)
                   this, &ChatListView::onModelRowsChanged);
         disconnect(this->model(), &QAbstractItemModel::modelReset,
                   this, &ChatListView::onModelRowsChanged);
+        if (auto* chatModel = qobject_cast<ChatListModel*>(this->model()))
+            disconnect(chatModel, &ChatListModel::bubbleSizesChanged,
+                       this, &ChatListView::onBubbleSizesChanged);
+        // 换下的模型不再显示，排入后台的请求不必完成
+        cancelShaping();
     }
 
     QListView::setModel(model);
+    rebuildRowHeights(false);
 
     if (model) {
         connect(model, &QAbstractItemModel::rowsInserted,
@@ -55,6 +65,9 @@ void ChatListView::setModel(QAbstractItemModel *model)
                 this, &ChatListView::onModelRowsChanged);
         connect(model, &QAbstractItemModel::modelReset,
                 this, &ChatListView::onModelRowsChanged);
+        if (auto* chatModel = qobject_cast<ChatListModel*>(model))
+            connect(chatModel, &ChatListModel::bubbleSizesChanged,
+                    this, &ChatListView::onBubbleSizesChanged);
                 
         // 初始化后延迟检查滚动条状态
         QTimer::singleShot(100, this, &ChatListView::checkScrollBarVisibility);
@@ -63,9 +76,8 @@ void ChatListView::setModel(QAbstractItemModel *model)
 
 void ChatListView::checkScrollBarVisibility()
 {
-    // 强制重新计算布局
+    // 补测可见行并更新滚动范围，其余行的高度已在行高索引中
     doItemsLayout();
-    updateGeometries();
     
     // 检查是否需要滚动条
     QScrollBar* vScrollBar = verticalScrollBar();
@@ -92,6 +104,43 @@ void ChatListView::onModelRowsChanged()
     }
 }
 
+void ChatListView::onBubbleSizesChanged(const QVector<int>& messageRows)
+{
+    // 虚拟化模式下窗口内的行都已实测，窗口外的行进入窗口时再测，不必逐行刷新
+    auto* chatModel = qobject_cast<ChatListModel*>(model());
+    if (!chatModel || m_virtualized)
+        return;
+    QScrollBar* vScrollBar = verticalScrollBar();
+    const int previousMaximum = vScrollBar->maximum();
+    const bool atBottom = vScrollBar->value() >= previousMaximum - 5;
+    const int firstVisible = m_rowHeights.rowAt(qint64(vScrollBar->value()) - spacing());
+
+    // 只刷新这批结果涉及、且还是估计值的行，缓存命中，不排版；每行更新行高索引 O(log n)
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+    option.rect = QRect(0, 0, rowWidth(), 0);
+    int deltaAbove = 0;
+    bool changed = false;
+    for (int messageRow : messageRows) {
+        const int row = chatModel->rowOfMessage(messageRow);
+        if (row < 0 || row >= m_rowHeights.size() || m_rowHeights.isExact(row))
+            continue;
+        const int height = measureRow(option, row, ChatItemDelegate::Measure::Deferred);
+        const int delta = height - m_rowHeights.height(row);
+        if (delta == 0)
+            continue;
+        m_rowHeights.setHeight(row, height, false);
+        if (row < firstVisible)
+            deltaAbove += delta;
+        changed = true;
+    }
+    if (!changed)
+        return;
+    followHeightChange(previousMaximum, atBottom, deltaAbove);
+    measureVisibleRows();
+    viewport()->update();
+}
+
 void ChatListView::mousePressEvent(QMouseEvent* event)
 {
     QModelIndex index = indexAt(event->pos());
@@ -117,17 +166,24 @@ void ChatListView::resizeEvent(QResizeEvent *event)
     
     updateCustomScrollBar();
     
-    // 强制重新计算所有项的大小和位置
-    if (model()) {
-        for (int i = 0; i < model()->rowCount(); ++i) {
-            QModelIndex index = model()->index(i, 0);
-            update(index);
-        }
-        doItemsLayout();
-    }
+    // 行宽变了，气泡折行随之改变：行高全部换成新宽度下的估计值，再补测可见行
+    if (model() && rowWidth() != m_layoutWidth)
+        rebuildRowHeights(true);
+    else
+        measureVisibleRows();
 }
 
 
+void ChatListView::changeEvent(QEvent *event)
+{
+    QListView::changeEvent(event);
+    // 字体变了，缓存的气泡排版全部作废，重新计算行高
+    if (event->type() == QEvent::FontChange || event->type() == QEvent::ApplicationFontChange) {
+        ChatItemDelegate::invalidateFonts();
+        rebuildRowHeights(true);
+    }
+}
+
 void ChatListView::wheelEvent(QWheelEvent *event)
 {
     if (model() && model()->rowCount() > 0) {
@@ -313,9 +369,8 @@ int calculateDuration(int offset) {
 
 void ChatListView::scrollToBottom()
 {
-    // 强制重新计算布局
+    // 滚动范围直接取行高索引的总高度，只补测可见行
     doItemsLayout();
-    updateGeometries();
     
     QScrollBar* vScrollBar = verticalScrollBar();
     int totalHeight = vScrollBar->maximum() + vScrollBar->pageStep();
@@ -358,3 +413,519 @@ void ChatListView::scrollToBottom()
     }
 }
 
+void ChatListView::keepScrollAnchor(int previousMaximum, int previousValue)
+{
+    // 立即更新滚动范围，插入的行已按估计值计入行高索引
+    doItemsLayout();
+
+    QScrollBar* vScrollBar = verticalScrollBar();
+    int targetValue = previousValue + vScrollBar->maximum() - previousMaximum;
+    targetValue = qBound(0, targetValue, vScrollBar->maximum());
+
+    scrollAnimation->stop();
+    m_smoothScrollValue = targetValue;
+    vScrollBar->setValue(targetValue);
+    updateCustomScrollBar();
+}
+
+QRect ChatListView::visualRect(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.parent() != rootIndex() || index.row() >= m_rowHeights.size())
+        return QRect();
+    return rowRect(index.row());
+}
+
+QModelIndex ChatListView::indexAt(const QPoint &point) const
+{
+    if (!model())
+        return QModelIndex();
+    const int row = m_rowHeights.rowAt(qint64(verticalOffset()) + point.y() - spacing());
+    if (row >= m_rowHeights.size() || !rowRect(row).contains(point))
+        return QModelIndex();
+    return model()->index(row, 0, rootIndex());
+}
+
+void ChatListView::scrollTo(const QModelIndex &index, ScrollHint hint)
+{
+    const QRect rect = visualRect(index);
+    if (!rect.isValid())
+        return;
+    QScrollBar* vScrollBar = verticalScrollBar();
+    const QRect area = viewport()->rect();
+    int targetValue = vScrollBar->value();
+    switch (hint) {
+    case PositionAtTop:
+        targetValue += rect.top();
+        break;
+    case PositionAtBottom:
+        targetValue += rect.bottom() - area.height() + 1;
+        break;
+    case PositionAtCenter:
+        targetValue += rect.center().y() - area.height() / 2;
+        break;
+    case EnsureVisible:
+        if (rect.top() < 0)
+            targetValue += rect.top();
+        else if (rect.bottom() >= area.height())
+            targetValue += qMin(rect.top(), rect.bottom() - area.height() + 1);
+        break;
+    }
+    targetValue = qBound(0, targetValue, vScrollBar->maximum());
+    scrollAnimation->stop();
+    m_smoothScrollValue = targetValue;
+    vScrollBar->setValue(targetValue);
+}
+
+void ChatListView::doItemsLayout()
+{
+    // 不走 QListView 的整体布局：只更新滚动范围并补测可见行
+    QAbstractItemView::doItemsLayout();
+    if (!model())
+        return;
+    if (m_rowHeights.size() != model()->rowCount(rootIndex()) || rowWidth() != m_layoutWidth)
+        rebuildRowHeights(true);
+    else
+        measureVisibleRows();
+}
+
+void ChatListView::reset()
+{
+    QListView::reset();
+    rebuildRowHeights(false);
+}
+
+void ChatListView::paintEvent(QPaintEvent *event)
+{
+    if (!model() || m_rowHeights.size() == 0)
+        return;
+    QPainter painter(viewport());
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+    const QStyle::State baseState = option.state;
+    const QRect area = event->rect();
+
+    // 只画与重绘区域相交的行，从纵坐标直接查到第一行
+    for (int row = m_rowHeights.rowAt(qint64(verticalOffset()) + area.top() - spacing());
+         row < m_rowHeights.size(); ++row) {
+        const QRect rect = rowRect(row);
+        if (rect.top() > area.bottom())
+            break;
+        const QModelIndex index = model()->index(row, 0, rootIndex());
+        option.rect = rect;
+        option.state = baseState;
+        if (selectionModel() && selectionModel()->isSelected(index))
+            option.state |= QStyle::State_Selected;
+        if (index == currentIndex())
+            option.state |= QStyle::State_HasFocus;
+        itemDelegateForIndex(index)->paint(&painter, option, index);
+    }
+}
+
+void ChatListView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    if (m_measuring) {
+        // 测量中调整了滚动位置，行的位置也变了，整体重画
+        viewport()->update();
+        return;
+    }
+    viewport()->scroll(0, dy);
+    if (measureVisibleRows())
+        viewport()->update();
+}
+
+void ChatListView::updateGeometries()
+{
+    QAbstractItemView::updateGeometries();
+    updateScrollRange();
+}
+
+int ChatListView::verticalOffset() const
+{
+    return verticalScrollBar()->value();
+}
+
+int ChatListView::horizontalOffset() const
+{
+    return 0;
+}
+
+bool ChatListView::isIndexHidden(const QModelIndex &index) const
+{
+    Q_UNUSED(index);
+    return false;
+}
+
+QModelIndex ChatListView::moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers modifiers)
+{
+    Q_UNUSED(modifiers);
+    if (!model() || m_rowHeights.size() == 0)
+        return QModelIndex();
+    const int lastRow = m_rowHeights.size() - 1;
+    const int current = currentIndex().isValid() ? currentIndex().row() : -1;
+    int row = current;
+    switch (cursorAction) {
+    case MoveUp:
+    case MovePrevious:
+        row = current < 0 ? lastRow : current - 1;
+        break;
+    case MoveDown:
+    case MoveNext:
+        row = current + 1;
+        break;
+    case MovePageUp:
+        row = current < 0 ? 0 : m_rowHeights.rowAt(m_rowHeights.top(current) - viewport()->height());
+        break;
+    case MovePageDown:
+        row = current < 0 ? 0 : m_rowHeights.rowAt(m_rowHeights.top(current) + viewport()->height());
+        break;
+    case MoveHome:
+        row = 0;
+        break;
+    case MoveEnd:
+        row = lastRow;
+        break;
+    default:
+        break;
+    }
+    return model()->index(qBound(0, row, lastRow), 0, rootIndex());
+}
+
+void ChatListView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command)
+{
+    if (!model() || !selectionModel())
+        return;
+    const QRect normalized = rect.normalized();
+    const qint64 offset = qint64(verticalOffset()) - spacing();
+    const int first = m_rowHeights.rowAt(offset + normalized.top());
+    const int last = qMin(m_rowHeights.rowAt(offset + normalized.bottom()), m_rowHeights.size() - 1);
+    QItemSelection selection;
+    if (first <= last)
+        selection.select(model()->index(first, 0, rootIndex()), model()->index(last, 0, rootIndex()));
+    selectionModel()->select(selection, command);
+}
+
+QRegion ChatListView::visualRegionForSelection(const QItemSelection &selection) const
+{
+    QRegion region;
+    const QRect area = viewport()->rect();
+    for (const QItemSelectionRange &range : selection) {
+        if (range.parent() != rootIndex() || range.top() >= m_rowHeights.size())
+            continue;
+        const QRect rect = rowRect(range.top()).united(rowRect(qMin(range.bottom(), m_rowHeights.size() - 1)));
+        region += rect.intersected(area);
+    }
+    return region;
+}
+
+void ChatListView::rowsInserted(const QModelIndex &parent, int start, int end)
+{
+    if (parent == rootIndex()) {
+        // 新行只记估计值，不排版；进入视口时再测量
+        QStyleOptionViewItem option;
+        initViewItemOption(&option);
+        option.rect = QRect(0, 0, rowWidth(), 0);
+        const int count = end - start + 1;
+        QVector<int> heights;
+        heights.reserve(count);
+        if (!m_virtualized && m_rowHeights.size() + count >= VIRTUAL_ROWS) {
+            m_virtualized = true;
+            sampleRowHeight(option);
+        }
+        if (m_virtualized) {
+            heights.fill(uniformRowHeight(), count);
+        } else {
+            for (int row = start; row <= end; ++row) {
+                heights.append(measureRow(option, row, ChatItemDelegate::Measure::Deferred));
+            }
+        }
+        m_rowHeights.insert(start, heights);
+    }
+    QListView::rowsInserted(parent, start, end);
+}
+
+void ChatListView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+    if (parent == rootIndex())
+        m_rowHeights.remove(start, end - start + 1);
+    QListView::rowsAboutToBeRemoved(parent, start, end);
+}
+
+void ChatListView::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                               const QList<int> &roles)
+{
+    QListView::dataChanged(topLeft, bottomRight, roles);
+    if (!model() || topLeft.parent() != rootIndex())
+        return;
+
+    QScrollBar* vScrollBar = verticalScrollBar();
+    const int previousMaximum = vScrollBar->maximum();
+    const bool atBottom = vScrollBar->value() >= previousMaximum - 5;
+    const qint64 viewTop = qint64(vScrollBar->value()) - spacing();
+    const int firstVisible = m_rowHeights.rowAt(viewTop);
+    const int lastVisible = m_rowHeights.rowAt(viewTop + viewport()->height());
+
+    // 视口内的行立即重新测量，其余的行换成估计值，进入视口时再测；
+    // 虚拟化模式下窗口外的行不读取，只标记为待测
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+    option.rect = QRect(0, 0, rowWidth(), 0);
+    int deltaAbove = 0;
+    bool changed = false;
+    const int last = qMin(bottomRight.row(), m_rowHeights.size() - 1);
+    for (int row = qMax(0, topLeft.row()); row <= last; ++row) {
+        const bool visible = row >= firstVisible && row <= lastVisible;
+        if (!visible && m_virtualized) {
+            m_rowHeights.setHeight(row, m_rowHeights.height(row), false);
+            continue;
+        }
+        const int height = measureRow(option, row, visible ? ChatItemDelegate::Measure::Exact
+                                                           : ChatItemDelegate::Measure::Deferred);
+        const int delta = height - m_rowHeights.height(row);
+        m_rowHeights.setHeight(row, height, visible);
+        if (delta == 0)
+            continue;
+        if (row < firstVisible)
+            deltaAbove += delta;
+        changed = true;
+    }
+    if (changed)
+        followHeightChange(previousMaximum, atBottom, deltaAbove);
+    if (m_virtualized)
+        measureVisibleRows();
+}
+
+int ChatListView::rowWidth() const
+{
+    return qMax(0, viewport()->width() - 2 * spacing());
+}
+
+QRect ChatListView::rowRect(int row) const
+{
+    const qint64 top = spacing() + m_rowHeights.top(row) - verticalOffset();
+    return QRect(spacing(), int(top), rowWidth(), m_rowHeights.height(row) - spacing());
+}
+
+qint64 ChatListView::contentHeight() const
+{
+    return m_rowHeights.size() == 0 ? 0 : m_rowHeights.total() + spacing();
+}
+
+int ChatListView::measureRow(QStyleOptionViewItem &option, int row, ChatItemDelegate::Measure measure) const
+{
+    const QModelIndex index = model()->index(row, 0, rootIndex());
+    QAbstractItemDelegate* delegate = itemDelegateForIndex(index);
+    QSize size;
+    if (auto* chatDelegate = qobject_cast<ChatItemDelegate*>(delegate))
+        size = chatDelegate->rowSize(option, index, measure);
+    else if (delegate)
+        size = delegate->sizeHint(option, index);
+    return qMax(0, size.height()) + spacing();
+}
+
+void ChatListView::rebuildRowHeights(bool keepAnchor)
+{
+    QScrollBar* vScrollBar = verticalScrollBar();
+    const bool atBottom = vScrollBar->value() >= vScrollBar->maximum() - 5;
+    // 锚点：视口顶部所在的行与它在行内的偏移
+    int anchorRow = -1;
+    qint64 anchorOffset = 0;
+    if (keepAnchor && !atBottom && m_rowHeights.size() > 0) {
+        const qint64 viewTop = qint64(vScrollBar->value()) - spacing();
+        anchorRow = qMin(m_rowHeights.rowAt(viewTop), m_rowHeights.size() - 1);
+        anchorOffset = viewTop - m_rowHeights.top(anchorRow);
+    }
+
+    // 旧宽度、旧字体下排入后台的请求作废，需要的行在下面按新宽度重新排入
+    cancelShaping();
+    m_rowHeights.clear();
+    m_layoutWidth = rowWidth();
+    m_exactHeightSum = 0;
+    m_exactRows = 0;
+    const int rows = model() ? model()->rowCount(rootIndex()) : 0;
+    m_virtualized = rows >= VIRTUAL_ROWS;
+    if (rows > 0) {
+        QStyleOptionViewItem option;
+        initViewItemOption(&option);
+        option.rect = QRect(0, 0, m_layoutWidth, 0);
+        QVector<int> heights;
+        heights.reserve(rows);
+        if (uniformItemSizes()) {
+            // 行高一致时只测第一行
+            heights.fill(measureRow(option, 0, ChatItemDelegate::Measure::Exact), rows);
+        } else if (m_virtualized) {
+            // 不逐行读取：全部先用统一行高，窗口内的行随后实测
+            sampleRowHeight(option);
+            heights.fill(uniformRowHeight(), rows);
+        } else {
+            // 只估计；视口附近的行在 measureVisibleRows 中交给后台
+            for (int row = 0; row < rows; ++row) {
+                heights.append(measureRow(option, row, ChatItemDelegate::Measure::Estimated));
+            }
+        }
+        m_rowHeights.insert(0, heights);
+    }
+
+    updateScrollRange();
+    if (!keepAnchor) {
+        viewport()->update();
+        return;
+    }
+    int targetValue = vScrollBar->value();
+    if (atBottom)
+        targetValue = vScrollBar->maximum();
+    else if (anchorRow >= 0 && anchorRow < m_rowHeights.size())
+        targetValue = int(spacing() + m_rowHeights.top(anchorRow) + anchorOffset);
+    targetValue = qBound(0, targetValue, vScrollBar->maximum());
+    scrollAnimation->stop();
+    m_smoothScrollValue = targetValue;
+    vScrollBar->setValue(targetValue);
+    measureVisibleRows();
+    viewport()->update();
+}
+
+bool ChatListView::measureVisibleRows()
+{
+    if (!model() || m_rowHeights.size() == 0 || m_measuring)
+        return false;
+    m_measuring = true;
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+    option.rect = QRect(0, 0, rowWidth(), 0);
+
+    QScrollBar* vScrollBar = verticalScrollBar();
+    bool visibleChanged = false;
+    // 测量后行高变化可能让更多行进入窗口，直到窗口内都是实际高度
+    const int margin = windowMargin();
+    for (int pass = 0; pass < 4; ++pass) {
+        const int previousMaximum = vScrollBar->maximum();
+        const bool atBottom = vScrollBar->value() >= previousMaximum - 5;
+        const qint64 viewTop = qint64(vScrollBar->value()) - spacing();
+        const qint64 visibleBottom = viewTop + viewport()->height();
+        const qint64 viewBottom = visibleBottom + margin;
+        int deltaAbove = 0;
+        bool changed = false;
+        for (int row = m_rowHeights.rowAt(viewTop - margin);
+             row < m_rowHeights.size() && m_rowHeights.top(row) < viewBottom; ++row) {
+            if (m_rowHeights.isExact(row))
+                continue;
+            const int height = measureRow(option, row, ChatItemDelegate::Measure::Exact);
+            const int delta = height - m_rowHeights.height(row);
+            const qint64 top = m_rowHeights.top(row);
+            // 顶端在视口上方的行变高或变矮时，让它下面的内容留在原处
+            if (top < viewTop)
+                deltaAbove += delta;
+            else if (top < visibleBottom && delta != 0)
+                visibleChanged = true;
+            m_rowHeights.setHeight(row, height, true);
+            m_exactHeightSum += height;
+            ++m_exactRows;
+            changed = changed || delta != 0;
+        }
+        if (!changed)
+            break;
+        followHeightChange(previousMaximum, atBottom, deltaAbove);
+    }
+    if (!m_virtualized)
+        shapeNearbyRows(option);
+    m_measuring = false;
+    return visibleChanged;
+}
+
+void ChatListView::shapeNearbyRows(QStyleOptionViewItem &option)
+{
+    QScrollBar* vScrollBar = verticalScrollBar();
+    const int previousMaximum = vScrollBar->maximum();
+    const bool atBottom = vScrollBar->value() >= previousMaximum - 5;
+    const qint64 viewTop = qint64(vScrollBar->value()) - spacing();
+    const int margin = viewport()->height() * SHAPE_SCREENS;
+    const qint64 viewBottom = viewTop + viewport()->height() + margin;
+    const int firstVisible = m_rowHeights.rowAt(viewTop);
+    // 已排入或已排好的行缓存命中，不重复排入；排好的尺寸与估计值不同时顺带更新行高
+    int deltaAbove = 0;
+    bool changed = false;
+    for (int row = m_rowHeights.rowAt(viewTop - margin);
+         row < m_rowHeights.size() && m_rowHeights.top(row) < viewBottom; ++row) {
+        if (m_rowHeights.isExact(row))
+            continue;
+        const int height = measureRow(option, row, ChatItemDelegate::Measure::Deferred);
+        const int delta = height - m_rowHeights.height(row);
+        if (delta == 0)
+            continue;
+        m_rowHeights.setHeight(row, height, false);
+        if (row < firstVisible)
+            deltaAbove += delta;
+        changed = true;
+    }
+    if (changed)
+        followHeightChange(previousMaximum, atBottom, deltaAbove);
+}
+
+void ChatListView::cancelShaping()
+{
+    auto* chatModel = qobject_cast<ChatListModel*>(model());
+    auto* chatDelegate = qobject_cast<ChatItemDelegate*>(itemDelegate());
+    if (chatModel && chatDelegate)
+        chatDelegate->cancelShaping(chatModel);
+}
+
+int ChatListView::uniformRowHeight() const
+{
+    if (m_exactRows > 0)
+        return int(m_exactHeightSum / m_exactRows);
+    return m_sampledHeight;
+}
+
+void ChatListView::sampleRowHeight(QStyleOptionViewItem &option)
+{
+    // 打开会话时停在底部，取样底部的行，估计值与首屏最接近
+    const int rows = model()->rowCount(rootIndex());
+    const int first = qMax(0, rows - SAMPLE_ROWS);
+    qint64 sum = 0;
+    for (int row = first; row < rows; ++row) {
+        sum += measureRow(option, row, ChatItemDelegate::Measure::Deferred);
+    }
+    m_sampledHeight = rows > first ? int(sum / (rows - first)) : spacing();
+}
+
+int ChatListView::windowMargin() const
+{
+    return m_virtualized ? viewport()->height() : 0;
+}
+
+void ChatListView::updateScrollRange()
+{
+    const int viewportHeight = viewport()->height();
+    const qint64 maximum = qBound<qint64>(0, contentHeight() - viewportHeight, INT_MAX);
+    QScrollBar* vScrollBar = verticalScrollBar();
+    vScrollBar->setSingleStep(20);
+    vScrollBar->setPageStep(viewportHeight);
+    vScrollBar->setRange(0, int(maximum));
+    horizontalScrollBar()->setRange(0, 0);
+}
+
+void ChatListView::followHeightChange(int previousMaximum, bool atBottom, int deltaAbove)
+{
+    updateScrollRange();
+    QScrollBar* vScrollBar = verticalScrollBar();
+    if (scrollAnimation->state() == QAbstractAnimation::Running) {
+        if (scrollAnimation->endValue().toInt() == previousMaximum) {
+            // 正在滚向底部（打开会话、新消息）时改为滚到新的底部
+            scrollAnimation->setEndValue(vScrollBar->maximum());
+        } else if (deltaAbove != 0) {
+            scrollAnimation->setStartValue(scrollAnimation->startValue().toInt() + deltaAbove);
+            scrollAnimation->setEndValue(scrollAnimation->endValue().toInt() + deltaAbove);
+            m_smoothScrollValue += deltaAbove;
+            vScrollBar->setValue(vScrollBar->value() + deltaAbove);
+        }
+    } else {
+        int targetValue = atBottom ? vScrollBar->maximum() : vScrollBar->value() + deltaAbove;
+        targetValue = qBound(0, targetValue, vScrollBar->maximum());
+        m_smoothScrollValue = targetValue;
+        vScrollBar->setValue(targetValue);
+    }
+    customScrollBar->setRange(vScrollBar->minimum(), vScrollBar->maximum());
+    customScrollBar->setPageStep(vScrollBar->pageStep());
+    if (scrollAnimation->state() != QAbstractAnimation::Running)
+        customScrollBar->setValue(vScrollBar->value());
+}
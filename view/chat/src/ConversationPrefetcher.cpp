@@ -0,0 +1,157 @@
+#include "ConversationPrefetcher.h"
+#include "ChatArea.h"
+#include "ChatItemDelegate.h"
+#include "MessageRepository.h"
+#include "UserRepository.h"
+#include <QSet>
+
+ConversationPrefetcher::ConversationPrefetcher(QObject* parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+ConversationPrefetcher::~ConversationPrefetcher()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void ConversationPrefetcher::prefetch(const QString& conversationId, int layoutWidth)
+{
+    if (conversationId.isEmpty() || layoutWidth <= 0)
+        return;
+    const auto ready = m_ready.constFind(conversationId);
+    if (ready != m_ready.constEnd() && ready->layoutWidth == layoutWidth
+            && isCurrent(conversationId, ready->totalCount, ready->lastSeq))
+        return;
+    if (conversationId == m_requested && layoutWidth == m_requestedWidth)
+        return;
+    m_requested = conversationId;
+    m_requestedWidth = layoutWidth;
+
+    // 只有最近一次悬停有意义，排队中的旧请求直接丢弃，正在执行的照常完成
+    m_pool.clear();
+    const QFont font = ChatItemDelegate::messageFont();
+    const int fontGeneration = ChatItemDelegate::fontGeneration();
+    const int maxBubbleWidth = ChatItemDelegate::maxBubbleWidth(layoutWidth);
+    m_pool.start([this, conversationId, layoutWidth, font, fontGeneration, maxBubbleWidth] {
+        auto& repository = MessageRepository::instance();
+        Page page;
+        page.conversationId = conversationId;
+        page.layoutWidth = layoutWidth;
+        page.fontGeneration = fontGeneration;
+        // 先记下快照的版本再读取，读取期间有新消息时版本对不上，点击时放弃这一页
+        if (const ConversationSnapshotPtr snap = repository.snapshot(conversationId)) {
+            page.totalCount = snap->summary.totalCount;
+            page.lastSeq = snap->summary.lastMessage ? snap->summary.lastMessage->getSeq() : -1;
+        }
+        page.messages = repository.fetchLatest(conversationId, ChatArea::MESSAGE_PAGE_SIZE);
+        for (auto& message : page.messages) {
+            if (message->getType() == MessageType::Text) {
+                page.bubbleSizes.insert(message->getSeq(),
+                                        ChatItemDelegate::measureTextBubble(message->getContent(), font,
+                                                                            maxBubbleWidth));
+            } else if (message->getType() == MessageType::Image) {
+                message = displayReady(static_cast<const ImageMessage&>(*message));
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, page] { onPageReady(page); }, Qt::QueuedConnection);
+    });
+}
+
+QSharedPointer<ChatMessage> ConversationPrefetcher::displayReady(const ImageMessage& message)
+{
+    // 仓库中的消息对象由各读者共享，不能就地修改，换成一份副本
+    const QImage image = message.getImage().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    auto copy = QSharedPointer<ImageMessage>::create(image, message.isFromMe(), message.getSenderId(),
+                                                     message.isInGroupChat(), message.getSenderName(),
+                                                     message.getRole());
+    copy->setTimestamp(message.getTimestamp());
+    copy->setSeq(message.getSeq());
+    copy->setMessageId(message.getMessageId());
+    copy->setDeliveryState(message.getDeliveryState());
+    return copy;
+}
+
+void ConversationPrefetcher::onPageReady(const Page& page)
+{
+    if (page.conversationId == m_requested)
+        m_requested.clear();
+    discard(page.conversationId);
+
+    // 模型在界面线程建好，挂在预取器下面，取走时再交出；图片在加入模型时才转为 QPixmap
+    // 排好的气泡尺寸放进模型的排版缓存，行高直接命中；折好行的排版在首次绘制时补上
+    auto* model = new ChatListModel(this);
+    const int maxBubbleWidth = ChatItemDelegate::maxBubbleWidth(page.layoutWidth);
+    BubbleLayoutCache& layouts = model->layoutCache();
+    layouts.validate(maxBubbleWidth, page.fontGeneration);
+    for (const auto& message : page.messages) {
+        if (!model->addMessage(message))
+            continue;
+        const auto size = page.bubbleSizes.constFind(message->getSeq());
+        if (size != page.bubbleSizes.constEnd()) {
+            BubbleLayoutCache::Entry entry;
+            entry.bubble = size.value();
+            layouts.insert(model->messageCount() - 1, maxBubbleWidth, entry);
+        }
+    }
+    model->setBottomSpaceHeight(BottomSpace::DEFAULT_HEIGHT);
+
+    // 头像只能在界面线程生成，先放进缓存，打开会话时绘制直接命中
+    QSet<QString> senders;
+    for (const auto& message : page.messages) {
+        const QString senderId = message->getSenderId();
+        if (!senders.contains(senderId)) {
+            senders.insert(senderId);
+            UserRepository::instance().getAvatar(senderId);
+        }
+    }
+
+    Prepared prepared;
+    prepared.model = model;
+    prepared.layoutWidth = page.layoutWidth;
+    prepared.totalCount = page.totalCount;
+    prepared.lastSeq = page.lastSeq;
+    m_ready.insert(page.conversationId, prepared);
+    m_readyOrder.append(page.conversationId);
+    while (m_readyOrder.size() > MAX_READY) {
+        discard(m_readyOrder.first());
+    }
+}
+
+ChatListModel* ConversationPrefetcher::take(const QString& conversationId, int layoutWidth)
+{
+    const auto it = m_ready.constFind(conversationId);
+    if (it == m_ready.constEnd())
+        return nullptr;
+    const Prepared prepared = it.value();
+    m_ready.erase(it);
+    m_readyOrder.removeOne(conversationId);
+    if (prepared.layoutWidth != layoutWidth
+            || !isCurrent(conversationId, prepared.totalCount, prepared.lastSeq)) {
+        delete prepared.model;
+        return nullptr;
+    }
+    prepared.model->setParent(nullptr);
+    return prepared.model;
+}
+
+bool ConversationPrefetcher::isCurrent(const QString& conversationId, int totalCount, qint64 lastSeq)
+{
+    const ConversationSnapshotPtr snap = MessageRepository::instance().snapshot(conversationId);
+    if (!snap)
+        return totalCount == 0 && lastSeq < 0;
+    const qint64 currentSeq = snap->summary.lastMessage ? snap->summary.lastMessage->getSeq() : -1;
+    return snap->summary.totalCount == totalCount && currentSeq == lastSeq;
+}
+
+void ConversationPrefetcher::discard(const QString& conversationId)
+{
+    const auto it = m_ready.constFind(conversationId);
+    if (it == m_ready.constEnd())
+        return;
+    delete it->model;
+    m_ready.erase(it);
+    m_readyOrder.removeOne(conversationId);
+}
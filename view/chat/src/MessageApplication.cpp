@@ -2,6 +2,7 @@
 #include "MessageApplication.h"
 #include "MessageRepository.h"
 #include "GroupRepository.h"
+#include "NetworkService.h"
 #include <QLayout>
 #include <QResizeEvent>
 #include <QPainter>
@@ -19,6 +20,10 @@ MessageApplication::MessageApplication(QWidget* parent)
     m_msgList->setStyleSheet("border-width:0px;border-style:solid;");
     connect(m_msgList, &MessageListWidget::itemClicked,
             this, &MessageApplication::onMessageClicked);
+    connect(m_msgList, &MessageListWidget::itemPrefetchRequested,
+            this, &MessageApplication::onPrefetchRequested);
+    connect(m_topSearch, &TopSearchWidget::searchTextChanged,
+            this, &MessageApplication::onSearchTextChanged);
 
     QVBoxLayout* leftLayout = new QVBoxLayout(leftPane);
     leftLayout->setContentsMargins(0,0,0,0);
@@ -36,6 +41,10 @@ MessageApplication::MessageApplication(QWidget* parent)
     m_rightStack->setCurrentWidget(m_defaultPage);
     m_chatArea = new ChatArea(this);
     m_rightStack->addWidget(m_chatArea);
+    m_prefetcher = new ConversationPrefetcher(this);
+    // 本地发出的消息同步给服务器（未连接时忽略）
+    connect(m_chatArea, &ChatArea::sendMessage,
+            &NetworkService::instance(), &NetworkService::sendRecord);
 
     // 整体分割
     m_splitter = new QSplitter(Qt::Horizontal, this);
@@ -54,7 +63,6 @@ MessageApplication::MessageApplication(QWidget* parent)
     mainLayout->addWidget(m_splitter);
 
     setWindowFlag(Qt::FramelessWindowHint);
-    connect(m_chatArea, &ChatArea::sendMessage, m_msgList, &MessageListWidget::onLastMessageUpdated);
 }
 
 void MessageApplication::resizeEvent(QResizeEvent*)
@@ -75,14 +83,50 @@ void MessageApplication::onMessageClicked(MessageListItem *item)
 {
     if (!item)
         return;
-    m_chatArea->clearAll();
     m_rightStack->setCurrentWidget(m_chatArea);
     auto& mr = MessageRepository::instance();
     auto& gr = GroupRepository::instance();
-    auto msgs = mr.getMessages(item->getChatID());
     auto id = item->getChatID();
+    // 离开的会话留在缓存里，切回来时原样换回
+    m_chatArea->stashConversation();
     bool isGroup = gr.isGroup(id);
     m_chatArea->setGroupMode(isGroup);
     m_chatArea->setMessageId(id);
+    if (m_chatArea->restoreConversation(id)) {
+        if (m_chatArea->lastSeq() >= 0)
+            mr.markRead(id, m_chatArea->lastSeq());
+        return;
+    }
+    // 悬停时已备好的会话直接换上模型；没有备好或已过期时现读最新一页，更早的消息在向上滚动时按需加载
+    if (ChatListModel* prepared = m_prefetcher->take(id, m_chatArea->layoutWidth())) {
+        m_chatArea->adoptModel(prepared);
+        if (prepared->lastSeq() >= 0)
+            mr.markRead(id, prepared->lastSeq());
+        return;
+    }
+    m_chatArea->clearAll();
+    auto msgs = mr.fetchLatest(id, ChatArea::MESSAGE_PAGE_SIZE);
+    if (!msgs.isEmpty())
+        mr.markRead(id, msgs.last()->getSeq());
     m_chatArea->initMessage(msgs);
 }
+
+void MessageApplication::onPrefetchRequested(const QString& chatId)
+{
+    // 缓存中的会话切回来时直接换回，不必预取
+    if (!m_chatArea->isConversationCached(chatId))
+        m_prefetcher->prefetch(chatId, m_chatArea->layoutWidth());
+}
+
+void MessageApplication::onSearchTextChanged(const QString& text)
+{
+    // 会话名直接匹配，聊天记录走全文索引
+    QSet<QString> matchedIds;
+    if (!text.isEmpty()) {
+        const auto hits = MessageRepository::instance().search(text, SEARCH_HIT_LIMIT);
+        for (const auto& hit : hits) {
+            matchedIds.insert(hit.conversationId);
+        }
+    }
+    m_msgList->setFilter(text, matchedIds);
+}
@@ -3,9 +3,11 @@
 #include <QPainterPath>
 #include <QFontMetrics>
 #include <QMouseEvent>
+#include <QKeyEvent>
 #include <QStyle>
 #include <QFont>
 #include "UserRepository.h"
+#include "GroupRepository.h"
 #include "MessageListItem.h"
 
 MessageListItem::MessageListItem(const MessageItemContent& data, QWidget* parent)
@@ -16,8 +18,14 @@ MessageListItem::MessageListItem(const MessageItemContent& data, QWidget* parent
         , fullName(data.name)
         , fullText(data.text)
         , lastTime(data.timestamp)
+        , avatarPath(data.avatarPath)
+        , unreadCount(data.unreadCount)
+        , isGroup(data.isGroup)
+        , doNotDisturb(data.doNotDisturb)
 {
     setMouseTracking(true);
+    // 可用 Tab 在会话间移动，回车打开
+    setFocusPolicy(Qt::TabFocus);
     setupUI(data);
     badge->setDoNotDisturb(data.doNotDisturb);
     badge->setCount(data.unreadCount);
@@ -114,10 +122,11 @@ void MessageListItem::paintEvent(QPaintEvent*) {
 
 void MessageListItem::setupUI(const MessageItemContent& data)
 {
-    if (data.isGroup) {
-        QPixmap pixmap;
-        QPixmapCache::find("group_avatar", &pixmap);
-        avatarLabel->setPixmap(pixmap);
+    if (!data.avatar.isNull()) {
+        avatarLabel->setPixmap(data.avatar);
+    }
+    else if (data.isGroup) {
+        avatarLabel->setPixmap(GroupRepository::instance().getAvatar(data.id));
     }
     else {
         avatarLabel->setPixmap(UserRepository::instance().getAvatar(data.id));
@@ -131,6 +140,7 @@ void MessageListItem::setupUI(const MessageItemContent& data)
 void MessageListItem::enterEvent(QEnterEvent*) {
     hovered = true;
     update();
+    emit prefetchRequested(this);
 }
 
 void MessageListItem::leaveEvent(QEvent*) {
@@ -141,10 +151,27 @@ void MessageListItem::leaveEvent(QEvent*) {
 void MessageListItem::mousePressEvent(QMouseEvent* event) {
     QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
     if (mouseEvent->button() == Qt::LeftButton) {
-        emit itemClicked(this);
-        badge->setCount(0);
-        badge->setSelected(true);
+        activate();
+    }
+}
+
+void MessageListItem::focusInEvent(QFocusEvent* event) {
+    QWidget::focusInEvent(event);
+    emit prefetchRequested(this);
+}
+
+void MessageListItem::keyPressEvent(QKeyEvent* event) {
+    if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
+        activate();
+        return;
     }
+    QWidget::keyPressEvent(event);
+}
+
+void MessageListItem::activate() {
+    emit itemClicked(this);
+    badge->setCount(0);
+    badge->setSelected(true);
 }
 
 void MessageListItem::setSelected(bool select) {
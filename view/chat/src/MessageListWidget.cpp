@@ -6,66 +6,159 @@
 #include <QEvent>
 #include <algorithm>
 
+// 会话列表中显示的最后一条消息文本，群聊带发送者
+static QString previewText(const ConversationSummary& summary, bool isGroup)
+{
+    const auto& lastMsg = summary.lastMessage;
+    if (!lastMsg)
+        return QString();
+    return isGroup ? lastMsg->getSenderName() + "：" + lastMsg->getContent()
+                   : lastMsg->getContent();
+}
+
 MessageListWidget::MessageListWidget(QWidget* parent)
     : CustomScrollArea(parent)
 {
     installEventFilter(this);
     setMouseTracking(true);
-    auto& mr = MessageRepository::instance();
-    auto& gr = GroupRepository::instance();
-    auto& ur = UserRepository::instance();
+
+    // 有启动快照时先照原样建出各行，首帧不碰仓库；仓库就绪后由 reconcile 校正
+    const StartupSnapshot& snapshot = StartupSnapshot::atLaunch();
+    for (const auto& row : snapshot.conversations) {
+        MessageItemContent mic{
+                row.name,
+                row.preview,
+                row.lastTimestamp > 0 ? QDateTime::fromMSecsSinceEpoch(row.lastTimestamp) : QDateTime(),
+                row.unreadCount,
+                row.doNotDisturb,
+                row.avatarPath,
+                row.id,
+                row.isGroup,
+                QPixmap::fromImage(row.avatar)
+        };
+        addMessage(mic);
+    }
+}
+
+void MessageListWidget::reconcile()
+{
+    // 一次取出所有会话摘要，不再为每个会话拷贝消息列表
+    QHash<QString, ConversationSummary> summaries;
+    const auto allSummaries = MessageRepository::instance().getSummaries();
+    for (const auto& summary : allSummaries) {
+        summaries.insert(summary.conversationId, summary);
+    }
+
+    QVector<MessageItemContent> contents;
     auto groups = GroupRepository::instance().getAllGroup();
     for (auto& group : groups) {
-        auto lastMsg = mr.getLastMessage(group.groupId);
-        auto lastContent = lastMsg->getSenderName() + "：" + lastMsg->getContent();
-        auto lastTime = lastMsg->getTimestamp();
-        int unreadCount = mr.getMessages(group.groupId).count();
-        bool isDnd = gr.getGroup(group.groupId).isDnd;
+        const ConversationSummary summary = summaries.value(group.groupId);
+        auto lastContent = previewText(summary, true);
         auto name = QString("%1（%2）").arg(group.groupName, QString::number(group.memberNum));
-        MessageItemContent mic{
+        contents.push_back({
                 name,
                 lastContent,
-                lastTime,
-                unreadCount,
-                isDnd,
+                summary.lastTimestamp,
+                summary.unreadCount,
+                group.isDnd,
                 group.groupAvatarPath,
                 group.groupId,
                 true
-        };
-        addMessage(mic);
+        });
     }
 
     // 单聊初始消息
     auto users = UserRepository::instance().getAllUser();
     for (auto user : users) {
-        auto lastMsg = mr.getLastMessage(user.id);
-        auto lastContent = lastMsg->getContent();
-        auto lastTime = lastMsg->getTimestamp();
-        int unreadCount = mr.getMessages(user.id).count();
-        bool isDnd = ur.getUser(user.id).isDnd;
+        const ConversationSummary summary = summaries.value(user.id);
+        auto lastContent = previewText(summary, false);
         auto name = user.nick;
-        MessageItemContent mic{
+        contents.push_back({
                 name,
                 lastContent,
-                lastTime,
-                unreadCount,
-                isDnd,
+                summary.lastTimestamp,
+                summary.unreadCount,
+                user.isDnd,
                 user.avatarPath,
                 user.id
-        };
-        addMessage(mic);
+        });
     }
-    std::sort(m_items.begin(), m_items.end(),
-          [](MessageListItem* a, MessageListItem* b) {
-              return a->getLastTime() > b->getLastTime();
-    });
+
+    // 快照中已有的行就地更新，头像只在来源变化时重新生成
+    QSet<QString> present;
+    for (const MessageItemContent& content : std::as_const(contents)) {
+        present.insert(content.id);
+        MessageListItem* item = findItemById(content.id);
+        if (!item) {
+            addMessage(content);
+            m_items.last()->show();
+            continue;
+        }
+        item->setName(content.name);
+        item->setLastText(content.text);
+        item->setLastTime(content.timestamp);
+        item->setDoNotDisturb(content.doNotDisturb);
+        if (item != selectItem)
+            item->setUnreadCount(content.unreadCount);
+        if (item->getAvatarPath() != content.avatarPath) {
+            const QPixmap avatar = content.isGroup
+                    ? GroupRepository::instance().getAvatar(content.id)
+                    : UserRepository::instance().getAvatar(content.id);
+            item->setAvatar(avatar, content.avatarPath);
+        }
+    }
+    for (int i = m_items.size() - 1; i >= 0; --i) {
+        MessageListItem* item = m_items[i];
+        if (present.contains(item->getChatID()))
+            continue;
+        if (item == selectItem)
+            selectItem = nullptr;
+        m_itemById.remove(item->getChatID());
+        m_items.removeAt(i);
+        item->deleteLater();
+    }
+
+    if (!m_reconciled) {
+        m_reconciled = true;
+        connect(&MessageRepository::instance(), &MessageRepository::conversationsChanged,
+                this, &MessageListWidget::onConversationsChanged);
+        connect(&MessageRepository::instance(), &MessageRepository::unreadChanged,
+                this, &MessageListWidget::onUnreadChanged);
+    }
+    // layoutContent 会在顺序被打乱时重新排序
+    layoutContent();
+}
+
+QVector<StartupSnapshot::ConversationRow> MessageListWidget::snapshotRows() const
+{
+    QVector<StartupSnapshot::ConversationRow> rows;
+    rows.reserve(m_items.size());
+    for (MessageListItem* item : m_items) {
+        StartupSnapshot::ConversationRow row;
+        row.id = item->getChatID();
+        row.name = item->getName();
+        row.preview = item->getLastText();
+        row.lastTimestamp = item->getLastTime().isValid() ? item->getLastTime().toMSecsSinceEpoch() : 0;
+        row.unreadCount = item->getUnreadCount();
+        row.doNotDisturb = item->isDoNotDisturb();
+        row.isGroup = item->isGroupChat();
+        row.avatarPath = item->getAvatarPath();
+        row.avatar = item->getAvatar().toImage();
+        rows.push_back(std::move(row));
+    }
+    return rows;
 }
 
 void MessageListWidget::addMessage(const MessageItemContent& data) {
     auto *it = new MessageListItem(data, contentWidget);
     connect(it, &MessageListItem::itemClicked,
             this, &MessageListWidget::onItemClicked);
+    connect(it, &MessageListItem::prefetchRequested, this, [this](MessageListItem* item) {
+        if (item != selectItem)
+            emit itemPrefetchRequested(item->getChatID());
+    });
     m_items.append(it);
+    m_itemById.insert(data.id, it);
 }
 
 void MessageListWidget::clearMessages() {
@@ -73,6 +166,8 @@ void MessageListWidget::clearMessages() {
         delete it;
     }
     m_items.clear();
+    m_itemById.clear();
+    selectItem = nullptr;
 }
 
 void MessageListWidget::layoutContent() {
@@ -87,6 +182,8 @@ void MessageListWidget::layoutContent() {
     int y = 0;
     int w = contentWidget->width();
     for (auto *it : m_items) {
+        if (it->isHidden())
+            continue;
         int h = it->sizeHint().height();
         it->setGeometry(0, y, w, h);
         y += h;
@@ -95,6 +192,17 @@ void MessageListWidget::layoutContent() {
     contentWidget->resize(w, y);
 }
 
+void MessageListWidget::setFilter(const QString& keyword, const QSet<QString>& matchedIds)
+{
+    for (auto *it : m_items) {
+        const bool visible = keyword.isEmpty()
+                || matchedIds.contains(it->getChatID())
+                || it->getName().contains(keyword, Qt::CaseInsensitive);
+        it->setVisible(visible);
+    }
+    layoutContent();
+}
+
 void MessageListWidget::onItemClicked(MessageListItem* item) {
     if (!item) return;
     if (item != selectItem) {
@@ -111,29 +219,31 @@ void MessageListWidget::onItemClicked(MessageListItem* item) {
     }
 }
 
-void MessageListWidget::onLastMessageUpdated(const QString& chatId,
-                                             const QString& text,
-                                             const QDateTime& timestamp)
+void MessageListWidget::onConversationsChanged(const QSet<QString>& chatIds)
 {
-    MessageListItem* item = findItemById(chatId);
-    if (item) {
-        item->setLastTime(timestamp);
-        item->setLastText(text);
+    auto& mr = MessageRepository::instance();
+    auto& gr = GroupRepository::instance();
+    for (QString chatId : chatIds) {
+        MessageListItem* item = findItemById(chatId);
+        if (!item)
+            continue;
+        const ConversationSummary summary = mr.getSummary(chatId);
+        item->setLastTime(summary.lastTimestamp);
+        item->setLastText(previewText(summary, gr.isGroup(chatId)));
     }
-    // 按时间排序
-    std::sort(m_items.begin(), m_items.end(),
-              [](MessageListItem* a, MessageListItem* b) {
-                  return a->getLastTime() > b->getLastTime();
-              });
+    // layoutContent 会在顺序被打乱时重新排序
     layoutContent();
 }
 
+void MessageListWidget::onUnreadChanged(const QString& chatId, int unreadCount)
+{
+    MessageListItem* item = findItemById(chatId);
+    // 正在查看的会话不显示未读，新消息会随即被标记为已读
+    if (item && item != selectItem)
+        item->setUnreadCount(unreadCount);
+}
+
 MessageListItem* MessageListWidget::findItemById(const QString& id)
 {
-    for (auto item : m_items) {
-        if (item->getChatID() == id) {
-            return item;
-        }
-    }
-    return nullptr;
+    return m_itemById.value(id, nullptr);
 }
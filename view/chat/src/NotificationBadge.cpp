@@ -16,6 +16,8 @@ NotificationBadge::NotificationBadge(QWidget *parent)
 }
 
 void NotificationBadge::setCount(int count) {
+    if (count == m_count)
+        return;
     m_count = count;
     updateGeometry();
     update();
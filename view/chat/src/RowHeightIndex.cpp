@@ -0,0 +1,86 @@
+#include "RowHeightIndex.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+    // 一次追加的行数超过它时整体重建，比逐行追加快
+    constexpr int APPEND_LIMIT = 64;
+}
+
+void RowHeightIndex::clear()
+{
+    m_tree.clear();
+    m_heights.clear();
+    m_exact.clear();
+}
+
+void RowHeightIndex::insert(int row, const QVector<int>& heights)
+{
+    const int oldSize = size();
+    row = qBound(0, row, oldSize);
+    m_exact.resize(oldSize + int(heights.size()));
+    if (row == oldSize && heights.size() <= APPEND_LIMIT) {
+        // 追加：新消息、底部空白都在末尾
+        for (int height : heights) {
+            m_heights.push_back(height);
+            m_tree.append(height);
+        }
+        return;
+    }
+    m_heights.insert(row, heights.size(), 0);
+    std::copy(heights.begin(), heights.end(), m_heights.begin() + row);
+    // 插入点之后的已测量标记整体后移
+    for (int i = oldSize - 1; i >= row; --i) {
+        m_exact.setBit(i + int(heights.size()), m_exact.testBit(i));
+    }
+    for (int i = row; i < row + int(heights.size()); ++i) {
+        m_exact.clearBit(i);
+    }
+    rebuild();
+}
+
+void RowHeightIndex::remove(int row, int count)
+{
+    const int oldSize = size();
+    if (row < 0 || count <= 0 || row >= oldSize)
+        return;
+    count = qMin(count, oldSize - row);
+    if (row + count == oldSize) {
+        m_heights.resize(row);
+        m_exact.resize(row);
+        m_tree.truncate(row);
+        return;
+    }
+    m_heights.remove(row, count);
+    for (int i = row; i < oldSize - count; ++i) {
+        m_exact.setBit(i, m_exact.testBit(i + count));
+    }
+    m_exact.resize(oldSize - count);
+    rebuild();
+}
+
+void RowHeightIndex::setHeight(int row, int height, bool exact)
+{
+    const int delta = height - m_heights.at(row);
+    if (delta != 0) {
+        m_heights[row] = height;
+        m_tree.add(row, delta);
+    }
+    m_exact.setBit(row, exact);
+}
+
+qint64 RowHeightIndex::memoryUsage() const
+{
+    return m_heights.capacity() * qint64(sizeof(int)) + m_tree.size() * qint64(sizeof(qint64))
+            + m_exact.size() / 8;
+}
+
+void RowHeightIndex::rebuild()
+{
+    QVector<qint64> values;
+    values.reserve(m_heights.size());
+    for (int height : std::as_const(m_heights)) {
+        values.push_back(height);
+    }
+    m_tree.build(values);
+}
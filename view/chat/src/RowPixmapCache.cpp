@@ -0,0 +1,35 @@
+#include "RowPixmapCache.h"
+
+bool RowPixmapCache::Key::operator==(const Key& other) const
+{
+    return renderId == other.renderId && row == other.row && header == other.header
+            && size == other.size && devicePixelRatio == other.devicePixelRatio && state == other.state
+            && palette == other.palette && avatar == other.avatar && fontGeneration == other.fontGeneration;
+}
+
+RowPixmapCache::RowPixmapCache()
+{
+    m_pixmaps.setMaxCost(BUDGET_MB * 1024);
+}
+
+const QPixmap* RowPixmapCache::find(const Key& key)
+{
+    return m_pixmaps.object(key);
+}
+
+void RowPixmapCache::insert(const Key& key, const QPixmap& pixmap)
+{
+    // 按设备像素计算开销，高分屏上的位图占用更多预算
+    const qint64 bytes = qint64(pixmap.width()) * pixmap.height() * (pixmap.depth() / 8);
+    m_pixmaps.insert(key, new QPixmap(pixmap), int(qMax<qint64>(1, bytes / 1024)));
+}
+
+void RowPixmapCache::clear()
+{
+    m_pixmaps.clear();
+}
+
+qint64 RowPixmapCache::memoryUsage() const
+{
+    return qint64(m_pixmaps.totalCost()) * 1024;
+}
@@ -0,0 +1,156 @@
+#include "TextShaper.h"
+#include "ChatListModel.h"
+#include "ChatItemDelegate.h"
+#include <QThread>
+#include <QTimer>
+#include <utility>
+#include <algorithm>
+
+TextShaper::TextShaper(QObject* parent)
+    : QObject(parent)
+{
+    // 留一个核给界面线程
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+TextShaper::~TextShaper()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool TextShaper::takeSyncBudget()
+{
+    if (m_syncBudget == 0)
+        return false;
+    --m_syncBudget;
+    scheduleFlush();
+    return true;
+}
+
+void TextShaper::request(ChatListModel* model, int row, const QString& text, int maxBubbleWidth)
+{
+    Pending* pending = nullptr;
+    for (Pending& candidate : m_pending) {
+        if (candidate.model == model && candidate.maxBubbleWidth == maxBubbleWidth) {
+            pending = &candidate;
+            break;
+        }
+    }
+    if (!pending) {
+        m_pending.append(Pending());
+        pending = &m_pending.last();
+        pending->model = model;
+        pending->maxBubbleWidth = maxBubbleWidth;
+    }
+    pending->rows.append(qMakePair(row, text));
+    scheduleFlush();
+}
+
+void TextShaper::markChanged(ChatListModel* model, const QVector<int>& rows)
+{
+    auto it = std::find_if(m_changed.begin(), m_changed.end(),
+                           [model](const Changed& changed) { return changed.model == model; });
+    if (it == m_changed.end())
+        m_changed.append({ model, rows });
+    else
+        it->rows += rows;
+    scheduleFlush();
+}
+
+void TextShaper::cancel(ChatListModel* model)
+{
+    ++*generation(model);
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+                                   [model](const Pending& pending) { return pending.model == model; }),
+                    m_pending.end());
+}
+
+TextShaper::Generation TextShaper::generation(ChatListModel* model)
+{
+    Generation& current = m_generations[model];
+    if (!current) {
+        current = std::make_shared<std::atomic<int>>(0);
+        connect(model, &QObject::destroyed, this, [this, model] {
+            // 模型销毁后它排入的批次一律作废
+            if (const Generation stale = m_generations.take(model))
+                ++*stale;
+        });
+    }
+    return current;
+}
+
+void TextShaper::scheduleFlush()
+{
+    if (m_flushScheduled)
+        return;
+    m_flushScheduled = true;
+    QTimer::singleShot(0, this, &TextShaper::flush);
+}
+
+void TextShaper::flush()
+{
+    m_flushScheduled = false;
+    m_syncBudget = SYNC_BUDGET;
+
+    const QFont font = ChatItemDelegate::messageFont();
+    const int fontGeneration = ChatItemDelegate::fontGeneration();
+    for (const Pending& pending : std::as_const(m_pending)) {
+        if (!pending.model)
+            continue;
+        const Generation current = generation(pending.model);
+        const int stamp = *current;
+        for (int first = 0; first < pending.rows.size(); first += BATCH_SIZE) {
+            const QVector<QPair<int, QString>> rows = pending.rows.mid(first, BATCH_SIZE);
+            const QPointer<ChatListModel> model = pending.model;
+            const int maxBubbleWidth = pending.maxBubbleWidth;
+            m_pool.start([this, model, maxBubbleWidth, font, fontGeneration, current, stamp, rows] {
+                QVector<QPair<int, QSize>> sizes;
+                sizes.reserve(rows.size());
+                for (const auto& row : rows) {
+                    // 排队期间宽度或字体已变，剩下的行不再排版
+                    if (*current != stamp)
+                        return;
+                    sizes.append(qMakePair(row.first,
+                                           ChatItemDelegate::measureTextBubble(row.second, font, maxBubbleWidth)));
+                }
+                QMetaObject::invokeMethod(this, [this, model, maxBubbleWidth, fontGeneration, stamp, sizes] {
+                    apply(model, maxBubbleWidth, fontGeneration, stamp, sizes);
+                }, Qt::QueuedConnection);
+            });
+        }
+    }
+    m_pending.clear();
+
+    const QVector<Changed> changed = std::exchange(m_changed, {});
+    for (const Changed& entry : changed) {
+        if (entry.model)
+            entry.model->notifyBubbleSizesChanged(entry.rows);
+    }
+}
+
+void TextShaper::apply(const QPointer<ChatListModel>& model, int maxBubbleWidth, int fontGeneration, int stamp,
+                       const QVector<QPair<int, QSize>>& sizes)
+{
+    if (!model || *generation(model) != stamp)
+        return;
+    BubbleLayoutCache& cache = model->layoutCache();
+    // 排版期间宽度或字体又变了，这批结果作废，新宽度下的请求已另外排队
+    if (!cache.accepts(maxBubbleWidth, fontGeneration))
+        return;
+    QVector<int> changed;
+    for (const auto& size : sizes) {
+        const BubbleLayoutCache::Entry* current = cache.find(size.first, maxBubbleWidth);
+        // 可见行已在绘制时排好，不再覆盖
+        if (current && !current->estimated)
+            continue;
+        const bool heightChanged = !current || current->bubble.height() != size.second.height();
+        BubbleLayoutCache::Entry entry;
+        entry.bubble = size.second;
+        cache.insert(size.first, maxBubbleWidth, entry);
+        if (heightChanged)
+            changed.append(size.first);
+    }
+    if (!changed.isEmpty())
+        markChanged(model, changed);
+}
@@ -9,6 +9,7 @@ class FriendApplication : public QWidget {
     Q_OBJECT
 public:
     explicit FriendApplication(QWidget* parent = nullptr);
+    FriendListWidget* friendList() const { return m_leftPane->list(); }
 protected:
     void resizeEvent(QResizeEvent* event) override;
     void paintEvent(QPaintEvent* event) override;
@@ -24,6 +25,7 @@ private:
             setMaximumWidth(305);
             m_content->setStyleSheet("border-width:0px;border-style:solid;");
         }
+        FriendListWidget* list() const { return m_content; }
 
     protected:
         void resizeEvent(QResizeEvent* ev) override {
@@ -11,12 +11,15 @@ class FriendListItem : public QWidget
 {
     Q_OBJECT
 public:
-    explicit FriendListItem(const User& user, QWidget* parent = nullptr);
+    // avatar 为空时从仓库取头像
+    FriendListItem(const User& user, const QPixmap& avatar, QWidget* parent = nullptr);
     QSize sizeHint() const override;
     void setSelected(bool select);
     bool isSelected();
     UserStatus getUserStatus() { return status; }
     QString getUserName() { return fullNameText; }
+    const User& getUser() const { return user; }
+    QPixmap getAvatar() const { return avatarLabel->pixmap(); }
 
 protected:
     void paintEvent(QPaintEvent*) Q_DECL_OVERRIDE;
@@ -35,9 +38,10 @@ private:
     QString fullNameText;
     QString fullStatusAndSignText;
     UserStatus status;
+    User user;
 
     bool hovered = false;
     bool selected = false;
 
-    void setupUI(const User& user);
+    void setupUI(const User& user, const QPixmap& avatar);
 };
@@ -9,6 +9,7 @@
 #include <QVBoxLayout>
 #include <QTimeLine>
 #include "User.h"
+#include "StartupSnapshot.h"
 
 class ScrollAreaNoWheel;
 class ScrollBarThumb;
@@ -19,8 +20,15 @@ public:
     explicit FriendListWidget(QWidget *parent = nullptr);
     ~FriendListWidget();
 
-    void addItem(const User& user);
+    // avatar 为空时从仓库取头像
+    void addItem(const User& user, const QPixmap& avatar = QPixmap());
     void removeItemAt(int index);
+    // 当前显示顺序下的各行，供保存启动快照
+    QVector<StartupSnapshot::FriendRow> snapshotRows() const;
+
+public slots:
+    // 用仓库中的好友校正从启动快照建出的列表，有差异时按真实数据重建并重新排序
+    void reconcile();
 protected:
     void resizeEvent(QResizeEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
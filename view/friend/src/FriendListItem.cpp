@@ -8,23 +8,24 @@
 #include <QRandomGenerator>
 #include <QPushButton>
 
-FriendListItem::FriendListItem(const User& user, QWidget* parent)
+FriendListItem::FriendListItem(const User& user, const QPixmap& avatar, QWidget* parent)
     : QWidget(parent)
     , avatarLabel(new QLabel(this))
     , fullNameText(user.nick)
     , status(user.status)
+    , user(user)
 {
     fullStatusAndSignText = QString("[%1] %2").arg(statusText(user.status), user.signature);
     setMouseTracking(true);
-    setupUI(user);
+    setupUI(user, avatar);
     setContextMenuPolicy(Qt::CustomContextMenu);
 }
 
-void FriendListItem::setupUI(const User& user)
+void FriendListItem::setupUI(const User& user, const QPixmap& avatar)
 {
     const int avatarSize = 48;
     avatarLabel->setFixedSize(avatarSize, avatarSize);
-    avatarLabel->setPixmap(UserRepository::instance().getAvatar(user.id));
+    avatarLabel->setPixmap(avatar.isNull() ? UserRepository::instance().getAvatar(user.id) : avatar);
     nameLabel = new QLabel(fullNameText, this);
     nameLabel->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
     QFont font;
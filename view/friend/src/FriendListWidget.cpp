@@ -8,6 +8,7 @@
 #include <QPropertyAnimation>
 #include <QTimer>
 #include <QCollator>
+#include <utility>
 
 static bool friendItemLessThan(FriendListItem* a, FriendListItem* b) {
     // 非离线的排前面
@@ -44,9 +45,10 @@ FriendListWidget::FriendListWidget(QWidget *parent)
     scrollBarThumb->setGraphicsEffect(opacity);
     scrollBarThumb->hide();
 
-    auto allUser = UserRepository::instance().getAllUser();
-    for (int i = 0; i < allUser.size(); ++i) {
-        addItem(allUser[i]);
+    // 有启动快照时按快照中排好的顺序直接建出，不访问仓库、不排序；仓库就绪后由 reconcile 校正
+    const StartupSnapshot& snapshot = StartupSnapshot::atLaunch();
+    for (const auto& row : snapshot.friends) {
+        addItem(row.user, QPixmap::fromImage(row.avatar));
     }
 
     scrollArea->setWidget(contentWidget);
@@ -67,7 +69,50 @@ FriendListWidget::FriendListWidget(QWidget *parent)
         scrollBarThumb->move(width() - 13, thumbOffset);
     });
     updateScrollBar();
+}
+
+void FriendListWidget::reconcile()
+{
+    auto allUser = UserRepository::instance().getAllUser();
+    auto sameUser = [](const User& a, const User& b) {
+        return a.id == b.id && a.nick == b.nick && a.status == b.status && a.signature == b.signature
+                && a.avatarPath == b.avatarPath && a.isDnd == b.isDnd;
+    };
+    QHash<QString, FriendListItem*> existing;
+    for (FriendListItem* item : std::as_const(itemList)) {
+        existing.insert(item->getUser().id, item);
+    }
+    bool unchanged = existing.size() == allUser.size();
+    for (int i = 0; i < allUser.size() && unchanged; ++i) {
+        FriendListItem* item = existing.value(allUser[i].id);
+        unchanged = item && sameUser(item->getUser(), allUser[i]);
+    }
+    if (unchanged)
+        return;
+
+    // 有差异时整体重建，头像来源没变的沿用已有的
+    const QList<FriendListItem*> previous = std::exchange(itemList, {});
+    selectItem = nullptr;
+    for (const User& user : std::as_const(allUser)) {
+        FriendListItem* old = existing.value(user.id);
+        const QPixmap avatar = old && old->getUser().avatarPath == user.avatarPath ? old->getAvatar() : QPixmap();
+        addItem(user, avatar);
+    }
+    for (FriendListItem* item : previous) {
+        item->deleteLater();
+    }
     std::sort(itemList.begin(), itemList.end(), friendItemLessThan);
+    relayoutItems();
+}
+
+QVector<StartupSnapshot::FriendRow> FriendListWidget::snapshotRows() const
+{
+    QVector<StartupSnapshot::FriendRow> rows;
+    rows.reserve(itemList.size());
+    for (FriendListItem* item : itemList) {
+        rows.push_back({ item->getUser(), item->getAvatar().toImage() });
+    }
+    return rows;
 }
 
 FriendListWidget::~FriendListWidget()
@@ -94,9 +139,9 @@ void FriendListWidget::wheelEvent(QWheelEvent *event) {
     event->accept();
 }
 
-void FriendListWidget::addItem(const User& user)
+void FriendListWidget::addItem(const User& user, const QPixmap& avatar)
 {
-    auto *item = new FriendListItem(user, contentWidget);
+    auto *item = new FriendListItem(user, avatar, contentWidget);
     itemList.append(item);
     item->show();
     connect(item, &FriendListItem::itemClicked, this, &FriendListWidget::onItemClicked);
@@ -13,10 +13,15 @@
 #include <QApplication>
 #include <QStackedWidget>
 
+class MessageApplication;
+
 class MainWindow : public FramelessWindow {
 public:
     MainWindow(QWidget *parent = nullptr);
+    // 按当前界面保存启动快照，供下次启动时画首帧
+    void saveStartupSnapshot();
 protected:
+    bool event(QEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
     bool eventFilter(QObject* watched, QEvent* ev);
@@ -33,6 +38,12 @@ private:
     QPushButton *btnClose;
     QIcon        iconClose, iconCloseHover;
     QStackedWidget* stack;
+    MessageApplication* messageApp;
+    FriendApplication* friendApp;
+    bool firstFrameShown = false;
+
+    // 首帧之后等各仓库就绪，用真实数据校正从快照建出的列表
+    void reconcileStartup();
 };
 
 
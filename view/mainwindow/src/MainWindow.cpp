@@ -4,6 +4,9 @@
 #include "AiChatApplication.h"
 #include "PostApplication.h"
 #include "CurrentUser.h"
+#include "StartupSnapshot.h"
+#include "RepositoryBootstrap.h"
+#include <QTimer>
 #include <QScreen>
 #include <QGuiApplication>
 #include <QPainterPath>
@@ -82,8 +85,10 @@ MainWindow::MainWindow(QWidget* parent)
     setTitleBar(titleBar);
 
 
-    stack->addWidget(new MessageApplication(this));
-    stack->addWidget(new FriendApplication(this));
+    messageApp = new MessageApplication(this);
+    friendApp = new FriendApplication(this);
+    stack->addWidget(messageApp);
+    stack->addWidget(friendApp);
     stack->addWidget(new PostApplication(this));
     stack->addWidget(new AiChatApplication(this));
     stack->addWidget(new DefaultPage(this));
@@ -110,6 +115,37 @@ MainWindow::MainWindow(QWidget* parent)
 }
 
 
+bool MainWindow::event(QEvent* event)
+{
+    const bool result = FramelessWindow::event(event);
+    // 首帧画完后再去等各仓库，校正从快照建出的列表
+    if (event->type() == QEvent::Paint && !firstFrameShown) {
+        firstFrameShown = true;
+        QTimer::singleShot(0, this, [this] { reconcileStartup(); });
+    }
+    return result;
+}
+
+void MainWindow::reconcileStartup()
+{
+    // 仓库在启动线程上构造，各自就绪后回到界面线程校正对应的列表
+    auto& bootstrap = RepositoryBootstrap::instance();
+    bootstrap.usersReady().then(this, [this] {
+        friendApp->friendList()->reconcile();
+    });
+    bootstrap.messagesReady().then(this, [this] {
+        messageApp->messageList()->reconcile();
+    });
+}
+
+void MainWindow::saveStartupSnapshot()
+{
+    StartupSnapshot snapshot;
+    snapshot.conversations = messageApp->messageList()->snapshotRows();
+    snapshot.friends = friendApp->friendList()->snapshotRows();
+    snapshot.save(StartupSnapshot::defaultPath());
+}
+
 void MainWindow::resizeEvent(QResizeEvent* event)
 {
     FramelessWindow::resizeEvent(event);